@@ -59,18 +59,19 @@ MEMORY
 
 SECTIONS
 {
-    .text       : > SRAM
+    .text       : > SRAM, SIZE(textSize)
     .TI.ramfunc : > SRAM
-    .const      : > SRAM
+    .const      : > SRAM, SIZE(constSize)
     .rodata     : > SRAM
-    .cinit      : > SRAM
+    .cinit      : > SRAM, SIZE(cinitSize)
     .pinit      : > SRAM
     .init_array : > SRAM
 
-    .data       : > SRAM
-    .bss        : > SRAM
-    .sysmem     : > SRAM
-    .stack      : > SRAM2(HIGH)
+    /* sizes and bounds for the RAM summary and the stack and heap painting */
+    .data       : > SRAM, SIZE(dataSize)
+    .bss        : > SRAM, SIZE(bssSize)
+    .sysmem     : > SRAM, START(heapStart), SIZE(heapSize)
+    .stack      : > SRAM2(HIGH), START(stackStart), SIZE(stackSize)
 
     .resetVecs  : > SRAM_BASE
     .ramVecs    : > SRAM2_BASE, type=NOLOAD
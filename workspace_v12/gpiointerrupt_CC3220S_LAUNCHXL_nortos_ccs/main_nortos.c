@@ -42,13 +42,18 @@
 #include <ti/drivers/Board.h>
 
 extern void *mainThread(void *arg0);
+extern void initProfiler(void);
+extern void bootMark(const char *name);
 
 /*
  *  ======== main ========
  */
 int main(void)
 {
+    /* Start the cycle counter so the boot profile counts from here */
+    initProfiler();
     Board_init();
+    bootMark("board");
 
     /* Start NoRTOS */
     NoRTOS_start();
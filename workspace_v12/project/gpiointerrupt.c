@@ -49,59 +49,153 @@
 
 
 
-#include <stddef.h>
-#include <stdio.h>
-
-/* Driver Header files */
-#include <ti/drivers/GPIO.h>
-#include <ti/drivers/Timer.h>
-#include <ti/drivers/I2C.h>
-#include <ti/drivers/UART.h>
-
-/* Driver configuration */
-#include "ti_drivers_config.h"
-
-#define DISPLAY(x) UART_write(uart, &output, x);
-#define TRUE 1
-#define FALSE 0
-#define NULL 0
-#define NUMBER_OF_TASKS 3
-#define GLOBAL_PERIOD 100
-#define INTERRUPT_PERIOD 200
-#define TEMP_PERIOD 500
-#define UART_PERIOD 1000
-#define START_TEMP 25
-#define MIN_SETPOINT 0
-#define MAX_SETPOINT 99
-#define INITIAL_TEMP 0
-#define INITIAL_SECONDS 0
+#include "gpiointerrupt.h"
 
 // define the states for the state machines and set the initial state
-enum BUTTON_STATES {NONE, BUTTON_0, BUTTON_1} BUTTON_STATE = NONE;
+enum BUTTON_STATES BUTTON_STATE = NONE;
 /*
  * since enum sets HEAT_OFF to 0 and HEAT_ON to 1 I can use HEAT_STATE
  * directly in the output to the UART
  */
-enum HEAT_STATES {HEAT_OFF, HEAT_ON} HEAT_STATE = HEAT_OFF;
-
+enum HEAT_STATES HEAT_STATE = HEAT_OFF;
 
 // UART Global Variables
 char output[64];
 int bytesToSend;
+char txBuffer[TX_BUFFER_SIZE];
+volatile uint16_t txHead = 0;       // where the next line goes
+volatile uint16_t txTail = 0;       // the first byte not sent yet
+volatile uint16_t txSending = 0;    // bytes the UART is sending from txTail, 0 if idle
+uint32_t txDropped = 0;
+uint32_t txQueued = 0;              // bytes put in the ring since boot
+volatile uint32_t txSent = 0;       // bytes of those the UART has sent
+
+// Boot profile Global Variables
+struct boot_phase bootPhases[BOOT_PHASES];
+int bootPhaseCount = 0;
+uint32_t initMicros = 0;            // boot to the end of the init functions
+uint32_t sampleMicros = 0;          // boot to the first good temperature
+uint32_t bootMicros = 0;            // boot to the first telemetry line after the first sample
 
 // I2C Global Variables
-static const struct {
-    uint8_t address;
-    uint8_t resultReg;
-    char *id;
-} sensors[3] = {
-    { 0x48, 0x0000, "11X" },
-    { 0x49, 0x0000, "116" },
-    { 0x41, 0x0001, "006" }
+const struct sensor_info sensors[NUMBER_OF_SENSORS] = {
+    { 0x48, 0x0000, "11X", 3400U },
+    { 0x49, 0x0000, "116", 400U },
+    { CONFIG_I2C_0_TMP006_ADDR, 0x0001, "006", CONFIG_I2C_0_TMP006_MAXSPEED }
+};
+// other devices sharing CONFIG_I2C_0, they limit the bus speed if present
+const struct bus_device busDevices[NUMBER_OF_BUS_DEVICES] = {
+    { CONFIG_I2C_0_BMA222E_ADDR, CONFIG_I2C_0_BMA222E_MAXSPEED }
+};
+const struct bit_rate bitRates[NUMBER_OF_BIT_RATES] = {
+    { 100U, I2C_100kHz },
+    { 400U, I2C_400kHz },
+    { 1000U, I2C_1000kHz },
+    { 3400U, I2C_3400kHz }
 };
-uint8_t txBuffer[1];
-uint8_t rxBuffer[2];
-I2C_Transaction i2cTransaction;
+int i2cFailures = 0;
+int i2cBackoff = 0;
+int8_t sensor = -1;
+int8_t probeOrder[NUMBER_OF_SENSORS];
+int probeStep = 0;
+struct i2c_request probeRequest;
+uint16_t busSpeed = 100U;
+
+// Sensor mode Global Variables
+bool tempEvents = false;
+bool tempOneShot = false;
+volatile unsigned char tempAlert = FALSE;
+volatile bool alertFallback = false;    // ALERT missed a change, read every second
+volatile bool rearmAlert = true;        // write the window even if it has not moved
+int quietSamples = 0;
+int16_t alertLow, alertHigh;            // window the TMP116 is armed with, in its own codes
+uint32_t alertMisses = 0;
+uint8_t tempBuffer[2];
+uint8_t voltageBuffer[2];
+uint8_t alertBuffer[2];
+struct i2c_request tempRequest;
+struct i2c_request voltageRequest;
+struct i2c_request conversionRequest;
+struct i2c_request highLimitRequest;
+struct i2c_request lowLimitRequest;
+struct i2c_request alertConfigRequest;
+
+// Accelerometer Global Variables
+bool accelPresent = false;
+uint8_t accelBuffer[ACCEL_FIFO_DEPTH * ACCEL_FRAME_BYTES];
+int8_t lastAccel[3];
+int32_t activity = 0;
+int quietBursts = 0;
+unsigned char occupied = TRUE;
+uint8_t accelStatus;
+struct i2c_request accelStatusRequest;
+struct i2c_request accelFifoRequest;
+
+// Temperature filter Global Variables
+int16_t medianWindow[TEMP_MEDIAN_TAPS];     // readings in arrival order, oldest at medianNext
+int16_t medianSorted[TEMP_MEDIAN_TAPS];     // the same readings in order
+int medianCount = 0;
+int medianNext = 0;
+int32_t iirState;
+bool filterPrimed = false;
+
+// Heater accounting Global Variables
+uint64_t heatCheckpoint = 0;        // timeCycles() the times below were added up to
+uint64_t heatTotalCycles = 0;       // all the time accounted for
+uint64_t heatOnCycles = 0;          // the part of it the heat was on
+uint32_t heatCycles = 0;            // times the heat turned on
+uint64_t windowTotalCycles = 0;     // the two totals when the duty window started
+uint64_t windowOnCycles = 0;
+uint16_t dutyPermille = 0;          // duty cycle of the last full window
+uint32_t heatSecondFraction = 0;    // duty not yet counted as a heater second
+
+// Heater output Global Variables
+PWM_Handle heatPwm;
+int32_t heatDuty = 0;               // Q16, what the heater is driven at now
+
+// Zone Global Variables, one entry per zone, or per zone read on the bus
+// for the requests. Zone 0 is kept up to date from the single zone
+// variables; its request and telemetry entries are not used.
+static const uint8_t zoneAddresses[MAX_ZONE_SENSORS] = ZONE_ADDRESSES;
+int16_t zoneFine[ZONES];
+int16_t zoneRaw[ZONES];
+int16_t zoneTarget[ZONES];
+unsigned char zoneHealth[ZONES];
+bool zoneSample[ZONES];
+int32_t zoneIntegral[ZONES];
+uint32_t zoneIntegrated[ZONES];
+int32_t zoneDuty[ZONES];
+int32_t zoneBase[ZONES];
+uint8_t zoneAge[ZONES];
+int16_t zoneSlewRaw[ZONES];
+uint8_t zoneSlewRejects[ZONES];
+uint8_t zoneSlewAgreed[ZONES];
+const struct zone_arrays allZones = {
+    zoneFine, zoneRaw, zoneTarget, zoneHealth, zoneSample, zoneIntegral, zoneIntegrated, zoneDuty, zoneBase,
+    zoneAge, zoneSlewRaw, zoneSlewRejects, zoneSlewAgreed
+};
+uint8_t zoneSetPoint[ZONES];
+uint8_t zoneBuffer[ZONE_SENSORS][2];
+struct i2c_request zoneRequests[ZONE_SENSORS];
+int8_t zoneReportedTemp[ZONES];
+uint8_t zoneReportedSetPoint[ZONES];
+int32_t zoneReportedDuty[ZONES];
+int zoneReportedSeconds[ZONES];
+uint32_t zonePassCycles = 0;        // longest controlZones()
+
+int16_t tempOffset = 0;             // calibration, set with O<1/128 degrees>
+
+// Sensor health Global Variables
+unsigned char health = HEALTH_STALE;    // HEALTH_ flags, stale until the first reading
+unsigned char reportedHealth = 0;
+int16_t lastRaw;
+int lastRawTime;
+int rawChangedTime;
+int slewRejects = 0;                // jumps in a row
+int slewAgreed = 0;                 // of them, in a row near the one before
+int16_t slewRaw;                    // the last jump
+int slewRawTime;
+bool healthPrimed = false;
 
 // Driver Handles - Global variables
 I2C_Handle i2c;
@@ -110,30 +204,68 @@ Timer_Handle timer0;
 
 // global variables
 int temperature = INITIAL_TEMP;
+int tempAge = MAX_TEMP_AGE;
 int setPoint = START_TEMP;
 int seconds = INITIAL_SECONDS;
 
+// Telemetry Global Variables, what the last line sent said
+int reportedTemp = 0;
+int reportedSetPoint = 0;
+enum HEAT_STATES reportedHeat = HEAT_OFF;
+int reportedSeconds = INITIAL_SECONDS - HEARTBEAT_SECONDS;
+uint32_t telemetryLines = 0;
+
+// Thermal model Global Variables
+int64_t modelP[3][3] = {{MODEL_P_START, 0, 0}, {0, MODEL_P_START, 0}, {0, 0, MODEL_P_START}};    // Q24 covariance
+int32_t modelTheta[3];          // Q16 heating, loss and drift
+int32_t modelLastTemp;          // Q12 degrees from MODEL_REFERENCE, last minute's average
+int modelLastHeat;              // heater seconds in the last minute
+bool modelPrimed = false;
+uint32_t modelMinutes = 0;
+
+// UART command Global Variables, filled in by uartReadCallback()
+char commandChar;
+char command[COMMAND_LENGTH];
+int commandLength = 0;
+volatile bool commandReady = false;
+uint64_t commandTime;               // timeCycles() when the line ended
+
+// Time sync Global Variables
+volatile uint64_t syncSent;         // timeCycles() when the last byte of <S> went out
+uint32_t syncEnd;                   // txQueued with <S> in the ring
+volatile bool syncWaiting = false;  // <S> has not all gone out yet
+bool syncPending = false;
+bool synced = false;
+bool skewKnown = false;
+uint64_t syncDevice;                // timeMicros() of the last good sync
+uint64_t syncWall;                  // epoch microseconds at that time
+int32_t skewPpb = 0;                // how much faster than the CPU clock the wall clock runs
+uint32_t syncRtt = 0;
+
+// Timebase Global Variables
+// timerCallback() keeps the cycle count that DWT_CYCCNT stood at in one of
+// two slots, alternately, and bumps timeGeneration once the slot is written
+volatile struct time_base timeBases[2];
+volatile uint32_t timeGeneration = 0;
+
 volatile unsigned char ready_tasks = FALSE;
+volatile uint64_t buttonTime = 0;   // timeCycles() when a button was last pressed
+uint32_t maxReaction = 0;           // most cycles from a button press to the heater
 int global_period = GLOBAL_PERIOD;
 
-// forward declarations
-void changeTempSetPoint();
-void updateTemp();
-void oneSecondTasks();
-int16_t readTemp(void);
-
-// global variables for the task manager
-struct task_entry {
-    void (*f)();
-    int elapsed_time;
-    int period;
-    char triggered;
-};
-
+/*
+ * tools/schedcheck.c reads this table (and the period defines in
+ * gpiointerrupt.h) to check that every task meets its deadline, so keep one
+ * entry per line.
+ */
 struct task_entry tasks[NUMBER_OF_TASKS] = {
-    {&changeTempSetPoint, INTERRUPT_PERIOD, INTERRUPT_PERIOD, FALSE},
-    {&updateTemp, TEMP_PERIOD, TEMP_PERIOD, FALSE},
-    {&oneSecondTasks, UART_PERIOD, UART_PERIOD, FALSE}
+    {&changeTempSetPoint, INTERRUPT_PERIOD, INTERRUPT_PERIOD, FALSE, 0},
+    {&startConversion, TEMP_PERIOD, TEMP_PERIOD, FALSE, 0},
+    {&updateTemp, TEMP_PERIOD - CONVERSION_LEAD, TEMP_PERIOD, FALSE, 0},
+    {&oneSecondTasks, UART_PERIOD, UART_PERIOD, FALSE, 0},
+    {&updateActivity, ACCEL_PERIOD, ACCEL_PERIOD, FALSE, 0},
+    {&serviceCommand, COMMAND_PERIOD, COMMAND_PERIOD, FALSE, 0},
+    {&serviceI2C, I2C_PERIOD, I2C_PERIOD, FALSE, 0}
 };
 
 /**
@@ -144,6 +276,7 @@ struct task_entry tasks[NUMBER_OF_TASKS] = {
  * was tripped for the increment button and BUTTON_1 is for decrement.
  * There is also a condition for both to keep the number in the range of
  * MIN_setPoint and MAX_setPoint
+ * A change goes straight on to the heater through heatInputChanged().
  * Takes no arguments and does not return anything
  *
 **/
@@ -165,6 +298,21 @@ void changeTempSetPoint() {
         default:
             break;
     }
+    if (BUTTON_STATE != NONE) {
+        setPointOverride = true;
+        heatInputChanged();
+        if (REACTIVE_HEAT) {
+            uint64_t pressed, reaction;
+            // 64 bits take two loads, and a press in between rewrites them
+            do {
+                pressed = buttonTime;
+            } while (pressed != buttonTime);
+            reaction = timeCycles() - pressed;
+            if (reaction > maxReaction) {
+                maxReaction = (uint32_t)reaction;
+            }
+        }
+    }
     // Transitions
     switch (BUTTON_STATE) {
         case NONE:
@@ -180,98 +328,1181 @@ void changeTempSetPoint() {
     }
 }
 
+/**
+ * Function for starting a temperature conversion
+ *
+ * In TMP102 one-shot mode this sets the one-shot bit so the sensor takes
+ * one sample and goes back to shutdown. The task runs CONVERSION_LEAD
+ * before updateTemp(), so the read always finds a fresh sample and never
+ * has to wait for one. Does nothing for the other sensors.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void startConversion() {
+    if (tempOneShot && i2cBackoff == 0) {
+        queueI2C(&conversionRequest);
+    }
+}
+
+/**
+ * Function for counting a sample that did not produce a temperature
+ *
+ * Adds one to tempAge, which stops at MAX_TEMP_AGE. The heater is told
+ * as soon as the reading becomes too old to use.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void missSample() {
+    if (tempAge < MAX_TEMP_AGE) {
+        tempAge++;
+        if (tempAge == MAX_TEMP_AGE) {
+            health |= HEALTH_STALE;
+            heatInputChanged();
+        }
+    }
+}
+
 /**
  * Function for updating the temperature variable
  *
- * Function uses the readTemp() function provided
+ * Function uses the readTemp() function provided, which queues the read;
+ * tempRead() below stores the result. If the read fails the last good
+ * temperature is kept and tempAge counts how many samples old it is.
+ * After a failure the next samples are skipped with an exponential
+ * backoff so a dead sensor does not cost a timeout every sample.
+ * In TMP116 event mode the sensor is only read after it raised ALERT (or
+ * once every TMP116_CHECK_SAMPLES, every TMP116_FALLBACK_SAMPLES once a
+ * check read has caught ALERT missing a change) and the alert window is
+ * moved to the new reading. The other zones are read every sample whatever zone 0 does.
  * Does not take any arguments and does not return anything
  *
 **/
 void updateTemp() {
-    temperature = readTemp();
+    readZones();
+    if (tempEvents && !tempAlert
+            && ++quietSamples < (alertFallback ? TMP116_FALLBACK_SAMPLES : TMP116_CHECK_SAMPLES)) {
+        // the sensor has not seen the temperature leave the window
+        return;
+    }
+    if (i2cBackoff > 0) {
+        i2cBackoff--;
+        missSample();
+    } else if (!readTemp()) {
+        missSample();
+    }
+}
+
+/*
+ * Age the count zones past zone 0, which missSample() ages, by a sample.
+ * A zone with no good reading for MAX_TEMP_AGE samples is marked stale,
+ * which stops its heat. Returns true if one went stale.
+ */
+bool ageZones(const struct zone_arrays *zones, int count) {
+    bool stale = false;
+    int x = 0;
+    for (x = 1; x < count; x++) {
+        if (zones->age[x] < MAX_TEMP_AGE) {
+            zones->age[x]++;
+            if (zones->age[x] == MAX_TEMP_AGE) {
+                zones->health[x] |= HEALTH_STALE;
+                stale = true;
+            }
+        }
+    }
+    return stale;
+}
+
+/*
+ * Take raw, in 1/128 degree, as zone's new reading with the checks
+ * checkHealth() makes for zone 0: a reading outside HEALTH_MIN_CODE to
+ * HEALTH_MAX_CODE raises HEALTH_RANGE, and one that moved more than
+ * HEALTH_SLEW_CODES a second since the last good reading is dropped,
+ * unless HEALTH_SLEW_REJECTS of them in a row agree with each other and
+ * make a real step. HEALTH_SLEW_REJECTS in a row that do not raise
+ * HEALTH_SLEW. A stale zone takes the reading as it is, there is nothing
+ * recent to compare or smooth it with. Returns false if it was not taken.
+ */
+bool zoneReading(const struct zone_arrays *zones, int zone, int16_t raw) {
+    int32_t allowed = (int32_t)HEALTH_SLEW_CODES * ((zones->age[zone] + 1) * TEMP_PERIOD / 1000 + 1);
+    if (raw < HEALTH_MIN_CODE || raw > HEALTH_MAX_CODE) {
+        zones->health[zone] |= HEALTH_RANGE;
+        return false;
+    }
+    if (zones->age[zone] >= MAX_TEMP_AGE) {
+        zones->fine[zone] = raw;
+    } else if (raw - zones->raw[zone] > allowed || zones->raw[zone] - raw > allowed) {
+        int16_t last = zones->slewRaw[zone];
+        if (zones->slewRejects[zone] > 0 && raw - last <= allowed && last - raw <= allowed) {
+            zones->slewAgreed[zone]++;
+        } else {
+            zones->slewAgreed[zone] = 1;
+        }
+        zones->slewRaw[zone] = raw;
+        if (zones->slewAgreed[zone] < HEALTH_SLEW_REJECTS) {
+            if (++zones->slewRejects[zone] >= HEALTH_SLEW_REJECTS) {
+                zones->health[zone] |= HEALTH_SLEW;
+            }
+            return false;
+        }
+    }
+    zones->health[zone] = 0;
+    zones->raw[zone] = raw;
+    zones->sample[zone] = true;
+    zones->age[zone] = 0;
+    zones->slewRejects[zone] = 0;
+    zones->slewAgreed[zone] = 0;
+    return true;
+}
+
+/*
+ * Queue a read of every zone with a sensor on the bus past zone 0. The
+ * I2C queue spreads them over its passes with the other reads.
+ */
+void readZones(void) {
+    int x = 0;
+    if (ageZones(&allZones, ZONES)) {
+        heatInputChanged();
+    }
+    for (x = 1; x < ZONE_SENSORS && i2cBackoff == 0; x++) {
+        queueI2C(&zoneRequests[x]);
+    }
+}
+
+/*
+ * Called when a zone read finishes. zoneReading() checks the reading.
+ */
+void zoneRead(struct i2c_request *request, bool ok) {
+    int zone = request - zoneRequests;
+    if (!ok) {
+        return;
+    }
+    zoneReading(&allZones, zone, (int16_t)((zoneBuffer[zone][0] << 8) | zoneBuffer[zone][1]));
+    heatInputChanged();
+}
+
+/*
+ * Set zone's setPoint from Z<zone>,<setPoint>. Zone 0 takes it like a
+ * button press.
+ */
+void setZone(char *args) {
+    char *end;
+    long zone = strtol(args, &end, 10);
+    long value = *end == ',' ? strtol(end + 1, &end, 10) : -1;
+    if (zone < 0 || zone >= ZONES || value < MIN_SETPOINT || value > MAX_SETPOINT || *end != '\0') {
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    if (zone == 0) {
+        setPoint = value;
+        setPointOverride = true;
+    } else {
+        zoneSetPoint[zone] = value;
+        zoneTarget[zone] = value * 128;
+    }
+    heatInputChanged();
+}
+
+/**
+ * Function for updating the occupancy from the accelerometer
+ *
+ * Queues a read of how many frames are in the BMA222E FIFO;
+ * accelStatusRead() then drains all of them in a single burst and
+ * accelFifoRead() works out the activity. Both run at background
+ * priority so they never hold up a temperature read.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void updateActivity() {
+    if (accelPresent && i2cBackoff == 0) {
+        queueI2C(&accelStatusRequest);
+    }
+}
+
+/*
+ * Called when the FIFO status has been read, queues the burst read of
+ * every frame in the FIFO
+ */
+void accelStatusRead(struct i2c_request *request, bool ok) {
+    int frames = accelStatus & 0x7F;
+    if (!ok || frames == 0) {
+        return;
+    }
+    if (frames > ACCEL_FIFO_DEPTH) {
+        frames = ACCEL_FIFO_DEPTH;
+    }
+    accelFifoRequest.readCount = frames * ACCEL_FRAME_BYTES;
+    queueI2C(&accelFifoRequest);
+}
+
+/*
+ * Called when the FIFO has been drained. The change between successive
+ * frames is averaged into activity, which only needs the previous frame,
+ * so the work and memory do not depend on how long the room is watched.
+ * Movement marks the room occupied; VACANT_BURSTS bursts without it mark
+ * it vacant.
+ */
+void accelFifoRead(struct i2c_request *request, bool ok) {
+    int frames = request->readCount / ACCEL_FRAME_BYTES;
+    int x, axis;
+    int32_t change = 0;
+    if (!ok) {
+        return;
+    }
+    for (x = 0; x < frames; x++) {
+        for (axis = 0; axis < 3; axis++) {
+            // 8 bit samples are in the MSB of each LSB/MSB pair
+            int8_t sample = (int8_t)accelBuffer[x * ACCEL_FRAME_BYTES + axis * 2 + 1];
+            change += sample > lastAccel[axis] ? sample - lastAccel[axis] : lastAccel[axis] - sample;
+            lastAccel[axis] = sample;
+        }
+    }
+    activity += ((change << 4) / frames - activity) >> ACTIVITY_SHIFT;
+    if (activity > ACTIVITY_THRESHOLD) {
+        quietBursts = 0;
+        if (!occupied) {
+            occupied = TRUE;
+            heatInputChanged();
+        }
+    } else if (quietBursts < VACANT_BURSTS) {
+        quietBursts++;
+    } else if (occupied) {
+        occupied = FALSE;
+        heatInputChanged();
+    }
+}
+
+/**
+ * Function for the temperature the heater works towards
+ *
+ * This is setPoint, lowered by SETBACK_DEGREES while the accelerometer
+ * says the room is vacant. Returns the target temperature
+ *
+**/
+int heatTarget() {
+    if (occupied || setPoint - SETBACK_DEGREES < MIN_SETPOINT) {
+        return setPoint;
+    }
+    return setPoint - SETBACK_DEGREES;
+}
+
+/*
+ * Extend DWT_CYCCNT to 64 bits. Called from timerCallback(), so the
+ * counter can not wrap (53s at 80MHz) between two calls. The new count
+ * goes in the slot readers are not using.
+ */
+void updateTimeBase(void) {
+    const volatile struct time_base *last = &timeBases[timeGeneration & 1];
+    volatile struct time_base *next = &timeBases[(timeGeneration + 1) & 1];
+    uint32_t low = DWT_CYCCNT;
+    next->high = last->high + (low < last->low);
+    next->low = low;
+    timeGeneration++;
+}
+
+/*
+ * Cycles since initProfiler(), 64 bits. Lock free and safe from an
+ * interrupt: if timerCallback() moves the time base on while this reads
+ * it, the read starts again.
+ */
+uint64_t timeCycles(void) {
+    uint32_t generation, high, base, low;
+    do {
+        generation = timeGeneration;
+        high = timeBases[generation & 1].high;
+        base = timeBases[generation & 1].low;
+        low = DWT_CYCCNT;
+    } while (generation != timeGeneration);
+    if (low < base) {
+        // wrapped since the last timerCallback()
+        high++;
+    }
+    return ((uint64_t)high << 32) | low;
+}
+
+/*
+ * Microseconds since initProfiler()
+ */
+uint64_t timeMicros(void) {
+    return timeCycles() / CYCLES_PER_US;
+}
+
+/**
+ * Function for updating the seconds variable
+ *
+ * Function increments second. Used to enhance readability.
+ * oneSecondTasks() calls it once for every second of timeMicros(), so the
+ * count follows the clock even when a pass runs late.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void incrementSeconds() {
+    seconds++;
+}
+
+/**
+ * Function for sending to UART
+ *
+ * Function sends string of 64 chars to UART. Used to enhance readability.
+ * With TELEMETRY_BY_EXCEPTION the line is skipped unless the temperature
+ * moved by TELEMETRY_DEADBAND, the setPoint or heat changed, or the last
+ * line is HEARTBEAT_SECONDS old. Every line still has the time in it, the
+ * whole seconds of timeMicros() and not the seconds count, which can be a
+ * second behind until oneSecondTasks() catches it up, so the receiver
+ * knows when each value started.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendToUART() {
+    int moved = temperature - reportedTemp;
+    int now = (int)(timeMicros() / 1000000);
+    if (TELEMETRY_BY_EXCEPTION && now - reportedSeconds < HEARTBEAT_SECONDS
+            && moved < TELEMETRY_DEADBAND && -moved < TELEMETRY_DEADBAND
+            && setPoint == reportedSetPoint && HEAT_STATE == reportedHeat) {
+        return;
+    }
+    reportedTemp = temperature;
+    reportedSetPoint = setPoint;
+    reportedHeat = HEAT_STATE;
+    reportedSeconds = now;
+    telemetryLines++;
+    DISPLAY(snprintf(output, 64, "<%02d,%02d,%d,%04d>\n\r", temperature, setPoint, HEAT_STATE, now))
+    if (bootMicros == 0 && sampleMicros != 0) {
+        int x = 0;
+        bootMicros = timeMicros();
+        for (x = 0; x < bootPhaseCount; x++) {
+            DISPLAY(snprintf(output, 64, "<G,%s,%lu>\n\r", bootPhases[x].name,
+                             (unsigned long)bootPhases[x].micros))
+        }
+        DISPLAY(snprintf(output, 64, "<L,%d,%lu,%lu,%lu>\n\r", warmBoot, (unsigned long)initMicros,
+                         (unsigned long)sampleMicros, (unsigned long)bootMicros))
+    }
+}
+
+/**
+ * Function for sending the zones past zone 0 to UART
+ *
+ * Sends <Z,zone,temp,setPoint,dutyPermille> for each zone whose reading
+ * moved by TELEMETRY_DEADBAND, whose setPoint changed or whose duty moved
+ * by ZONE_DUTY_DEADBAND, and every HEARTBEAT_SECONDS otherwise. An
+ * external heater driver follows the duty.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendZonesToUART() {
+    int x = 0;
+    for (x = 1; x < ZONES; x++) {
+        int temp = zoneFine[x] / 128;
+        int moved = temp - zoneReportedTemp[x];
+        int32_t change = zoneDuty[x] - zoneReportedDuty[x];
+        if (TELEMETRY_BY_EXCEPTION && seconds - zoneReportedSeconds[x] < HEARTBEAT_SECONDS
+                && moved < TELEMETRY_DEADBAND && -moved < TELEMETRY_DEADBAND
+                && zoneSetPoint[x] == zoneReportedSetPoint[x]
+                && change < ZONE_DUTY_DEADBAND && -change < ZONE_DUTY_DEADBAND
+                && (zoneDuty[x] == 0) == (zoneReportedDuty[x] == 0)) {
+            continue;
+        }
+        zoneReportedTemp[x] = temp;
+        zoneReportedSetPoint[x] = zoneSetPoint[x];
+        zoneReportedDuty[x] = zoneDuty[x];
+        zoneReportedSeconds[x] = seconds;
+        telemetryLines++;
+        DISPLAY(snprintf(output, 64, "<Z,%d,%02d,%02d,%ld>\n\r", x, temp, zoneSetPoint[x],
+                         (long)((zoneDuty[x] * 1000LL) >> 16)))
+    }
+}
+
+/**
+ * Function for sending the measured task execution times to UART
+ *
+ * Sends one line per task in the form <W,task,cycles> with the longest
+ * run of that task seen since boot. tools/schedcheck.c picks these lines
+ * out of a UART capture and uses them in place of the annotated times.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendWcetToUART() {
+    int x = 0;
+    for (x = 0; x < NUMBER_OF_TASKS; x++) {
+        DISPLAY(snprintf(output, 64, "<W,%d,%lu>\n\r", x, (unsigned long)tasks[x].max_cycles))
+    }
+}
+
+/*
+ * Add the time since the last checkpoint to the heater totals, the on
+ * time weighted by the duty. Called on every duty change and before the
+ * totals are used.
+ */
+void accountHeat(void) {
+    uint64_t now = timeCycles();
+    uint64_t cycles = now - heatCheckpoint;
+    heatCheckpoint = now;
+    heatTotalCycles += cycles;
+    heatOnCycles += (cycles * heatDuty) >> 16;
+}
+
+/*
+ * Drive the heater at duty (Q16), settling the accounting at the old duty
+ * first
+ */
+void driveHeater(int32_t duty) {
+    if (duty == heatDuty) {
+        return;
+    }
+    accountHeat();
+    heatDuty = duty;
+    PWM_setDuty(heatPwm, (uint32_t)(((uint64_t)duty * PWM_DUTY_FRACTION_MAX) >> 16));
+}
+
+/*
+ * PI controller for count zones in one pass over their arrays. The error
+ * is the target less the temperature in 1/128 degree, the output a Q16
+ * duty. The integral only moves once per reading, by the error times the
+ * time since it last moved, now in ms, so the sparse readings of TMP116
+ * event mode add up as the steady ones do. It does not move while the
+ * output is already pinned the way it would push it, so it does not wind
+ * up while a heater is flat out or off. A duty stays within
+ * HEAT_DUTY_STEP of where it was at the zone's last reading, so the
+ * button presses and other inputs between two readings cannot add up to
+ * more than one step, except that a sensor fault stops the heat at once. The new readings of the zones past zone 0 are filtered first,
+ * zone 0 has its own filter.
+ */
+void controlPass(const struct zone_arrays *zones, int count, uint32_t now) {
+    int x = 0;
+    if (TEMP_FILTER) {
+        filterZones(&zones->fine[1], &zones->raw[1], &zones->sample[1], count - 1);
+    } else {
+        for (x = 1; x < count; x++) {
+            zones->fine[x] = zones->raw[x];
+        }
+    }
+    for (x = 0; x < count; x++) {
+        int32_t error = zones->target[x] - zones->fine[x];
+        int32_t duty = error * HEAT_KP + (zones->integral[x] >> 8);
+        if (zones->health[x] != 0) {
+            zones->sample[x] = false;
+            zones->integral[x] = 0;
+            zones->integrated[x] = now;
+            zones->duty[x] = 0;
+            zones->base[x] = 0;
+            continue;
+        }
+        if (zones->sample[x]) {
+            uint32_t elapsed = now - zones->integrated[x];
+            if (elapsed > HEAT_KI_MAX_MS) {
+                elapsed = HEAT_KI_MAX_MS;
+            }
+            zones->sample[x] = false;
+            zones->integrated[x] = now;
+            zones->base[x] = zones->duty[x];
+            if (!((duty >= HEAT_DUTY_MAX && error > 0) || (duty <= 0 && error < 0))) {
+                zones->integral[x] += error * HEAT_KI * (int32_t)elapsed / TEMP_PERIOD;
+                if (zones->integral[x] < 0) {
+                    zones->integral[x] = 0;
+                } else if (zones->integral[x] > HEAT_DUTY_MAX << 8) {
+                    zones->integral[x] = HEAT_DUTY_MAX << 8;
+                }
+            }
+        }
+        if (duty > HEAT_DUTY_MAX) {
+            duty = HEAT_DUTY_MAX;
+        } else if (duty < 0) {
+            duty = 0;
+        }
+        if (duty > zones->base[x] + HEAT_DUTY_STEP) {
+            duty = zones->base[x] + HEAT_DUTY_STEP;
+        } else if (duty < zones->base[x] - HEAT_DUTY_STEP) {
+            duty = zones->base[x] - HEAT_DUTY_STEP;
+        }
+        zones->duty[x] = duty;
+    }
+}
+
+/*
+ * Bring zone 0's target and health into the zone arrays and run the
+ * controller over every zone, timing the longest pass
+ */
+void controlZones(void) {
+    uint32_t start = DWT_CYCCNT;
+    uint32_t cycles;
+    zoneTarget[0] = heatTarget() * 128;
+    zoneHealth[0] = health;
+    controlPass(&allZones, ZONES, (uint32_t)(timeMicros() / 1000));
+    cycles = DWT_CYCCNT - start;
+    if (cycles > zonePassCycles) {
+        zonePassCycles = cycles;
+    }
+}
+
+/**
+ * Function for the heater duty cycle and energy
+ *
+ * Brings the totals up to date; at the end of each DUTY_WINDOW works out
+ * the duty cycle of the window from the cycles, not the seconds count, so
+ * a late task does not skew it. Every WCET_REPORT_PERIOD sends the counter
+ * block <D,cycles,onSeconds,dutyPermille,Wh> with HEATER_WATTS as the load.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void updateHeatAccount() {
+    accountHeat();
+    if (seconds % DUTY_WINDOW == 0 && heatTotalCycles > windowTotalCycles) {
+        dutyPermille = (heatOnCycles - windowOnCycles) * 1000 / (heatTotalCycles - windowTotalCycles);
+        windowTotalCycles = heatTotalCycles;
+        windowOnCycles = heatOnCycles;
+    }
+    if (seconds % WCET_REPORT_PERIOD == 0) {
+        uint32_t onSeconds = heatOnCycles / CPU_FREQUENCY;
+        DISPLAY(snprintf(output, 64, "<D,%lu,%lu,%u,%lu>\n\r", (unsigned long)heatCycles,
+                         (unsigned long)onSeconds, dutyPermille,
+                         (unsigned long)((uint64_t)onSeconds * HEATER_WATTS / 3600)))
+    }
+}
+
+/**
+ * Function for setting heat on or off depending on the setPoint and current temperature
+ *
+ * Uses a state machine to update HEAT_STATE. The setPoint below is the one
+ * from heatTarget(), which allows for a vacant room. If the temperature is less than
+ * the setPoint the HEAT_STATE is set to HEAT_ON and the red light is turned on.
+ * If the temperature is greater than or equal to setPoint the HEAT_STATE is set to
+ * HEAT_OFF and the red light is turned off.
+ * The heat is also turned off while checkHealth() reports a fault (which
+ * includes the temperature being MAX_TEMP_AGE samples old), so a failed
+ * sensor never leaves the heater running.
+ * With HEAT_PWM the heater is driven at the duty controlZones() works out
+ * instead, and HEAT_STATE is HEAT_ON for any duty above 0. The other
+ * zones are always on their controlZones() duty.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void setHeat() {
+    controlZones();
+    if (HEAT_PWM) {
+        if (zoneDuty[0] > 0 && heatDuty == 0) {
+            heatCycles++;
+        }
+        HEAT_STATE = zoneDuty[0] > 0 ? HEAT_ON : HEAT_OFF;
+        driveHeater(zoneDuty[0]);
+        return;
+    }
+    // Transitions
+    switch (HEAT_STATE) {
+        case HEAT_OFF:
+            if (temperature < heatTarget() && health == 0) {
+                HEAT_STATE = HEAT_ON;
+                heatCycles++;
+            }
+            break;
+        case HEAT_ON:
+            if (temperature >= heatTarget() || health != 0) {
+                HEAT_STATE = HEAT_OFF;
+            }
+            break;
+        default:
+            break;
+    }
+    // Actions
+    switch (HEAT_STATE) {
+        case HEAT_OFF:
+            // light off
+            driveHeater(0);
+            break;
+        case HEAT_ON:
+            // light on
+            driveHeater(HEAT_DUTY_MAX);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Epoch microseconds at device time micros (from timeMicros()), from the
+ * last sync and the skew. Only meaningful once synced is set.
+ */
+uint64_t wallMicros(uint64_t micros) {
+    int64_t since = micros - syncDevice;
+    return syncWall + since + since * skewPpb / 1000000000;
+}
+
+/*
+ * Ask the host for the time. <S> may wait in the ring behind other lines,
+ * so uartWriteCallback() stamps syncSent once it has gone out. The
+ * answer comes back through timeSync().
+ */
+void requestTimeSync(void) {
+    uint32_t dropped = txDropped;
+    DISPLAY(snprintf(output, 64, "<S>\n\r"))
+    syncPending = txDropped == dropped;
+    syncEnd = txQueued;
+    syncWaiting = syncPending;
+}
+
+/*
+ * Take the host's answer to the last <S>.
+ *
+ * Answers without a request, before <S> has gone out, or slower than
+ * SYNC_MAX_RTT_US, are dropped.
+ * The epoch is taken as the time half way through the round trip. The
+ * difference between the wall and CPU time that passed since the last
+ * sync gives a skew sample, averaged into skewPpb; a difference over
+ * 1000ppm is the host clock being set and only moves the offset. Sends
+ * <C,seconds,epoch,ms,skewPpb,rttUs> with the wall time the current
+ * second of the seconds count started at, for the host to map telemetry.
+ */
+void timeSync(uint64_t epochMs) {
+    uint64_t device, wall;
+    uint32_t rtt;
+    if (!syncPending || syncWaiting) {
+        return;
+    }
+    syncPending = false;
+    rtt = (commandTime - syncSent) / CYCLES_PER_US;
+    if (rtt > SYNC_MAX_RTT_US) {
+        return;
+    }
+    device = syncSent / CYCLES_PER_US + rtt / 2;
+    wall = epochMs * 1000;
+    if (synced && device > syncDevice) {
+        int64_t elapsed = device - syncDevice;
+        int64_t drift = (int64_t)(wall - syncWall) - elapsed;
+        // more than 1000ppm is no crystal, the host clock was set
+        if (drift <= elapsed / 1000 && -drift <= elapsed / 1000) {
+            int32_t sample = drift * 1000000000 / elapsed;
+            if (!skewKnown) {
+                skewPpb = sample;
+                skewKnown = true;
+            } else {
+                skewPpb += (sample - skewPpb) >> SYNC_SKEW_SHIFT;
+            }
+        }
+    }
+    syncDevice = device;
+    syncWall = wall;
+    syncRtt = rtt;
+    synced = true;
+    wall = wallMicros((uint64_t)seconds * 1000000);
+    DISPLAY(snprintf(output, 64, "<C,%d,%lu,%03u,%ld,%lu>\n\r", seconds, (unsigned long)(wall / 1000000),
+                     (unsigned)(wall / 1000 % 1000), (long)skewPpb, (unsigned long)syncRtt))
+}
+
+/*
+ * Take an S line: text has to be the epoch in decimal ms and nothing else,
+ * or the answer is <E> and the sync still waits for a good one
+ */
+void syncCommand(const char *text) {
+    char *end;
+    uint64_t epochMs = strtoull(text, &end, 10);
+    // strtoull would take spaces and a sign, and 19 digits always fit
+    if (text[0] < '0' || text[0] > '9' || *end != '\0' || end - text > 19) {
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    timeSync(epochMs);
+}
+
+/*
+ * Take an O line: text has to be the offset in 1/128 degree, within
+ * MAX_TEMP_OFFSET either way, and nothing else. The answer is
+ * <O,offset>, or <E> with the calibration left as it was.
+ */
+void setOffset(const char *text) {
+    char *end;
+    long offset = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || offset < -MAX_TEMP_OFFSET || offset > MAX_TEMP_OFFSET) {
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    tempOffset = offset;
+    DISPLAY(snprintf(output, 64, "<O,%d>\n\r", tempOffset))
+}
+
+/**
+ * Function for fitting the thermal model to the minute that just closed
+ *
+ * Takes the average temperature and heater duty of the minute from the
+ * rollups and makes one recursive least squares step with the change in
+ * temperature as the output and duty, the last temperature and 1 as the
+ * inputs. Everything is integer: inputs Q12, covariance and gain Q24,
+ * fit Q16. A minute without readings breaks the chain and the next one
+ * only primes it.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void updateModel() {
+    const struct rollup_level *level = &rollups[1];
+    const struct rollup_bucket *minute = &level->ring[level->next == 0 ? level->size - 1 : level->next - 1];
+    int32_t input[3], temp;
+    int64_t px[3], denominator, gain[3], error;
+    int x, y;
+
+    if (minute->count == 0) {
+        modelPrimed = false;
+        return;
+    }
+    temp = (minute->sum / minute->count - MODEL_REFERENCE) << 5;
+    if (!modelPrimed) {
+        modelLastTemp = temp;
+        modelLastHeat = minute->heatSeconds;
+        modelPrimed = true;
+        return;
+    }
+    // the change between two minute averages comes from half of each minute
+    input[0] = (minute->heatSeconds + modelLastHeat) * MODEL_ONE / 120;
+    input[1] = modelLastTemp;
+    input[2] = MODEL_ONE;
+
+    denominator = ((int64_t)1 << 24) - ((int64_t)1 << (24 - MODEL_LAMBDA_SHIFT));
+    error = (int64_t)(temp - modelLastTemp) << 4;
+    for (x = 0; x < 3; x++) {
+        px[x] = 0;
+        for (y = 0; y < 3; y++) {
+            px[x] += modelP[x][y] * input[y] >> 12;
+        }
+        denominator += px[x] * input[x] >> 12;
+        error -= (int64_t)modelTheta[x] * input[x] >> 12;
+    }
+    for (x = 0; x < 3; x++) {
+        gain[x] = (px[x] << 24) / denominator;
+        modelTheta[x] += gain[x] * error >> 24;
+    }
+    for (x = 0; x < 3; x++) {
+        for (y = x; y < 3; y++) {
+            int64_t p = modelP[x][y] - (gain[x] * px[y] >> 24);
+            if (modelP[x][x] < MODEL_P_MAX && modelP[y][y] < MODEL_P_MAX) {
+                // divide by the forgetting factor
+                p += p >> MODEL_LAMBDA_SHIFT;
+            }
+            modelP[x][y] = p;
+            modelP[y][x] = p;
+        }
+    }
+    modelLastTemp = temp;
+    modelLastHeat = minute->heatSeconds;
+    if (modelMinutes < MODEL_MIN_MINUTES) {
+        modelMinutes++;
+    }
+}
+
+/*
+ * Minutes the model says the heat has to be on for the room to get from
+ * the last minute's temperature to target degrees, up to
+ * PREHEAT_MAX_MINUTES. 0 while the model is not fitted or says heating
+ * does not warm the room.
+ */
+int preheatMinutes(int target) {
+    int32_t temp = modelLastTemp;
+    int32_t goal = (target * 128 - MODEL_REFERENCE) << 5;
+    int minutes = 0;
+    if (modelMinutes < MODEL_MIN_MINUTES || modelTheta[0] <= 0) {
+        return 0;
+    }
+    while (temp < goal && minutes < PREHEAT_MAX_MINUTES) {
+        int64_t rate = ((int64_t)modelTheta[0] * MODEL_ONE + (int64_t)modelTheta[1] * temp
+                        + (int64_t)modelTheta[2] * MODEL_ONE) >> 12;
+        temp += rate >> 4;
+        minutes++;
+    }
+    return minutes;
+}
+
+/*
+ * CRC-16/CCITT (polynomial 0x1021, starting at 0xFFFF) of count bytes
+ */
+uint16_t crc16(const uint8_t *data, int count) {
+    uint16_t crc = 0xFFFF;
+    int x, bit;
+    for (x = 0; x < count; x++) {
+        crc ^= (uint16_t)data[x] << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * Function for answering a command line from the UART
+ *
+ * uartReadCallback() collects the characters; this runs the line once it
+ * is complete and makes room for the next one. Commands are:
+ *   R<level><buckets>  rollup of the last buckets at level s, m, q or h
+ *   S<epoch ms>        answer to a time sync request, digits only
+ *   B<hex>             add bytes to the schedule being uploaded
+ *   U                  check the uploaded schedule and put it in use
+ *   Z<zone>,<setPoint> set the setPoint of a zone
+ *   O<offset>          calibrate the sensor, 1/128 degree added to readings, answered <O,offset>
+ *   M                  RAM summary, <X,section,bytes> and the stack and heap use
+ * Anything else is answered with <E>.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void serviceCommand() {
+    if (!commandReady) {
+        return;
+    }
+    command[commandLength] = '\0';
+    switch (command[0]) {
+        case 'R':
+            queryRollup(command[1], command[1] == '\0' ? 0 : atoi(&command[2]));
+            break;
+        case 'S':
+            syncCommand(&command[1]);
+            break;
+        case 'B':
+            addScheduleBytes(&command[1]);
+            break;
+        case 'U':
+            useSchedule();
+            break;
+        case 'Z':
+            setZone(&command[1]);
+            break;
+        case 'O':
+            setOffset(&command[1]);
+            break;
+        case 'M':
+            sendMemoryToUART();
+            break;
+        default:
+            DISPLAY(snprintf(output, 64, "<E>\n\r"))
+            break;
+    }
+    commandLength = 0;
+    commandReady = false;
+}
+
+/**
+ * Function for running setHeat() when one of its inputs changes
+ *
+ * Called when temperature, setPoint, occupied or tempAge change. With
+ * REACTIVE_HEAT the heater follows at once; otherwise it waits for the
+ * next oneSecondTasks() as before.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void heatInputChanged() {
+    if (REACTIVE_HEAT) {
+        setHeat();
+    }
+}
+
+/**
+ * Function for the tasks that need to be done at 1 second
+ *
+ * I put the logic into separate functions to make the code easier to read.
+ * With REACTIVE_HEAT setHeat() is not needed here, so this is only the
+ * telemetry and the clock. The clock comes from timeMicros(); if a late
+ * pass let more than a second go by, the work for each second is done
+ * for all of them.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void oneSecondTasks() {
+    if (!REACTIVE_HEAT) {
+        setHeat();
+    }
+    sendToUART();
+    sendZonesToUART();
+    while (seconds < (int)(timeMicros() / 1000000)) {
+        incrementSeconds();
+        everySecond();
+    }
+}
+
+/**
+ * Function for the work done once for every second of the clock
+ *
+ * Closes the rollup buckets and the heater accounting, fits the thermal
+ * model once a minute, follows the schedule, and sends the daily, change
+ * and 60 second reports. A change in the sensor health is
+ * sent as <H,flags>.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void everySecond() {
+    if (seconds % SYNC_PERIOD == 1) {
+        requestTimeSync();
+    }
+    rollupSecond();
+    if (seconds % 60 == 0) {
+        updateModel();
+    }
+    updateSchedule();
+    updateHeatAccount();
+    serviceStore();
+    if (seconds % STORE_PERIOD == 0) {
+        saveState();
+    }
+    if (seconds % QUANTILE_PERIOD == 0) {
+        sendQuantilesToUART();
+    }
+    if (health != reportedHealth) {
+        reportedHealth = health;
+        DISPLAY(snprintf(output, 64, "<H,%x>\n\r", health))
+    }
+    if (seconds % WCET_REPORT_PERIOD == 0) {
+        sendWcetToUART();
+        sendI2CStatsToUART();
+        sendI2CQueueToUART();
+        DISPLAY(snprintf(output, 64, "<R,%lu>\n\r", (unsigned long)maxReaction))
+        DISPLAY(snprintf(output, 64, "<T,%lu,%lu>\n\r", (unsigned long)telemetryLines,
+                         (unsigned long)txDropped))
+        DISPLAY(snprintf(output, 64, "<M,%ld,%ld,%ld,%lu>\n\r", (long)modelTheta[0], (long)modelTheta[1],
+                         (long)modelTheta[2], (unsigned long)modelMinutes))
+        DISPLAY(snprintf(output, 64, "<N,%d,%lu,%u,%u>\n\r", ZONES, (unsigned long)zonePassCycles,
+                         (unsigned)ZONE_BYTES, (unsigned)ZONE_SENSOR_BYTES))
+        DISPLAY(snprintf(output, 64, "<J,%lu,%lu,%lu>\n\r", (unsigned long)saved.sequence,
+                         (unsigned long)storeWrites, (unsigned long)storeFailures))
+        DISPLAY(snprintf(output, 64, "<K,%lu,%lu,%lu,%lu>\n\r", (unsigned long)stackUsed(),
+                         (unsigned long)LINKER_VALUE(stackSize), (unsigned long)heapUsed(), (unsigned long)LINKER_VALUE(heapSize)))
+    }
+}
+
+/*
+ * Write a 16 bit register of the temperature sensor straight away, MSB
+ * first. Only for setting up; tasks queue their requests.
+ */
+bool writeRegister(uint8_t reg, uint16_t value) {
+    struct i2c_request request;
+    setupRequest(&request, sensors[sensor].address, reg, NULL, 0, I2C_CONTROL, NULL);
+    request.writeBuf[1] = value >> 8;
+    request.writeBuf[2] = value & 0xFF;
+    request.writeCount = 3;
+    return runI2C(&request);
+}
+
+/*
+ * Pick the fastest bit rate that the controller, the detected sensor and
+ * every other device answering on the bus support, and reopen the bus at
+ * that rate if it is not already running at it
+ */
+void selectBusSpeed(void) {
+    uint16_t speed = I2C_CONTROLLER_MAXSPEED;
+    struct i2c_request probe;
+    int x = 0;
+
+    if (sensor >= 0 && sensors[sensor].maxSpeed < speed) {
+        speed = sensors[sensor].maxSpeed;
+    }
+    if (ZONE_SENSORS > 1 && sensors[TMP116_SENSOR].maxSpeed < speed) {
+        speed = sensors[TMP116_SENSOR].maxSpeed;
+    }
+    if (warmBoot && saved.sensor == sensor && saved.busSpeed <= speed) {
+        // the other devices were probed on the boot that saved it
+        speed = saved.busSpeed;
+    } else {
+        for (x = 0; x < NUMBER_OF_BUS_DEVICES; x++) {
+            setupRequest(&probe, busDevices[x].address, 0, NULL, 0, I2C_CONTROL, NULL);
+            if (busDevices[x].maxSpeed < speed && runI2C(&probe)) {
+                speed = busDevices[x].maxSpeed;
+            }
+        }
+    }
+
+    for (x = NUMBER_OF_BIT_RATES - 1; x > 0 && bitRates[x].speed > speed; x--) {}
+    if (bitRates[x].speed != busSpeed) {
+        I2C_close(i2c);
+        i2cParams.bitRate = bitRates[x].bitRate;
+        i2c = openI2C();
+        if (i2c == NULL) {
+            DISPLAY(snprintf(output, 64, "I2C reopen at %u Kbps failed\n\r", bitRates[x].speed))
+            while (1);
+        }
+        busSpeed = bitRates[x].speed;
+    }
+    DISPLAY(snprintf(output, 64, "I2C bus at %u Kbps\n\r", busSpeed))
+}
+
+/*
+ *  This is the callback for the TMP116 ALERT pin
+ *
+ *  The sensor pulls ALERT low when a conversion falls outside the limit
+ *  registers, so the next updateTemp() reads the new temperature
+ */
+void gpioTempAlert(uint_least8_t index)
+{
+    tempAlert = TRUE;
+    rearmAlert = true;
+    alertFallback = false;
+}
+
+/*
+ * Called as each step of arming the TMP116 alert finishes: the high
+ * limit, then the low limit, then the read of the configuration register
+ * that releases ALERT. A failed step leaves tempAlert set so the next
+ * sample reads the sensor and tries again.
+ */
+void alertArmed(struct i2c_request *request, bool ok) {
+    if (!ok) {
+        tempAlert = TRUE;
+        rearmAlert = true;
+    } else if (request == &highLimitRequest) {
+        if (!queueI2C(&lowLimitRequest)) {
+            tempAlert = TRUE;
+            rearmAlert = true;
+        }
+    } else if (request == &lowLimitRequest) {
+        if (!queueI2C(&alertConfigRequest)) {
+            tempAlert = TRUE;
+            rearmAlert = true;
+        }
+    }
+}
+
+/*
+ * Move the TMP116 limits to the degree around temperature, plus
+ * TMP116_HYSTERESIS on each side, or with HEAT_PWM to TMP116_PI_WINDOW
+ * either side of the filtered reading, so the PI sees every change it
+ * would act on; that window only follows the reading once it has moved
+ * TMP116_PI_FOLLOW. The sensor compares its own codes, so the
+ * calibration comes back off. Nothing is written if the window has not
+ * moved and ALERT is not held. Returns false if the writes could not
+ * be queued.
+ */
+bool armTempAlert(void) {
+    int16_t low = temperature * TMP116_LSB_PER_DEGREE - TMP116_HYSTERESIS - tempOffset;
+    int16_t high = (temperature + 1) * TMP116_LSB_PER_DEGREE + TMP116_HYSTERESIS - tempOffset;
+    if (HEAT_PWM) {
+        int16_t middle = zoneFine[0] - tempOffset;
+        int16_t moved = middle - (alertLow + TMP116_PI_WINDOW);
+        if (!rearmAlert && moved <= TMP116_PI_FOLLOW && moved >= -TMP116_PI_FOLLOW) {
+            return true;
+        }
+        low = middle - TMP116_PI_WINDOW;
+        high = middle + TMP116_PI_WINDOW;
+    }
+    if (!rearmAlert && low == alertLow && high == alertHigh) {
+        return true;
+    }
+    alertLow = low;
+    alertHigh = high;
+    highLimitRequest.writeBuf[1] = (uint16_t)alertHigh >> 8;
+    highLimitRequest.writeBuf[2] = (uint16_t)alertHigh & 0xFF;
+    lowLimitRequest.writeBuf[1] = (uint16_t)alertLow >> 8;
+    lowLimitRequest.writeBuf[2] = (uint16_t)alertLow & 0xFF;
+    rearmAlert = !queueI2C(&highLimitRequest);
+    return !rearmAlert;
+}
+
+/*
+ * Put a TMP116 into event mode: set up its averaging, conversion cycle
+ * and alert function and wake on the ALERT pin instead of polling. The
+ * first updateTemp() reads the sensor and sets the limits.
+ */
+void initTempEvents(void) {
+    uint8_t address = sensors[sensor].address;
+    if (!writeRegister(TMP116_CONFIG_REG, TMP116_CONFIG)) {
+        return;
+    }
+    setupRequest(&highLimitRequest, address, TMP116_HIGH_LIMIT_REG, NULL, 0, I2C_SENSOR, alertArmed);
+    highLimitRequest.writeCount = 3;
+    setupRequest(&lowLimitRequest, address, TMP116_LOW_LIMIT_REG, NULL, 0, I2C_SENSOR, alertArmed);
+    lowLimitRequest.writeCount = 3;
+    setupRequest(&alertConfigRequest, address, TMP116_CONFIG_REG, alertBuffer, 2, I2C_SENSOR, alertArmed);
+    GPIO_setConfig(CONFIG_GPIO_TMP_ALERT, GPIO_CFG_IN_PU | GPIO_CFG_IN_INT_FALLING);
+    GPIO_setCallback(CONFIG_GPIO_TMP_ALERT, gpioTempAlert);
+    GPIO_enableInt(CONFIG_GPIO_TMP_ALERT);
+    tempAlert = TRUE;
+    tempEvents = true;
+}
+
+/*
+ * Check for the BMA222E and start it sampling into its FIFO
+ */
+void initAccel(void) {
+    uint8_t id;
+    accelPresent = readDevice(CONFIG_I2C_0_BMA222E_ADDR, ACCEL_CHIP_ID_REG, &id, 1)
+        && id == ACCEL_CHIP_ID
+        && writeDevice(CONFIG_I2C_0_BMA222E_ADDR, ACCEL_RANGE_REG, ACCEL_RANGE_2G)
+        && writeDevice(CONFIG_I2C_0_BMA222E_ADDR, ACCEL_BW_REG, ACCEL_BW_8HZ)
+        && writeDevice(CONFIG_I2C_0_BMA222E_ADDR, ACCEL_FIFO_CONFIG_REG, ACCEL_FIFO_STREAM);
+    setupRequest(&accelStatusRequest, CONFIG_I2C_0_BMA222E_ADDR, ACCEL_FIFO_STATUS_REG,
+                 &accelStatus, 1, I2C_BACKGROUND, accelStatusRead);
+    setupRequest(&accelFifoRequest, CONFIG_I2C_0_BMA222E_ADDR, ACCEL_FIFO_DATA_REG,
+                 accelBuffer, 0, I2C_BACKGROUND, accelFifoRead);
 }
 
-/**
- * Function for updating the seconds variable
- *
- * Function increments second. Used to enhance readability.
- * Does not take any arguments and does not return anything
- *
-**/
-void incrementSeconds() {
-    seconds++;
+/*
+ * Put a TMP102 class sensor into shutdown so it only converts when
+ * startConversion() asks it to
+ */
+void initOneShot(void) {
+    tempOneShot = writeRegister(TMP102_CONFIG_REG, TMP102_SHUTDOWN);
+    setupRequest(&conversionRequest, sensors[sensor].address, TMP102_CONFIG_REG, NULL, 0, I2C_CONTROL, NULL);
+    conversionRequest.writeBuf[1] = TMP102_START >> 8;
+    conversionRequest.writeBuf[2] = TMP102_START & 0xFF;
+    conversionRequest.writeCount = 3;
 }
 
-/**
- * Function for sending to UART
- *
- * Function sends string of 64 chars to UART. Used to enhance readability.
- * Does not take any arguments and does not return anything
- *
-**/
-void sendToUART() {
-    DISPLAY(snprintf(output, 64, "<%02d,%02d,%d,%04d>\n\r", temperature, setPoint, HEAT_STATE, seconds))
+/*
+ * Queue the probe of the next address in probeOrder
+ */
+void queueProbe(void) {
+    int8_t i = probeOrder[probeStep];
+    setupRequest(&probeRequest, sensors[i].address, sensors[i].resultReg, NULL, 0, I2C_CONTROL, sensorProbed);
+    probeRequest.attempts = 1;
+    queueI2C(&probeRequest);
 }
 
-/**
- * Function for setting heat on or off depending on the setPoint and current temperature
- *
- * Uses a state machine to update HEAT_STATE. If the temperature is less than
- * the setPoint the HEAT_STATE is set to HEAT_ON and the red light is turned on.
- * If the temperature is greater than or equal to setPoint the HEAT_STATE is set to
- * HEAT_OFF and the red light is turned off.
- * Does not take any arguments and does not return anything
- *
-**/
-void setHeat() {
-    // Transitions
-    switch (HEAT_STATE) {
-        case HEAT_OFF:
-            if (temperature < setPoint) {
-                HEAT_STATE = HEAT_ON;
-            }
-            break;
-        case HEAT_ON:
-            if (temperature >= setPoint) {
-                HEAT_STATE = HEAT_OFF;
-            }
-            break;
-        default:
-            break;
+/*
+ * Probe the sensor addresses through the I2C queue, the one the last boot
+ * saved first
+ */
+void startProbes(void) {
+    int8_t i;
+    for (i = 0; i < NUMBER_OF_SENSORS; i++) {
+        probeOrder[i] = i;
     }
-    // Actions
-    switch (HEAT_STATE) {
-        case HEAT_OFF:
-            // light off
-            GPIO_write(CONFIG_GPIO_LED_0, CONFIG_GPIO_LED_OFF);
-            break;
-        case HEAT_ON:
-            // light on
-            GPIO_write(CONFIG_GPIO_LED_0, CONFIG_GPIO_LED_ON);
-            break;
-        default:
-            break;
+    if (saved.sequence > 0 && saved.sensor > 0 && saved.sensor < NUMBER_OF_SENSORS) {
+        probeOrder[saved.sensor] = 0;
+        probeOrder[0] = saved.sensor;
     }
+    probeStep = 0;
+    queueProbe();
 }
 
-/**
- * Function for the tasks that need to be done at 1 second
- *
- * I put the logic into separate functions to make the code easier to read.
- * Does not take any arguments and does not return anything
- *
-**/
-void oneSecondTasks() {
-    setHeat();
-    sendToUART();
-    incrementSeconds();
+/*
+ * Set up the reads of sensors[i], the bus speed and the sensor's mode
+ */
+void useSensor(int8_t i) {
+    sensor = i;
+    setupRequest(&tempRequest, sensors[i].address, sensors[i].resultReg, tempBuffer, 2, I2C_CONTROL, tempRead);
+    setupRequest(&voltageRequest, sensors[i].address, TMP006_VOLTAGE_REG, voltageBuffer, 2, I2C_CONTROL, tempRead);
+    selectBusSpeed();
+    if (TMP116_EVENTS && sensor == TMP116_SENSOR) {
+        initTempEvents();
+    }
+    if (TMP102_ONE_SHOT && sensor == TMP102_SENSOR) {
+        initOneShot();
+    }
+}
+
+/*
+ * Called when a probe finishes. The first sensor that answers is set up;
+ * otherwise the next address is probed. The accelerometer is set up once
+ * the sensors are done either way.
+ */
+void sensorProbed(struct i2c_request *request, bool ok) {
+    int8_t i = probeOrder[probeStep];
+    DISPLAY(snprintf(output, 64, "Is this %s? %s\n\r", sensors[i].id, ok ? "Found" : "No"))
+    if (ok) {
+        DISPLAY(snprintf(output, 64, "Detected TMP%s I2C address: %x\n\r", sensors[i].id, sensors[i].address))
+        useSensor(i);
+    } else if (++probeStep < NUMBER_OF_SENSORS) {
+        queueProbe();
+        return;
+    } else {
+        DISPLAY(snprintf(output, 64, "Temperature sensor not found, contact professor\n\r"))
+    }
+    if (ACCEL_OCCUPANCY) {
+        initAccel();
+    }
+    bootMark("sensor");
 }
 
 // Make sure you call initUART() before calling this function.
 void initI2C(void) {
-    int8_t i, found;
-    I2C_Params i2cParams;
-
     DISPLAY(snprintf(output, 64, "Initializing I2C Driver - "))
 
     // Init the driver
@@ -279,10 +1510,13 @@ void initI2C(void) {
 
     // Configure the driver
     I2C_Params_init(&i2cParams);
-    i2cParams.bitRate = I2C_400kHz;
+    // probe at standard mode, selectBusSpeed() raises it afterwards
+    i2cParams.bitRate = I2C_100kHz;
+    busSpeed = 100U;
+    clockTickPeriod = ClockP_getSystemTickPeriod();
 
     // Open the driver
-    i2c = I2C_open(CONFIG_I2C_0, &i2cParams);
+    i2c = openI2C();
     if (i2c == NULL) {
         DISPLAY(snprintf(output, 64, "Failed\n\r"))
         while (1);
@@ -290,54 +1524,471 @@ void initI2C(void) {
     DISPLAY(snprintf(output, 32, "Passed\n\r"))
     // Boards were shipped with different sensors.
     // Welcome to the world of embedded systems.
-    // Try to determine which sensor we have.
-    // Scan through the possible sensor addresses
-    /* Common I2C transaction setup */
-    i2cTransaction.writeBuf = txBuffer;
-    i2cTransaction.writeCount = 1;
-    i2cTransaction.readBuf = rxBuffer;
-    i2cTransaction.readCount = 0;
-    found = false;
-    for (i=0; i<3; ++i) {
-        i2cTransaction.slaveAddress = sensors[i].address;
-        txBuffer[0] = sensors[i].resultReg;
-        DISPLAY(snprintf(output, 64, "Is this %s? ", sensors[i].id))
-        if (I2C_transfer(i2c, &i2cTransaction)) {
-            DISPLAY(snprintf(output, 64, "Found\n\r"))
-            found = true;
-            break;
+    // Try to determine which sensor we have. The addresses are probed
+    // through the I2C queue once the tasks run, so the rest of the init
+    // does not wait for them. A warm boot takes the sensor the last boot
+    // found without probing and queues its first read at once, so the
+    // first pass takes it instead of the first updateTemp(); if it does
+    // not answer, tempRead() probes as a cold boot does.
+    if (warmBoot && saved.sensor >= 0 && saved.sensor < NUMBER_OF_SENSORS) {
+        DISPLAY(snprintf(output, 64, "Saved TMP%s I2C address: %x\n\r", sensors[saved.sensor].id,
+                         sensors[saved.sensor].address))
+        useSensor(saved.sensor);
+        readTemp();
+        if (ACCEL_OCCUPANCY) {
+            initAccel();
         }
-        DISPLAY(snprintf(output, 64, "No\n\r"))
+        bootMark("sensor");
+        return;
     }
-    if(found) {
-        DISPLAY(snprintf(output, 64, "Detected TMP%s I2C address: %x\n\r", sensors[i].id, i2cTransaction.slaveAddress))
-    } else {
-        DISPLAY(snprintf(output, 64, "Temperature sensor not found, contact professor\n\r"))
+    startProbes();
+}
+
+/*
+ * Integer square root, rounded down
+ */
+uint64_t squareRoot(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/*
+ * TMP006 object temperature, in the same 1/128 degree C units as the
+ * other sensors' result registers.
+ *
+ * voltage is the sensor voltage register (156.25nV per bit) and die the
+ * die temperature register (1/128 degree C per bit). Works out
+ *   S = S0 * (1 + A1 * dT + A2 * dT^2)
+ *   Vos = B0 + B1 * dT + B2 * dT^2
+ *   f = (V - Vos) + C2 * (V - Vos)^2
+ *   Tobj = (Tdie^4 + f / S)^(1/4)
+ * with dT = Tdie - 25C, all in 64 bit integers.
+ */
+int16_t objectTemp(int16_t voltage, int16_t die) {
+    int64_t dt = die >> 2;                  // Q5 degrees
+    int64_t dt2;
+    int64_t sensitivity, offset, volts, f, sq, tdie, tdie4, x;
+    uint64_t root;
+
+    dt -= TMP006_TREF;
+    dt2 = dt * dt;                          // Q10
+    sensitivity = (1LL << 30) + ((TMP006_A1 * dt) >> 5) + ((TMP006_A2 * dt2) >> 30);
+    sensitivity >>= 10;                     // Q20
+    offset = TMP006_B0 + ((TMP006_B1 * dt) >> 5) + ((TMP006_B2 * dt2) >> 20);
+
+    volts = (((int64_t)voltage * 512) << 25) / 100000;     // Q40
+    f = volts - offset;
+    sq = ((f >> 10) * (f >> 10)) >> 20;
+    f += (sq * TMP006_C2) >> 16;
+
+    tdie = (die >> 2) * 32 + KELVIN_Q10;    // Q10 kelvin
+    tdie4 = (tdie * tdie) >> 10;
+    tdie4 = (tdie4 * tdie4) >> 20;          // kelvin^4
+
+    // f / S0 in kelvin^4, then divided by the S polynomial
+    x = (f * (10000000000000000LL / (TMP006_S0 * 16777216LL))) >> 16;
+    x = tdie4 + (x << 20) / sensitivity;
+    if (x < 0) {
+        x = 0;
+    }
+
+    root = squareRoot(squareRoot((uint64_t)x << 24) << 16);    // Q14 kelvin
+    return (int16_t)(((int64_t)root - KELVIN_Q14) >> 7);
+}
+
+/*
+ * Check a reading, in 1/128 degree C, before it is used. Returns false
+ * for a reading outside HEALTH_MIN_CODE to HEALTH_MAX_CODE or one that
+ * moved more than HEALTH_SLEW_CODES a second since the last good reading.
+ * A jump is only dropped, so the last good reading is kept: once
+ * HEALTH_SLEW_REJECTS in a row agree with each other it is a real step and
+ * taken, while HEALTH_SLEW_REJECTS in a row that do not raise HEALTH_SLEW.
+ * Sets HEALTH_STUCK once the code has not changed for HEALTH_STUCK_SECONDS
+ * and clears the flags that a good reading answers.
+ */
+bool checkHealth(int16_t raw) {
+    int32_t allowed;
+    if (raw < HEALTH_MIN_CODE || raw > HEALTH_MAX_CODE) {
+        health |= HEALTH_RANGE;
+        return false;
     }
+    health &= ~HEALTH_RANGE;
+    if (healthPrimed) {
+        allowed = (int32_t)HEALTH_SLEW_CODES * (seconds - lastRawTime + 1);
+        if (raw - lastRaw > allowed || lastRaw - raw > allowed) {
+            allowed = (int32_t)HEALTH_SLEW_CODES * (seconds - slewRawTime + 1);
+            if (slewRejects > 0 && raw - slewRaw <= allowed && slewRaw - raw <= allowed) {
+                slewAgreed++;
+            } else {
+                slewAgreed = 1;
+            }
+            slewRaw = raw;
+            slewRawTime = seconds;
+            if (slewAgreed < HEALTH_SLEW_REJECTS) {
+                if (++slewRejects >= HEALTH_SLEW_REJECTS) {
+                    health |= HEALTH_SLEW;
+                }
+                return false;
+            }
+        }
+    }
+    if (!healthPrimed || raw != lastRaw) {
+        rawChangedTime = seconds;
+        health &= ~HEALTH_STUCK;
+    } else if (seconds - rawChangedTime >= HEALTH_STUCK_SECONDS) {
+        health |= HEALTH_STUCK;
+    }
+    health &= ~(HEALTH_SLEW | HEALTH_STALE);
+    slewRejects = 0;
+    slewAgreed = 0;
+    lastRaw = raw;
+    lastRawTime = seconds;
+    healthPrimed = true;
+    return true;
+}
+
+/*
+ * Forget the filter history, so the next reading is taken as it is
+ */
+void resetFilter(void) {
+    medianCount = 0;
+    medianNext = 0;
+    filterPrimed = false;
 }
 
-int16_t readTemp(void) {
-    int16_t temperature = 0;
-    i2cTransaction.readCount = 2;
-    if (I2C_transfer(i2c, &i2cTransaction)) {
-        /*
-         * Extract degrees C from the received data;
-         * see TMP sensor datasheet
-         */
-        temperature = (rxBuffer[0] << 8) | (rxBuffer[1]);
-        temperature *= 0.0078125;
-        /*
-         * If the MSB is set '1', then we have a 2's complement
-         * negative value which needs to be sign extended
-         */
-        if (rxBuffer[0] & 0x80) {
-            temperature |= 0xF000;
+/*
+ * Filter one reading in 1/128 degree C units and return the result in
+ * the same units.
+ *
+ * The median keeps a sorted copy of the window, so a new reading only
+ * takes the oldest one out and is inserted in its place: a fixed
+ * TEMP_MEDIAN_TAPS steps per sample. The IIR is y += (x - y) >> shift with
+ * TEMP_IIR_FRACTION extra bits so small steps are not lost.
+ */
+int16_t filterTemp(int16_t raw) {
+    int x = 0;
+    int16_t median;
+    int32_t input;
+
+    if (medianCount == TEMP_MEDIAN_TAPS) {
+        // drop the oldest reading from the sorted copy
+        while (medianSorted[x] != medianWindow[medianNext]) {
+            x++;
         }
+        for (; x < medianCount - 1; x++) {
+            medianSorted[x] = medianSorted[x + 1];
+        }
+        medianCount--;
+    }
+    medianWindow[medianNext] = raw;
+    medianNext = (medianNext + 1) % TEMP_MEDIAN_TAPS;
+    for (x = medianCount; x > 0 && medianSorted[x - 1] > raw; x--) {
+        medianSorted[x] = medianSorted[x - 1];
+    }
+    medianSorted[x] = raw;
+    medianCount++;
+    median = medianSorted[medianCount / 2];
+
+    input = (int32_t)median << TEMP_IIR_FRACTION;
+    if (!filterPrimed) {
+        iirState = input;
+        filterPrimed = true;
     } else {
-        DISPLAY(snprintf(output, 64, "Error reading temperature sensor(%d)\n\r",i2cTransaction.status))
-        DISPLAY(snprintf(output, 64, "Please power cycle your board by unplugging USB and plugging back in.\n\r"))
+        iirState += (input - iirState) >> TEMP_IIR_SHIFT;
+    }
+    return (int16_t)(iirState >> TEMP_IIR_FRACTION);
+}
+
+/*
+ * Take the new readings of count zones into their filtered temperatures,
+ * all in 1/128 degree: for every zone with sample set, fine becomes
+ * ZONE_IIR_NEW of raw plus the rest of fine, rounded. The reading goes in
+ * the low and fine in the high halfword of one word, so each zone is one
+ * SMLAD against ZONE_IIR_WEIGHTS.
+ */
+void filterZones(int16_t *fine, const int16_t *raw, const bool *sample, int count) {
+    int x = 0;
+    if (TEMP_IIR_SHIFT == 0) {
+        // ZONE_IIR_NEW does not fit a halfword, the filter is off anyway
+        for (x = 0; x < count; x++) {
+            fine[x] = sample[x] ? raw[x] : fine[x];
+        }
+        return;
+    }
+    for (x = 0; x < count; x++) {
+        if (sample[x]) {
+            uint32_t pair = ((uint32_t)(uint16_t)fine[x] << 16) | (uint16_t)raw[x];
+            fine[x] = (int16_t)(SMLAD(pair, ZONE_IIR_WEIGHTS, 1 << 14) >> 15);
+        }
+    }
+}
+
+/*
+ * Queue a read of the sensor found by initI2C(); tempRead() gets the
+ * result. Returns false if there is no sensor or the queue is full.
+ */
+bool readTemp(void) {
+    if (sensor < 0) {
+        return false;
+    }
+    return queueI2C(&tempRequest);
+}
+
+/*
+ * Called when a temperature read finishes.
+ *
+ * For the TMP006 the die temperature read is followed by the sensor
+ * voltage read and the object temperature is worked out once both are in.
+ * A good reading becomes temperature and, in TMP116 event mode, moves the
+ * alert window; a failed one starts the backoff, or the probes if it is
+ * the first read of a warm boot's saved sensor. A reading outside the
+ * window that came without ALERT puts event mode on its fallback reads.
+ * While the filter is still catching up with a step the sensor is read
+ * every sample, and the window only moves once it has.
+ */
+void tempRead(struct i2c_request *request, bool ok) {
+    int16_t raw, reading;
+    if (ok && request == &tempRequest && sensor == TMP006_SENSOR) {
+        // the TMP006 needs its sensor voltage read in the same sequence
+        ok = queueI2C(&voltageRequest);
+        if (ok) {
+            return;
+        }
+    }
+    if (!ok && warmBoot && sampleMicros == 0) {
+        // the saved sensor is gone: find one as a cold boot does
+        warmBoot = false;
+        sensor = -1;
+        startProbes();
+        return;
+    }
+    if (!ok) {
+        if (i2cFailures < I2C_MAX_BACKOFF_SHIFT) {
+            i2cFailures++;
+        }
+        i2cBackoff = (1 << i2cFailures) - 1;
+        missSample();
+        return;
+    }
+    raw = (tempBuffer[0] << 8) | tempBuffer[1];
+    if (sensor == TMP006_SENSOR) {
+        raw = objectTemp((voltageBuffer[0] << 8) | voltageBuffer[1], raw);
+    }
+    if (tempEvents && !tempAlert && (raw < alertLow || raw > alertHigh)) {
+        // a check read found what ALERT should have reported
+        alertMisses++;
+        alertFallback = true;
+    }
+    raw += tempOffset;
+    reading = raw;
+    if (!checkHealth(raw)) {
+        // keep the last good temperature, as for a failed read
+        missSample();
+        heatInputChanged();
+        return;
+    }
+    if (TEMP_FILTER) {
+        if (tempAge >= MAX_TEMP_AGE) {
+            // the history is too old to smooth the new reading with
+            resetFilter();
+        }
+        raw = filterTemp(raw);
+    }
+    rollupSample(raw);
+    quantileSample(raw);
+    /*
+     * Extract degrees C from the received data;
+     * see TMP sensor datasheet. The result is a 2's complement
+     * value with 0.0078125 (1/128) degrees per bit
+     */
+    temperature = raw / 128;
+    zoneFine[0] = raw;
+    zoneSample[0] = true;
+    if (sampleMicros == 0) {
+        sampleMicros = timeMicros();
+        bootMark("sample");
+        // the first telemetry line goes out with the next pass, not at
+        // the next second
+        tasks[ONE_SECOND_TASK].triggered = TRUE;
+        ready_tasks = TRUE;
+    }
+    tempAge = 0;
+    i2cFailures = 0;
+    if (tempEvents) {
+        quietSamples = 0;
+        // read again next sample until the filter has settled, and if
+        // the window could not be moved
+        tempAlert = raw - reading > TMP116_SETTLED || reading - raw > TMP116_SETTLED
+            || !armTempAlert();
+    }
+    heatInputChanged();
+}
+
+/*
+ *  This is the callback for a character from the UART
+ *
+ *  Adds it to command until the end of the line, then leaves the line
+ *  for serviceCommand(). Characters that come before that is done with the
+ *  line are dropped. Starts the read of the next character.
+ */
+void uartReadCallback(UART_Handle handle, void *buffer, size_t count)
+{
+    if (count == 1 && !commandReady) {
+        if (commandChar == '\r' || commandChar == '\n') {
+            commandTime = timeCycles();
+            commandReady = commandLength > 0;
+        } else if (commandLength < COMMAND_LENGTH - 1) {
+            command[commandLength++] = commandChar;
+        }
+    }
+    UART_read(handle, &commandChar, 1);
+}
+
+/*
+ * Start the UART on the bytes from txTail up to txHead, or the end of the
+ * ring if they wrap round it
+ */
+void sendNext(void) {
+    uint16_t head = txHead;
+    uint16_t tail = txTail;
+    if (head == tail) {
+        txSending = 0;
+        return;
+    }
+    txSending = (head > tail ? head : TX_BUFFER_SIZE) - tail;
+    UART_write(uart, &txBuffer[tail], txSending);
+}
+
+/*
+ *  This is the callback for the end of a UART write
+ *
+ *  Frees the bytes that went out and starts on the next ones. If <S> was
+ *  among them, the time its last byte went out is stamped for the sync.
+ */
+void uartWriteCallback(UART_Handle handle, void *buffer, size_t count)
+{
+    txTail = (txTail + count) % TX_BUFFER_SIZE;
+    txSent += count;
+    if (syncWaiting && (int32_t)(txSent - syncEnd) >= 0) {
+        // the write ended txSent - syncEnd bytes after <S> did
+        syncSent = timeCycles() - (uint64_t)(txSent - syncEnd) * UART_BYTE_CYCLES;
+        syncWaiting = false;
+    }
+    sendNext();
+}
+
+/*
+ * Put the first count bytes of output on the end of the UART ring and
+ * start the UART if it is idle. snprintf() returns the length it wanted,
+ * so a cut off line is sent as far as output holds it.
+ */
+void display(int count) {
+    uint16_t head = txHead;
+    int x = 0;
+    if (count > (int)sizeof output - 1) {
+        count = sizeof output - 1;
+    }
+    if (count <= 0) {
+        return;
+    }
+    if ((head + TX_BUFFER_SIZE - txTail) % TX_BUFFER_SIZE + count >= TX_BUFFER_SIZE) {
+        txDropped++;
+        return;
+    }
+    for (x = 0; x < count; x++) {
+        txBuffer[(head + x) % TX_BUFFER_SIZE] = output[x];
+    }
+    txHead = (head + count) % TX_BUFFER_SIZE;
+    txQueued += count;
+    if (txSending == 0) {
+        sendNext();
+    }
+}
+
+/*
+ * Fill the stack below the live frames and all of the heap with
+ * PAINT_PATTERN. Runs first thing, before anything can have used malloc().
+ */
+void paintMemory(void) {
+    uint32_t live;
+    uint32_t *word = &stackStart;
+    uint32_t *end = (uint32_t *)((uint8_t *)&live - PAINT_MARGIN);
+    while (word < end) {
+        *word++ = PAINT_PATTERN;
+    }
+    for (word = &heapStart; word < (uint32_t *)((uint8_t *)&heapStart + LINKER_VALUE(heapSize)); word++) {
+        *word = PAINT_PATTERN;
+    }
+}
+
+/*
+ * Deepest the stack has been, in bytes. It grows down, so this is from
+ * the lowest word that lost the paint to the top.
+ */
+uint32_t stackUsed(void) {
+    uint32_t *word = &stackStart;
+    uint32_t *top = (uint32_t *)((uint8_t *)&stackStart + LINKER_VALUE(stackSize));
+    while (word < top && *word == PAINT_PATTERN) {
+        word++;
+    }
+    return (uint8_t *)top - (uint8_t *)word;
+}
+
+/*
+ * Most of the heap malloc() has handed out, in bytes. It hands out from
+ * the bottom, so this is up to the highest word that lost the paint.
+ */
+uint32_t heapUsed(void) {
+    uint32_t *top = (uint32_t *)((uint8_t *)&heapStart + LINKER_VALUE(heapSize));
+    while (top > &heapStart && top[-1] == PAINT_PATTERN) {
+        top--;
+    }
+    return (uint8_t *)top - (uint8_t *)&heapStart;
+}
+
+/**
+ * Function for sending the RAM summary to UART
+ *
+ * Sends <X,section,bytes> for each section the linker places in SRAM,
+ * then <X,stack,used,size> and <X,heap,used,size>. On the CC3220S the
+ * whole image is in SRAM, so code and constants count as well.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendMemoryToUART() {
+    DISPLAY(snprintf(output, 64, "<X,text,%lu>\n\r", (unsigned long)LINKER_VALUE(textSize)))
+    DISPLAY(snprintf(output, 64, "<X,const,%lu>\n\r", (unsigned long)LINKER_VALUE(constSize)))
+    DISPLAY(snprintf(output, 64, "<X,cinit,%lu>\n\r", (unsigned long)LINKER_VALUE(cinitSize)))
+    DISPLAY(snprintf(output, 64, "<X,data,%lu>\n\r", (unsigned long)LINKER_VALUE(dataSize)))
+    DISPLAY(snprintf(output, 64, "<X,bss,%lu>\n\r", (unsigned long)LINKER_VALUE(bssSize)))
+    DISPLAY(snprintf(output, 64, "<X,stack,%lu,%lu>\n\r", (unsigned long)stackUsed(),
+                     (unsigned long)LINKER_VALUE(stackSize)))
+    DISPLAY(snprintf(output, 64, "<X,heap,%lu,%lu>\n\r", (unsigned long)heapUsed(),
+                     (unsigned long)LINKER_VALUE(heapSize)))
+}
+
+/*
+ * Stamp the end of a boot phase for the boot profile
+ */
+void bootMark(const char *name) {
+    if (bootPhaseCount < BOOT_PHASES) {
+        bootPhases[bootPhaseCount].name = name;
+        bootPhases[bootPhaseCount].micros = timeMicros();
+        bootPhaseCount++;
     }
-    return temperature;
 }
 
 void initUART(void) {
@@ -349,13 +2000,20 @@ void initUART(void) {
     uartParams.writeDataMode = UART_DATA_BINARY;
     uartParams.readDataMode = UART_DATA_BINARY;
     uartParams.readReturnMode = UART_RETURN_FULL;
-    uartParams.baudRate = 115200;
+    // commands come in a character at a time without blocking the tasks
+    uartParams.readMode = UART_MODE_CALLBACK;
+    uartParams.readCallback = uartReadCallback;
+    // and lines go out from txBuffer without holding the tasks up
+    uartParams.writeMode = UART_MODE_CALLBACK;
+    uartParams.writeCallback = uartWriteCallback;
+    uartParams.baudRate = UART_BAUD;
     // Open the driver
     uart = UART_open(CONFIG_UART_0, &uartParams);
     if (uart == NULL) {
         /* UART_open() failed */
         while (1);
     }
+    UART_read(uart, &commandChar, 1);
 }
 
 /*
@@ -366,15 +2024,19 @@ void initUART(void) {
  *  Every time the timer expires it loops through the array of tasks and
  *  checks if the elapsed time is greater than or equal to the total period
  *  time for the task. If it is the flag for the task is raised and the elapsed
- *  time is reset. If not the elapsed time is incremented by the global period (100ms).
+ *  time is reset to this tick, which is the first of the next period (resetting
+ *  it to 0 released every task a tick late). If not the elapsed time is
+ *  incremented by the global period (100ms).
+ *  It also moves the 64 bit time base on.
  */
 void timerCallback(Timer_Handle myHandle, int_fast16_t status) {
     int x = 0;
+    updateTimeBase();
     for (x = 0; x < NUMBER_OF_TASKS; x++) {
         if (tasks[x].elapsed_time >= tasks[x].period) {
             tasks[x].triggered = TRUE;
             ready_tasks = TRUE;
-            tasks[x].elapsed_time = 0;
+            tasks[x].elapsed_time = global_period;
         } else {
             tasks[x].elapsed_time += global_period;
         }
@@ -416,11 +2078,16 @@ void initTimer(void) {
  *
  *  If the button is pressed it sets BUTTON_STATE to BUTTON_0 so
  *  the next period will register a change in the state and increase
- *  the setPoint
+ *  the setPoint. With REACTIVE_HEAT that period is released straight away.
  */
 void gpioButton0Increase(uint_least8_t index)
 {
     BUTTON_STATE = BUTTON_0;
+    if (REACTIVE_HEAT) {
+        buttonTime = timeCycles();
+        tasks[SETPOINT_TASK].triggered = TRUE;
+        ready_tasks = TRUE;
+    }
 }
 
 /*
@@ -428,11 +2095,16 @@ void gpioButton0Increase(uint_least8_t index)
  *
  *  If the button is pressed it sets BUTTON_STATE to BUTTON_1 so
  *  the next period will register a change in the state and decrease
- *  the setPoint
+ *  the setPoint. With REACTIVE_HEAT that period is released straight away.
  */
 void gpioButton1Decrease(uint_least8_t index)
 {
     BUTTON_STATE = BUTTON_1;
+    if (REACTIVE_HEAT) {
+        buttonTime = timeCycles();
+        tasks[SETPOINT_TASK].triggered = TRUE;
+        ready_tasks = TRUE;
+    }
 }
 
 /*
@@ -441,13 +2113,9 @@ void gpioButton1Decrease(uint_least8_t index)
 void initGPIO(void) {
     GPIO_init();
 
-    /* Configure the LED and button pins */
-    GPIO_setConfig(CONFIG_GPIO_LED_0, GPIO_CFG_OUT_STD | GPIO_CFG_OUT_LOW);
+    /* Configure the button pins */
     GPIO_setConfig(CONFIG_GPIO_BUTTON_0, GPIO_CFG_IN_PU | GPIO_CFG_IN_INT_FALLING);
 
-    /* Start with LEDs off */
-    GPIO_write(CONFIG_GPIO_LED_0, CONFIG_GPIO_LED_OFF);
-
     /* Install Button callback */
     GPIO_setCallback(CONFIG_GPIO_BUTTON_0, gpioButton0Increase);
 
@@ -469,30 +2137,115 @@ void initGPIO(void) {
 }
 
 /*
- *  ======== mainThread ========
+ * Zones start stale, so no heater runs before its first reading, at the
+ * START_TEMP setPoint
  */
-void *mainThread(void *arg0)
-{
-    /* Call driver init functions for GPIO, UART, I2C, and timer */
+void initZones(void) {
+    int x = 0;
+    for (x = 0; x < ZONES; x++) {
+        zoneHealth[x] = HEALTH_STALE;
+        zoneAge[x] = MAX_TEMP_AGE;
+        zoneSetPoint[x] = START_TEMP;
+        zoneTarget[x] = START_TEMP * 128;
+        zoneReportedSeconds[x] = INITIAL_SECONDS - HEARTBEAT_SECONDS;
+        if (x > 0 && x < ZONE_SENSORS) {
+            setupRequest(&zoneRequests[x], zoneAddresses[x], sensors[TMP116_SENSOR].resultReg,
+                         zoneBuffer[x], 2, I2C_CONTROL, zoneRead);
+        }
+    }
+}
+
+/*
+ * The red light is the heater, on PWM so it can be driven at any duty.
+ * It starts off.
+ */
+void initHeater(void) {
+    PWM_Params params;
+
+    PWM_init();
+    PWM_Params_init(&params);
+    params.periodUnits = PWM_PERIOD_US;
+    params.periodValue = HEAT_PWM_PERIOD_US;
+    params.dutyUnits = PWM_DUTY_FRACTION;
+    params.dutyValue = 0;
+    heatPwm = PWM_open(CONFIG_PWM_0, &params);
+    if (heatPwm == NULL) {
+        /* CONFIG_PWM_0 did not open */
+        while (1) {}
+    }
+    PWM_start(heatPwm);
+}
+
+/*
+ * Start the DWT cycle counter so the task loop can time each task. main()
+ * calls it before Board_init(), so the boot profile counts from there.
+ */
+void initProfiler(void) {
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+/*
+ * Call driver init functions for GPIO, PWM, UART, I2C, and timer. The
+ * sensor probes initI2C() queues run with the tasks, and each phase is
+ * stamped for the boot profile.
+ */
+void initThermostat(void) {
     initGPIO();
+    bootMark("gpio");
+    initHeater();
+    bootMark("heater");
     initUART();
+    bootMark("uart");
+    initStore();
+    bootMark("store");
     initI2C();
+    bootMark("i2c");
+    initZones();
+    bootMark("zones");
     initTimer();
+    bootMark("timer");
+    initMicros = timeMicros();
+}
+
+/*
+ * One pass of the task loop: runs every triggered task in table order and
+ * resets its flag. The run time of each task is kept so the worst case
+ * can be reported.
+ */
+void runTasks(void) {
+    int x = 0;
+    uint32_t start, cycles;
+    for (x = 0; x < NUMBER_OF_TASKS; x++) {
+        if (tasks[x].triggered) {
+            start = DWT_CYCCNT;
+            tasks[x].f();
+            cycles = DWT_CYCCNT - start;
+            if (cycles > tasks[x].max_cycles) {
+                tasks[x].max_cycles = cycles;
+            }
+            tasks[x].triggered = FALSE;
+        }
+    }
+}
+
+/*
+ *  ======== mainThread ========
+ */
+void *mainThread(void *arg0)
+{
+    paintMemory();
+    initThermostat();
 
     /* This is from the video for the task manager. It runs the timer callback until
-     * a task is ready. Then it loops over all the tasks and if the task is triggered
-     * it runs the associated function and resets the flag.
+     * a task is ready. Then it runs a pass over all the tasks, which runs each
+     * triggered task and resets its flag.
      */
     while (TRUE) {
-        int x = 0;
         while (!ready_tasks) {}
         ready_tasks = FALSE;
-        for (x = 0; x < NUMBER_OF_TASKS; x++) {
-            if (tasks[x].triggered) {
-                tasks[x].f();
-                tasks[x].triggered = FALSE;
-            }
-        }
+        runTasks();
     }
 
     return (NULL);
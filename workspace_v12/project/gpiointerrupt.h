@@ -0,0 +1,656 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== gpiointerrupt.h ========
+ */
+
+// Configuration, types and globals of the thermostat that the firmware's
+// units share: gpiointerrupt.c runs the tasks, and the I2C queue, rollups,
+// quantiles, schedule and store have their own .c and .h next to it. The
+// host harnesses in tools include this header and link against the units.
+
+#ifndef gpiointerrupt_h
+#define gpiointerrupt_h
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Driver Header files */
+#include <ti/drivers/GPIO.h>
+#include <ti/drivers/Timer.h>
+#include <ti/drivers/I2C.h>
+#include <ti/drivers/PWM.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/dpl/ClockP.h>
+#include <ti/drivers/net/wifi/simplelink.h>
+
+#ifdef HOST_BUILD
+#include "host.h"
+#endif
+
+/* Driver configuration */
+#include "ti_drivers_config.h"
+
+/* Dual 16 bit multiply accumulate of the Cortex-M4 DSP extension, see smlad() */
+#if defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#define SMLAD(a, b, sum) __smlad(a, b, sum)
+#elif defined(__TI_ARM__) && defined(__TI_TMS470_V7M4__)
+#define SMLAD(a, b, sum) _smlad(a, b, sum)
+#else
+#define SMLAD(a, b, sum) smlad(a, b, sum)
+#endif
+
+#include "i2cqueue.h"
+#include "rollups.h"
+#include "quantiles.h"
+#include "schedule.h"
+#include "store.h"
+
+#define DISPLAY(x) display(x);
+#define TRUE 1
+#define FALSE 0
+#ifndef NULL
+#define NULL 0
+#endif
+#define NUMBER_OF_TASKS 7
+#define GLOBAL_PERIOD 100
+#define INTERRUPT_PERIOD 200
+#define TEMP_PERIOD 500
+#define UART_PERIOD 1000
+#define ACCEL_PERIOD 1500
+#define I2C_PERIOD 0                // every timer tick
+#define COMMAND_PERIOD 200
+#define START_TEMP 25
+#define MIN_SETPOINT 0
+#define MAX_SETPOINT 99
+#define INITIAL_TEMP 0
+#define INITIAL_SECONDS 0
+#define CPU_FREQUENCY 80000000
+#define WCET_REPORT_PERIOD 60
+#define REACTIVE_HEAT TRUE          // setHeat() runs as soon as one of its inputs changes
+#define SETPOINT_TASK 0             // index of changeTempSetPoint in tasks[]
+#define ONE_SECOND_TASK 3           // index of oneSecondTasks in tasks[]
+
+// Report by exception: sendToUART() only sends a line when something moved
+// by TELEMETRY_DEADBAND or more, or HEARTBEAT_SECONDS after the last line.
+// A receiver holds the last values it got until the next line.
+#define TELEMETRY_BY_EXCEPTION TRUE
+#define TELEMETRY_DEADBAND 1        // degrees the temperature has to move
+#define HEARTBEAT_SECONDS 60
+
+// UART commands
+#define COMMAND_LENGTH 72           // longest UART command line, with its end
+
+// Time sync: every SYNC_PERIOD the device sends <S> and the host answers
+// S<epoch ms>. The answer is taken as stamped half way through the round
+// trip, which starts when the last byte of <S> has gone out, and
+// successive syncs give the drift of the CPU clock
+#define SYNC_PERIOD 600             // seconds
+#define SYNC_MAX_RTT_US 20000       // slower answers say too little about when they were stamped
+#define SYNC_SKEW_SHIFT 2           // skew averages over about 4 syncs
+
+// Thermal model for optimal start: once a minute recursive least squares
+// fits  change = heating * duty + loss * (temperature - MODEL_REFERENCE) + drift
+// to the minute rollups, so the heat can come on early enough for the
+// next schedule entry to find the room at its setPoint
+#define MODEL_ONE 4096              // Q12, inputs are Q12 and the fit is Q16 degrees a minute
+#define MODEL_REFERENCE (20 * 128)  // 1/128 degree C the temperature input is measured from
+#define MODEL_LAMBDA_SHIFT 8        // forgetting factor 1 - 1/256, about 4 hours of minutes
+#define MODEL_P_START (100LL << 24) // Q24, little trust in the first fit
+#define MODEL_P_MAX (1000LL << 24)  // stop forgetting a direction the inputs never move in
+#define MODEL_MIN_MINUTES 120       // minutes of fitting before the model is used
+#define PREHEAT_MAX_MINUTES 180
+
+// I2C sensors and bus speeds, the transfer limits are in i2cqueue.h
+#define NUMBER_OF_SENSORS 3
+#define I2C_MAX_BACKOFF_SHIFT 3     // skip at most 2^3 - 1 samples after failures
+#define MAX_TEMP_AGE 10             // samples a reading is trusted for without a new one
+#define I2C_CONTROLLER_MAXSPEED 400U    // Kbps, the CC32XX I2C driver stops at fast mode
+#define NUMBER_OF_BUS_DEVICES 1
+#define NUMBER_OF_BIT_RATES 4
+
+// TMP116 event mode: the sensor averages on its own and raises ALERT when
+// the temperature leaves the window around the last reading. ALERT is open
+// drain, wired to BoosterPack pin 18 (CONFIG_GPIO_TMP_ALERT) with the pad's
+// pull-up. A quiet sensor is still read every TMP116_CHECK_SAMPLES; if that
+// read finds the temperature outside the window ALERT did not work, and the
+// sensor is read every second until the next ALERT edge. The PI of
+// HEAT_PWM acts on every 1/128 degree, so with it the window is instead
+// TMP116_PI_WINDOW either side of the filtered reading.
+#define TMP116_EVENTS TRUE
+#define TMP116_SENSOR 1             // index of the TMP116 in sensors[]
+#define TMP116_CONFIG_REG 0x01
+#define TMP116_HIGH_LIMIT_REG 0x02
+#define TMP116_LOW_LIMIT_REG 0x03
+#define TMP116_CONFIG 0x0220        // continuous, 1s cycle, 8 averages, alert mode, active low
+#define TMP116_LSB_PER_DEGREE 128
+#define TMP116_HYSTERESIS 32        // window reaches 0.25 degrees past the current degree
+#define TMP116_PI_WINDOW (HEAT_DUTY_STEP / HEAT_KP / 2)    // 12 codes, the duty moves under half a HEAT_DUTY_STEP unseen
+#define TMP116_PI_FOLLOW (TMP116_PI_WINDOW / 4)    // codes the filter moves before that window follows it
+#define TMP116_SETTLED (HEAT_PWM ? 2 : TMP116_HYSTERESIS)  // filter this close to the reading
+#define TMP116_CHECK_SAMPLES 60     // read every 30s anyway to prove the sensor and ALERT work
+#define TMP116_FALLBACK_SAMPLES (1000 / TEMP_PERIOD)    // read every second while ALERT does not
+
+// TMP102 one-shot mode: the sensor sleeps between samples and
+// startConversion() wakes it one tick before updateTemp() reads it
+#define TMP102_ONE_SHOT TRUE
+#define TMP102_SENSOR 0             // index of the TMP102 class sensor in sensors[]
+#define TMP102_CONFIG_REG 0x01
+#define TMP102_SHUTDOWN 0x61A0      // 12 bit resolution, shutdown mode
+#define TMP102_START 0xE1A0         // shutdown mode plus the one-shot bit
+#define CONVERSION_LEAD GLOBAL_PERIOD   // a conversion takes 26ms typical, 35ms max
+
+// TMP006 thermopile: object temperature from the sensor voltage and the die
+// temperature, see the TMP006 user's guide. The coefficients are fixed point,
+// Qn meaning scaled by 2^n, because the M4 has no FPU.
+#define TMP006_SENSOR 2             // index of the TMP006 in sensors[]
+#define TMP006_VOLTAGE_REG 0x00
+#define TMP006_S0 640               // sensitivity calibration, units of 1e-16
+#define TMP006_A1 1879048LL         // 1.75e-3 in Q30
+#define TMP006_A2 -18892600437LL    // -1.678e-5 in Q50
+#define TMP006_B0 -32325642LL       // -2.94e-5 V in Q40
+#define TMP006_B1 -626722LL         // -5.7e-7 V in Q40
+#define TMP006_B2 5212917LL         // 4.63e-9 V in Q50
+#define TMP006_C2 878182LL          // 13.4 in Q16
+#define TMP006_TREF 800             // 25C in the die register's 1/32 degree units
+#define KELVIN_Q10 279706LL         // 273.15 in Q10
+#define KELVIN_Q14 4475290LL        // 273.15 in Q14
+
+// Temperature filter: a running median of TEMP_MEDIAN_TAPS readings takes
+// out single bad samples, then a first order IIR smooths the noise that
+// would otherwise flip the heater around the setPoint
+#define TEMP_FILTER TRUE
+#define TEMP_MEDIAN_TAPS 3          // odd, 1 turns the median off
+#define TEMP_IIR_SHIFT 2            // time constant of 2^shift samples, 0 turns it off
+#define TEMP_IIR_FRACTION 8         // fraction bits the IIR keeps below 1/128 degree
+// The zones past zone 0 get the same IIR in one batch, each step a Q15
+// weighted sum of the reading and the last output that a single SMLAD
+// works out. With no fraction bits it settles within 2/128 degree.
+#define ZONE_IIR_NEW (32768 >> TEMP_IIR_SHIFT)      // Q15 weight of a new reading
+#define ZONE_IIR_WEIGHTS (((uint32_t)(32768 - ZONE_IIR_NEW) << 16) | ZONE_IIR_NEW)
+
+// Heater accounting: exact on time from the setHeat() transitions, timed
+// with the cycle counter, and the duty cycle over each DUTY_WINDOW
+#define HEATER_WATTS 1500
+#define DUTY_WINDOW 900             // seconds
+
+// Heater output: with HEAT_PWM the heater (the red light stands in for it)
+// gets a PWM duty from a PI controller on the filtered temperature, which
+// saves the overshoot and cycling of on/off. Otherwise it is fully on or
+// off as before. Duties are Q16 either way, HEAT_DUTY_MAX is fully on
+#define HEAT_PWM TRUE
+#define HEAT_PWM_PERIOD_US 1000
+#define HEAT_DUTY_MAX 65536
+#define HEAT_KP 256                 // duty per 1/128 degree below the target, fully on 2 degrees below
+#define HEAT_KI 28                  // Q8 duty per 1/128 degree per TEMP_PERIOD, about 20 minutes integral time
+#define HEAT_KI_MAX_MS (TMP116_CHECK_SAMPLES * TEMP_PERIOD)    // longest gap between readings the integral spans
+#define HEAT_DUTY_STEP 6554         // most the duty moves in one sample, 10%, whatever else comes in
+
+// Zones: zone 0 is the board's own sensor and heater. The others are TMP116
+// sensors at ZONE_ADDRESSES on the same bus, each with a setPoint from
+// Z<zone>,<setPoint> and a duty sent out as <Z,zone,temp,setPoint,duty>
+// for an external heater driver. The controller state is one array per
+// field, gathered in a struct zone_arrays, so controlPass() is a single
+// loop over any number of zones. Only the first ZONE_SENSORS are read on
+// the bus: a TMP116 only has 4 addresses and the board's sensors use two
+// of them. The zones past those stay stale, their heat off, until their
+// readings are passed to zoneReading().
+#define ZONES 1
+#define MAX_ZONE_SENSORS 3
+#define ZONE_SENSORS (ZONES < MAX_ZONE_SENSORS ? ZONES : MAX_ZONE_SENSORS)
+#define ZONE_ADDRESSES { 0x00, 0x4A, 0x4B }     // zone 0 is whichever of sensors[] was found
+#define ZONE_DUTY_DEADBAND 3277     // Q16 duty change that is sent at once, 5%
+// RAM a zone takes, and a zone with a sensor on the bus on top of it
+#define ZONE_BYTES (sizeof zoneFine[0] + sizeof zoneRaw[0] + sizeof zoneTarget[0] + sizeof zoneHealth[0] \
+                    + sizeof zoneSample[0] + sizeof zoneIntegral[0] + sizeof zoneIntegrated[0] + sizeof zoneDuty[0] \
+                    + sizeof zoneBase[0] + sizeof zoneAge[0] + sizeof zoneSlewRaw[0] + sizeof zoneSlewRejects[0] \
+                    + sizeof zoneSlewAgreed[0] + sizeof zoneSetPoint[0] + sizeof zoneReportedTemp[0] \
+                    + sizeof zoneReportedSetPoint[0] + sizeof zoneReportedDuty[0] + sizeof zoneReportedSeconds[0])
+#define ZONE_SENSOR_BYTES (sizeof zoneBuffer[0] + sizeof zoneRequests[0])
+#if ZONES < 1
+#error "ZONES must be at least 1"
+#endif
+
+// UART output: DISPLAY() copies the line into a TX_BUFFER_SIZE ring and the
+// UART sends it in callback mode, so a line costs a copy instead of its
+// time on the wire. A line that does not fit is dropped and counted.
+#define TX_BUFFER_SIZE 1024         // a 60 second report block is about 700 bytes
+#define UART_BAUD 115200
+#define UART_BYTE_CYCLES (CPU_FREQUENCY / (UART_BAUD / 10))  // start, eight, stop
+
+// Memory: the stack and the heap are filled with PAINT_PATTERN at boot, so
+// the first word that does not hold it any more is how far each has ever
+// reached. Sent every WCET_REPORT_PERIOD as <K,stackUsed,stackSize,
+// heapUsed,heapSize>; M over UART also sends the section sizes. The
+// bounds come from START() and SIZE() in cc32xxs_nortos.cmd.
+#define PAINT_PATTERN 0xA5A5A5A5
+#define PAINT_MARGIN 64             // bytes left alone below the live stack when painting
+#define LINKER_VALUE(symbol) ((uint32_t)(uintptr_t)&(symbol))
+
+// Boot profile: bootMark() stamps the end of each init phase, the sensor
+// probes and the first sample with timeMicros(), from the Board_init()
+// in main(). They are sent as <G,phase,us> lines with the first telemetry
+// line that has a temperature in it, which the first sample releases.
+#define BOOT_PHASES 12
+
+// Sensor calibration, set with O<1/128 degrees> and kept in STORE_FILE
+#define MAX_TEMP_OFFSET 1280        // 1/128 degree the calibration may move a reading, 10 degrees
+
+// Sensor health: readings that are out of range or move faster than a room
+// can are not used, a reading that never changes means a frozen sensor.
+// Any fault turns the heat off until it clears.
+#define HEALTH_STALE 0x01           // no good reading for MAX_TEMP_AGE samples
+#define HEALTH_RANGE 0x02           // reading outside what the sensors can report
+#define HEALTH_SLEW 0x04            // HEALTH_SLEW_REJECTS jumps in a row that were not a step
+#define HEALTH_STUCK 0x08           // same code for HEALTH_STUCK_SECONDS
+#define HEALTH_MIN_CODE (-40 * 128) // 1/128 degree C
+#define HEALTH_MAX_CODE (125 * 128)
+#define HEALTH_SLEW_CODES 128       // 1 degree a second
+#define HEALTH_SLEW_REJECTS 3       // jumps in a row that agree before the new level is believed
+#define HEALTH_STUCK_SECONDS 3600
+
+// BMA222E accelerometer: it samples into its own FIFO and updateActivity()
+// empties the FIFO in one burst, the movement it sees marks the room occupied
+#define ACCEL_OCCUPANCY TRUE
+#define ACCEL_CHIP_ID_REG 0x00
+#define ACCEL_CHIP_ID 0xF8
+#define ACCEL_FIFO_STATUS_REG 0x0E
+#define ACCEL_RANGE_REG 0x0F
+#define ACCEL_RANGE_2G 0x03
+#define ACCEL_BW_REG 0x10
+#define ACCEL_BW_8HZ 0x08           // 7.81Hz bandwidth, 15.63 samples a second
+#define ACCEL_FIFO_CONFIG_REG 0x3E
+#define ACCEL_FIFO_STREAM 0x80      // keep the newest frames, X Y and Z
+#define ACCEL_FIFO_DATA_REG 0x3F
+#define ACCEL_FIFO_DEPTH 32         // frames, about 2s of samples
+#define ACCEL_FRAME_BYTES 6
+#define ACTIVITY_SHIFT 3            // activity averages over about 8 bursts
+#define ACTIVITY_THRESHOLD 48       // mean change per frame in 1/16 counts
+#define VACANT_BURSTS 400           // about 10 minutes without movement
+#define SETBACK_DEGREES 3           // setPoint is lowered by this while vacant
+
+// a full FIFO burst at the slowest bit rate (10us a bit) has to fit in
+// the time between two temperature samples
+#if ((ACCEL_FIFO_DEPTH * ACCEL_FRAME_BYTES + 4) * 9 * 10) > (TEMP_PERIOD * 1000)
+#error "an accelerometer FIFO burst does not fit in TEMP_PERIOD"
+#endif
+
+// Cortex-M4 debug registers used to count cycles spent in each task. The
+// host build in tools/host puts a cycle counter on its simulated clock in
+// their place.
+#ifndef HOST_BUILD
+#define DEMCR (*(volatile uint32_t *)0xE000EDFC)
+#define DWT_CTRL (*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT (*(volatile uint32_t *)0xE0001004)
+#endif
+#define DEMCR_TRCENA 0x01000000
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define CYCLES_PER_US (CPU_FREQUENCY / 1000000)
+
+/*
+ * The SMLAD instruction in C where the compiler has no intrinsic for it:
+ * sum plus the products of the low and of the high signed halfwords of a
+ * and b.
+ */
+static inline int32_t smlad(uint32_t a, uint32_t b, int32_t sum) {
+    return sum + (int16_t)(a & 0xFFFF) * (int16_t)(b & 0xFFFF) + (int16_t)(a >> 16) * (int16_t)(b >> 16);
+}
+
+// define the states for the state machines and set the initial state
+enum BUTTON_STATES {NONE, BUTTON_0, BUTTON_1};
+extern enum BUTTON_STATES BUTTON_STATE;
+/*
+ * since enum sets HEAT_OFF to 0 and HEAT_ON to 1 I can use HEAT_STATE
+ * directly in the output to the UART
+ */
+enum HEAT_STATES {HEAT_OFF, HEAT_ON};
+extern enum HEAT_STATES HEAT_STATE;
+
+// UART Global Variables
+extern char output[64];
+extern int bytesToSend;
+extern char txBuffer[TX_BUFFER_SIZE];
+extern volatile uint16_t txHead;     // where the next line goes
+extern volatile uint16_t txTail;     // the first byte not sent yet
+extern volatile uint16_t txSending;  // bytes the UART is sending from txTail, 0 if idle
+extern uint32_t txDropped;
+extern uint32_t txQueued;            // bytes put in the ring since boot
+extern volatile uint32_t txSent;     // bytes of those the UART has sent
+
+// Memory Global Variables, linker symbols whose address is the value
+extern uint32_t stackStart, stackSize, heapStart, heapSize;
+extern uint32_t textSize, constSize, cinitSize, dataSize, bssSize;
+
+// Memory Global Variables, linker symbols whose address is the value
+extern uint32_t stackStart, stackSize, heapStart, heapSize;
+extern uint32_t textSize, constSize, cinitSize, dataSize, bssSize;
+
+// Boot profile Global Variables
+struct boot_phase {
+    const char *name;
+    uint32_t micros;
+};
+extern struct boot_phase bootPhases[BOOT_PHASES];
+extern int bootPhaseCount;
+extern uint32_t initMicros;         // boot to the end of the init functions
+extern uint32_t sampleMicros;       // boot to the first good temperature
+extern uint32_t bootMicros;         // boot to the first telemetry line after the first sample
+
+// I2C Global Variables
+struct sensor_info {
+    uint8_t address;
+    uint8_t resultReg;
+    char *id;
+    uint16_t maxSpeed;  // Kbps
+};
+extern const struct sensor_info sensors[NUMBER_OF_SENSORS];
+// other devices sharing CONFIG_I2C_0, they limit the bus speed if present
+struct bus_device {
+    uint8_t address;
+    uint16_t maxSpeed;  // Kbps
+};
+extern const struct bus_device busDevices[NUMBER_OF_BUS_DEVICES];
+struct bit_rate {
+    uint16_t speed;     // Kbps
+    I2C_BitRate bitRate;
+};
+extern const struct bit_rate bitRates[NUMBER_OF_BIT_RATES];
+extern int i2cFailures;
+extern int i2cBackoff;
+extern int8_t sensor;
+extern int8_t probeOrder[NUMBER_OF_SENSORS];
+extern int probeStep;
+extern struct i2c_request probeRequest;
+extern uint16_t busSpeed;
+// Sensor mode Global Variables
+extern bool tempEvents;
+extern bool tempOneShot;
+extern volatile unsigned char tempAlert;
+extern volatile bool alertFallback;     // ALERT missed a change, read every second
+extern volatile bool rearmAlert;        // write the window even if it has not moved
+extern int quietSamples;
+extern int16_t alertLow, alertHigh;     // window the TMP116 is armed with, in its own codes
+extern uint32_t alertMisses;
+extern uint8_t tempBuffer[2];
+extern uint8_t voltageBuffer[2];
+extern uint8_t alertBuffer[2];
+extern struct i2c_request tempRequest;
+extern struct i2c_request voltageRequest;
+extern struct i2c_request conversionRequest;
+extern struct i2c_request highLimitRequest;
+extern struct i2c_request lowLimitRequest;
+extern struct i2c_request alertConfigRequest;
+
+// Accelerometer Global Variables
+extern bool accelPresent;
+extern uint8_t accelBuffer[ACCEL_FIFO_DEPTH * ACCEL_FRAME_BYTES];
+extern int8_t lastAccel[3];
+extern int32_t activity;
+extern int quietBursts;
+extern unsigned char occupied;
+extern uint8_t accelStatus;
+extern struct i2c_request accelStatusRequest;
+extern struct i2c_request accelFifoRequest;
+
+// Temperature filter Global Variables
+extern int16_t medianWindow[TEMP_MEDIAN_TAPS];  // readings in arrival order, oldest at medianNext
+extern int16_t medianSorted[TEMP_MEDIAN_TAPS];  // the same readings in order
+extern int medianCount;
+extern int medianNext;
+extern int32_t iirState;
+extern bool filterPrimed;
+
+// Heater accounting Global Variables
+extern uint64_t heatCheckpoint;      // timeCycles() the times below were added up to
+extern uint64_t heatTotalCycles;     // all the time accounted for
+extern uint64_t heatOnCycles;        // the part of it the heat was on
+extern uint32_t heatCycles;          // times the heat turned on
+extern uint64_t windowTotalCycles;   // the two totals when the duty window started
+extern uint64_t windowOnCycles;
+extern uint16_t dutyPermille;        // duty cycle of the last full window
+extern uint32_t heatSecondFraction;  // duty not yet counted as a heater second
+
+// Heater output Global Variables
+extern PWM_Handle heatPwm;
+extern int32_t heatDuty;            // Q16, what the heater is driven at now
+
+// Zone Global Variables, one entry per zone, or per zone read on the bus
+// for the requests. Zone 0 is kept up to date from the single zone
+// variables; its request and telemetry entries are not used.
+struct zone_arrays {
+    int16_t *fine;                  // filtered temperature in 1/128 degree
+    int16_t *raw;                   // last good reading, filterZones() takes it into fine
+    int16_t *target;                // 1/128 degree
+    unsigned char *health;          // HEALTH_ flags
+    bool *sample;                   // a reading came in since the integral last moved
+    int32_t *integral;              // Q8 of a Q16 duty
+    uint32_t *integrated;           // ms the integral last moved
+    int32_t *duty;                  // Q16
+    int32_t *base;                  // duty at the last reading, the duty stays within HEAT_DUTY_STEP of it
+    uint8_t *age;                   // samples since the last good reading
+    int16_t *slewRaw;               // last reading dropped as a jump
+    uint8_t *slewRejects;           // jumps dropped in a row
+    uint8_t *slewAgreed;            // of those, the last in a row that agree with each other
+};
+extern int16_t zoneFine[ZONES];
+extern int16_t zoneRaw[ZONES];
+extern int16_t zoneTarget[ZONES];
+extern unsigned char zoneHealth[ZONES];
+extern bool zoneSample[ZONES];
+extern int32_t zoneIntegral[ZONES];
+extern uint32_t zoneIntegrated[ZONES];
+extern int32_t zoneDuty[ZONES];
+extern int32_t zoneBase[ZONES];
+extern uint8_t zoneAge[ZONES];
+extern int16_t zoneSlewRaw[ZONES];
+extern uint8_t zoneSlewRejects[ZONES];
+extern uint8_t zoneSlewAgreed[ZONES];
+extern const struct zone_arrays allZones;
+extern uint8_t zoneSetPoint[ZONES];
+extern uint8_t zoneBuffer[ZONE_SENSORS][2];
+extern struct i2c_request zoneRequests[ZONE_SENSORS];
+extern int8_t zoneReportedTemp[ZONES];
+extern uint8_t zoneReportedSetPoint[ZONES];
+extern int32_t zoneReportedDuty[ZONES];
+extern int zoneReportedSeconds[ZONES];
+extern uint32_t zonePassCycles;     // longest controlZones()
+extern int16_t tempOffset;          // calibration, set with O<1/128 degrees>
+
+// Sensor health Global Variables
+extern unsigned char health;            // HEALTH_ flags, stale until the first reading
+extern unsigned char reportedHealth;
+extern int16_t lastRaw;
+extern int lastRawTime;
+extern int rawChangedTime;
+extern int slewRejects;                 // jumps in a row
+extern int slewAgreed;                  // of them, in a row near the one before
+extern int16_t slewRaw;                 // the last jump
+extern int slewRawTime;
+extern bool healthPrimed;
+
+// Driver Handles - Global variables
+extern I2C_Handle i2c;
+extern UART_Handle uart;
+extern Timer_Handle timer0;
+
+// global variables
+extern int temperature;
+extern int tempAge;
+extern int setPoint;
+extern int seconds;
+
+// Telemetry Global Variables, what the last line sent said
+extern int reportedTemp;
+extern int reportedSetPoint;
+extern enum HEAT_STATES reportedHeat;
+extern int reportedSeconds;
+extern uint32_t telemetryLines;
+
+// Thermal model Global Variables
+extern int64_t modelP[3][3];        // Q24 covariance
+extern int32_t modelTheta[3];       // Q16 heating, loss and drift
+extern int32_t modelLastTemp;       // Q12 degrees from MODEL_REFERENCE, last minute's average
+extern int modelLastHeat;           // heater seconds in the last minute
+extern bool modelPrimed;
+extern uint32_t modelMinutes;
+
+// UART command Global Variables, filled in by uartReadCallback()
+extern char commandChar;
+extern char command[COMMAND_LENGTH];
+extern int commandLength;
+extern volatile bool commandReady;
+extern uint64_t commandTime;        // timeCycles() when the line ended
+
+// Time sync Global Variables
+extern volatile uint64_t syncSent;  // timeCycles() when the last byte of <S> went out
+extern uint32_t syncEnd;            // txQueued with <S> in the ring
+extern volatile bool syncWaiting;   // <S> has not all gone out yet
+extern bool syncPending;
+extern bool synced;
+extern bool skewKnown;
+extern uint64_t syncDevice;         // timeMicros() of the last good sync
+extern uint64_t syncWall;           // epoch microseconds at that time
+extern int32_t skewPpb;             // how much faster than the CPU clock the wall clock runs
+extern uint32_t syncRtt;
+
+// Timebase Global Variables
+// timerCallback() keeps the cycle count that DWT_CYCCNT stood at in one of
+// two slots, alternately, and bumps timeGeneration once the slot is written
+struct time_base {
+    uint32_t high;
+    uint32_t low;
+};
+extern volatile struct time_base timeBases[2];
+extern volatile uint32_t timeGeneration;
+
+extern volatile unsigned char ready_tasks;
+extern volatile uint64_t buttonTime;  // timeCycles() when a button was last pressed
+extern uint32_t maxReaction;          // most cycles from a button press to the heater
+extern int global_period;
+
+// global variables for the task manager
+struct task_entry {
+    void (*f)();
+    int elapsed_time;
+    int period;
+    char triggered;
+    uint32_t max_cycles;
+};
+extern struct task_entry tasks[NUMBER_OF_TASKS];
+
+// the functions of gpiointerrupt.c
+void changeTempSetPoint();
+void startConversion();
+void missSample();
+void updateTemp();
+bool ageZones(const struct zone_arrays *zones, int count);
+bool zoneReading(const struct zone_arrays *zones, int zone, int16_t raw);
+void readZones(void);
+void zoneRead(struct i2c_request *request, bool ok);
+void setZone(char *args);
+void updateActivity();
+void accelStatusRead(struct i2c_request *request, bool ok);
+void accelFifoRead(struct i2c_request *request, bool ok);
+int heatTarget();
+void updateTimeBase(void);
+uint64_t timeCycles(void);
+uint64_t timeMicros(void);
+void incrementSeconds();
+void sendToUART();
+void sendZonesToUART();
+void sendWcetToUART();
+void accountHeat(void);
+void driveHeater(int32_t duty);
+void controlPass(const struct zone_arrays *zones, int count, uint32_t now);
+void controlZones(void);
+void updateHeatAccount();
+void setHeat();
+uint64_t wallMicros(uint64_t micros);
+void requestTimeSync(void);
+void timeSync(uint64_t epochMs);
+void syncCommand(const char *text);
+void setOffset(const char *text);
+void updateModel();
+int preheatMinutes(int target);
+uint16_t crc16(const uint8_t *data, int count);
+void serviceCommand();
+void heatInputChanged();
+void oneSecondTasks();
+void everySecond();
+bool writeRegister(uint8_t reg, uint16_t value);
+void selectBusSpeed(void);
+void gpioTempAlert(uint_least8_t index);
+void alertArmed(struct i2c_request *request, bool ok);
+bool armTempAlert(void);
+void initTempEvents(void);
+void initAccel(void);
+void initOneShot(void);
+void queueProbe(void);
+void startProbes(void);
+void useSensor(int8_t i);
+void sensorProbed(struct i2c_request *request, bool ok);
+void initI2C(void);
+uint64_t squareRoot(uint64_t value);
+int16_t objectTemp(int16_t voltage, int16_t die);
+bool checkHealth(int16_t raw);
+void resetFilter(void);
+int16_t filterTemp(int16_t raw);
+void filterZones(int16_t *fine, const int16_t *raw, const bool *sample, int count);
+bool readTemp(void);
+void tempRead(struct i2c_request *request, bool ok);
+void uartReadCallback(UART_Handle handle, void *buffer, size_t count);
+void sendNext(void);
+void uartWriteCallback(UART_Handle handle, void *buffer, size_t count);
+void display(int count);
+void paintMemory(void);
+uint32_t stackUsed(void);
+uint32_t heapUsed(void);
+void sendMemoryToUART();
+void bootMark(const char *name);
+void initUART(void);
+void timerCallback(Timer_Handle myHandle, int_fast16_t status);
+void initTimer(void);
+void gpioButton0Increase(uint_least8_t index);
+void gpioButton1Decrease(uint_least8_t index);
+void initGPIO(void);
+void initZones(void);
+void initHeater(void);
+void initProfiler(void);
+void initThermostat(void);
+void runTasks(void);
+void *mainThread(void *arg0);
+
+#endif
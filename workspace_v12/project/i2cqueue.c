@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== i2cqueue.c ========
+ */
+
+// The I2C request queue, see i2cqueue.h. The driverlib calls are for the
+// bus recovery, which clocks a stuck sensor free by hand.
+
+#include "gpiointerrupt.h"
+
+/* Driverlib header files for the I2C bus recovery */
+#include <ti/devices/cc32xx/inc/hw_types.h>
+#include <ti/devices/cc32xx/inc/hw_memmap.h>
+#include <ti/devices/cc32xx/driverlib/gpio.h>
+#include <ti/devices/cc32xx/driverlib/i2c.h>
+#include <ti/devices/cc32xx/driverlib/pin.h>
+#include <ti/devices/cc32xx/driverlib/prcm.h>
+#include <ti/devices/cc32xx/driverlib/utils.h>
+
+struct i2c_request *i2cQueue[I2C_QUEUE_SIZE];
+int i2cQueued = 0;
+uint32_t i2cLatency[NUMBER_OF_I2C_PRIORITIES][I2C_LATENCY_BUCKETS];
+uint32_t i2cCoalesced = 0;
+// the transfer the driver is running
+I2C_Transaction i2cTransaction;
+I2C_Params i2cParams;
+uint32_t clockTickPeriod = 1;      // microseconds per ClockP tick
+int i2cErrors = 0;
+uint32_t i2cTransfers = 0;
+uint32_t i2cBusCycles = 0;
+uint32_t i2cMaxCycles = 0;
+
+/*
+ * Open CONFIG_I2C_0 with i2cParams and turn on the clock low timeout,
+ * which the generated configuration leaves at 0 (off)
+ */
+I2C_Handle openI2C(void) {
+    I2C_Handle handle = I2C_open(CONFIG_I2C_0, &i2cParams);
+    if (handle != NULL) {
+        I2CMasterTimeoutSet(I2CA0_BASE, I2C_SCL_TIMEOUT);
+    }
+    return handle;
+}
+
+/*
+ * Run one transfer of i2cTransaction, giving up I2C_TIMEOUT_US after the
+ * time its bytes take at busSpeed, and add the time it took to the bus
+ * statistics
+ */
+bool transferI2C(void) {
+    uint32_t start = DWT_CYCCNT;
+    uint32_t cycles;
+    uint32_t timeout = I2C_TIMEOUT_US
+        + (i2cTransaction.writeCount + i2cTransaction.readCount + 1) * 9 * 1000 / busSpeed;
+    bool ok = I2C_transferTimeout(i2c, &i2cTransaction, timeout / clockTickPeriod + 1) == I2C_STATUS_SUCCESS;
+    cycles = DWT_CYCCNT - start;
+    i2cTransfers++;
+    i2cBusCycles += cycles;
+    if (cycles > i2cMaxCycles) {
+        i2cMaxCycles = cycles;
+    }
+    return ok;
+}
+
+/*
+ * Run request once, straight away, without retries
+ */
+bool runI2C(struct i2c_request *request) {
+    if (i2c == NULL) {
+        return false;
+    }
+    i2cTransaction.slaveAddress = request->address;
+    i2cTransaction.writeBuf = request->writeBuf;
+    i2cTransaction.writeCount = request->writeCount;
+    i2cTransaction.readBuf = request->readBuf;
+    i2cTransaction.readCount = request->readCount;
+    return transferI2C();
+}
+
+/*
+ * Fill in request as a read of readCount bytes from register reg. Set
+ * writeBuf[1..2] and writeCount afterwards to make it a register write.
+ */
+void setupRequest(struct i2c_request *request, uint8_t address, uint8_t reg, uint8_t *readBuf,
+                  uint16_t readCount, uint8_t priority, void (*done)(struct i2c_request *, bool)) {
+    request->address = address;
+    request->writeBuf[0] = reg;
+    request->writeCount = 1;
+    request->readBuf = readBuf;
+    request->readCount = readCount;
+    request->priority = priority;
+    request->effective = priority;
+    request->attempts = I2C_ATTEMPTS;
+    request->done = done;
+    request->pending = false;
+    request->next = NULL;
+}
+
+/*
+ * Add request to the I2C queue.
+ *
+ * A read of a register that already has an identical read waiting is
+ * chained onto that one instead of taking a queue slot, and the waiting
+ * read runs at the higher of the two priorities until it is serviced; its
+ * own priority is kept for the next time it is queued. Returns false if request
+ * is still pending from before or the queue is full.
+ */
+bool queueI2C(struct i2c_request *request) {
+    int x = 0;
+    if (request->pending) {
+        return false;
+    }
+    request->next = NULL;
+    if (request->readCount > 0 && request->writeCount == 1) {
+        for (x = 0; x < i2cQueued; x++) {
+            struct i2c_request *queued = i2cQueue[x];
+            if (queued->address == request->address && queued->writeCount == 1
+                    && queued->writeBuf[0] == request->writeBuf[0]
+                    && queued->readCount == request->readCount) {
+                request->next = queued->next;
+                queued->next = request;
+                if (request->priority < queued->effective) {
+                    queued->effective = request->priority;
+                }
+                request->pending = true;
+                request->queued = DWT_CYCCNT;
+                i2cCoalesced++;
+                return true;
+            }
+        }
+    }
+    if (i2cQueued == I2C_QUEUE_SIZE) {
+        return false;
+    }
+    request->pending = true;
+    request->effective = request->priority;
+    request->queued = DWT_CYCCNT;
+    i2cQueue[i2cQueued++] = request;
+    return true;
+}
+
+/**
+ * Function for running the queued I2C requests
+ *
+ * Runs as the last task of every tick. Takes the highest priority request
+ * (oldest first within a priority), tries it up to its attempts times with
+ * a bus recovery after each failure when it has more than one and calls done for it and every read chained
+ * on it. I2C_CONTROL requests always run; the others wait for the next
+ * tick once the pass has used I2C_PASS_BUDGET_US. The time each request
+ * and each read chained on it waited in the queue goes into i2cLatency
+ * under its own priority.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void serviceI2C() {
+    uint32_t start = DWT_CYCCNT;
+    uint32_t budget = I2C_PASS_BUDGET_US * CYCLES_PER_US;
+    while (i2cQueued > 0) {
+        struct i2c_request *request, *chained;
+        uint32_t waited;
+        int best = 0;
+        int x, attempt;
+        bool ok = false;
+
+        for (x = 1; x < i2cQueued; x++) {
+            if (i2cQueue[x]->effective < i2cQueue[best]->effective
+                    || (i2cQueue[x]->effective == i2cQueue[best]->effective
+                        && (int32_t)(i2cQueue[x]->queued - i2cQueue[best]->queued) < 0)) {
+                best = x;
+            }
+        }
+        request = i2cQueue[best];
+        if (request->effective != I2C_CONTROL && DWT_CYCCNT - start > budget) {
+            break;
+        }
+        i2cQueue[best] = i2cQueue[--i2cQueued];
+
+        // each read on the chain waited from its own queueing, at its own priority
+        for (chained = request; chained != NULL; chained = chained->next) {
+            waited = (DWT_CYCCNT - chained->queued) / CYCLES_PER_US;
+            for (x = 0; x < I2C_LATENCY_BUCKETS - 1 && (waited >> (I2C_LATENCY_SHIFT + x)) != 0; x++) {}
+            i2cLatency[chained->priority][x]++;
+        }
+
+        for (attempt = 0; attempt < request->attempts && !ok; attempt++) {
+            ok = runI2C(request);
+            if (!ok && request->attempts > 1) {
+                i2cErrors++;
+                recoverI2C();
+            }
+        }
+
+        // reads chained on this one get a copy of its result
+        for (chained = request->next; ok && chained != NULL; chained = chained->next) {
+            if (chained->readBuf != request->readBuf) {
+                memcpy(chained->readBuf, request->readBuf, request->readCount);
+            }
+        }
+        // done may queue its request again, so take it off the chain first
+        while (request != NULL) {
+            chained = request->next;
+            request->pending = false;
+            request->next = NULL;
+            if (request->done != NULL) {
+                request->done(request, ok);
+            }
+            request = chained;
+        }
+    }
+}
+
+/*
+ * Free a bus that a sensor is holding.
+ *
+ * Closes the driver, takes SCL and SDA over as GPIO and clocks SCL up to
+ * nine times until the sensor lets go of SDA, then sends a STOP and opens
+ * the driver again. i2c is NULL afterwards if the driver could not be opened.
+ */
+void recoverI2C(void) {
+    int x = 0;
+    if (i2c != NULL) {
+        I2C_close(i2c);
+    }
+    PRCMPeripheralClkEnable(PRCM_GPIOA1, PRCM_RUN_MODE_CLK);
+    PinTypeGPIO(I2C_SCL_PIN, PIN_MODE_0, false);
+    PinTypeGPIO(I2C_SDA_PIN, PIN_MODE_0, false);
+    PinConfigSet(I2C_SCL_PIN, PIN_STRENGTH_2MA, PIN_TYPE_OD_PU);
+    PinConfigSet(I2C_SDA_PIN, PIN_STRENGTH_2MA, PIN_TYPE_OD_PU);
+    GPIODirModeSet(GPIOA1_BASE, I2C_SDA_BIT, GPIO_DIR_MODE_IN);
+    GPIODirModeSet(GPIOA1_BASE, I2C_SCL_BIT, GPIO_DIR_MODE_OUT);
+    GPIOPinWrite(GPIOA1_BASE, I2C_SCL_BIT, I2C_SCL_BIT);
+    UtilsDelay(I2C_HALF_CLOCK_DELAY);
+    for (x = 0; x < I2C_RECOVERY_CLOCKS; x++) {
+        if (GPIOPinRead(GPIOA1_BASE, I2C_SDA_BIT)) {
+            break;
+        }
+        GPIOPinWrite(GPIOA1_BASE, I2C_SCL_BIT, 0);
+        UtilsDelay(I2C_HALF_CLOCK_DELAY);
+        GPIOPinWrite(GPIOA1_BASE, I2C_SCL_BIT, I2C_SCL_BIT);
+        UtilsDelay(I2C_HALF_CLOCK_DELAY);
+    }
+    // STOP: SDA goes high while SCL is high
+    GPIOPinWrite(GPIOA1_BASE, I2C_SDA_BIT, 0);
+    GPIODirModeSet(GPIOA1_BASE, I2C_SDA_BIT, GPIO_DIR_MODE_OUT);
+    UtilsDelay(I2C_HALF_CLOCK_DELAY);
+    GPIOPinWrite(GPIOA1_BASE, I2C_SDA_BIT, I2C_SDA_BIT);
+    UtilsDelay(I2C_HALF_CLOCK_DELAY);
+    i2c = openI2C();
+}
+
+/*
+ * Read count bytes starting at register reg of the device at address
+ * straight away. Only for setting up; tasks queue their requests.
+ */
+bool readDevice(uint8_t address, uint8_t reg, uint8_t *buffer, size_t count) {
+    struct i2c_request request;
+    setupRequest(&request, address, reg, buffer, count, I2C_BACKGROUND, NULL);
+    return runI2C(&request);
+}
+
+/*
+ * Write one byte to register reg of the device at address straight away.
+ * Only for setting up; tasks queue their requests.
+ */
+bool writeDevice(uint8_t address, uint8_t reg, uint8_t value) {
+    struct i2c_request request;
+    setupRequest(&request, address, reg, NULL, 0, I2C_BACKGROUND, NULL);
+    request.writeBuf[1] = value;
+    request.writeCount = 2;
+    return runI2C(&request);
+}
+
+/**
+ * Function for sending the I2C bus statistics to UART
+ *
+ * Sends <I,kbps,transfers,cycles,max> with the bus speed, the number of
+ * transfers, the cycles spent in them and the longest one since boot, so
+ * the bus time per sample can be worked out.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendI2CStatsToUART() {
+    DISPLAY(snprintf(output, 64, "<I,%u,%lu,%lu,%lu>\n\r", busSpeed, (unsigned long)i2cTransfers,
+                     (unsigned long)i2cBusCycles, (unsigned long)i2cMaxCycles))
+}
+
+/*
+ * Requests of priority that have gone through the queue
+ */
+uint32_t i2cRequests(int priority) {
+    uint32_t count = 0;
+    int bucket;
+    for (bucket = 0; bucket < I2C_LATENCY_BUCKETS; bucket++) {
+        count += i2cLatency[priority][bucket];
+    }
+    return count;
+}
+
+/*
+ * The percent percentile of the queue latency of priority, the upper edge
+ * in microseconds of the i2cLatency bucket it falls in, so it is rounded
+ * up to a power of two.
+ */
+uint32_t i2cPercentile(int priority, uint8_t percent) {
+    uint32_t count = i2cRequests(priority);
+    uint32_t seen = 0;
+    int bucket;
+    for (bucket = 0; bucket < I2C_LATENCY_BUCKETS - 1; bucket++) {
+        seen += i2cLatency[priority][bucket];
+        if (seen * 100 >= count * percent) {
+            break;
+        }
+    }
+    return (uint32_t)1 << (I2C_LATENCY_SHIFT + bucket);
+}
+
+/**
+ * Function for sending the I2C queue latencies to UART
+ *
+ * Sends <Q,priority,requests,p50,p95,p99,coalesced> for each priority,
+ * the percentiles as i2cPercentile() gives them.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendI2CQueueToUART() {
+    static const uint8_t percents[3] = {50, 95, 99};
+    uint32_t edges[3];
+    uint32_t count;
+    int x, y;
+    for (x = 0; x < NUMBER_OF_I2C_PRIORITIES; x++) {
+        count = i2cRequests(x);
+        for (y = 0; y < 3; y++) {
+            edges[y] = i2cPercentile(x, percents[y]);
+        }
+        DISPLAY(snprintf(output, 64, "<Q,%d,%lu,%lu,%lu,%lu,%lu>\n\r", x, (unsigned long)count,
+                         (unsigned long)edges[0], (unsigned long)edges[1], (unsigned long)edges[2],
+                         (unsigned long)i2cCoalesced))
+    }
+}
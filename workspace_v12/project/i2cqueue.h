@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== i2cqueue.h ========
+ */
+
+// I2C request queue: tasks queue reads and writes and serviceI2C() runs
+// them by priority once the other tasks of the pass are done. Every
+// transfer has a timeout and a failed request gets a bus recovery before
+// its next attempt, so a stuck sensor can not hang the control loop.
+
+#ifndef i2cqueue_h
+#define i2cqueue_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ti/drivers/I2C.h>
+
+#define I2C_QUEUE_SIZE 8
+#define I2C_PASS_BUDGET_US 5000     // bus time per pass before lower priorities wait
+#define I2C_LATENCY_BUCKETS 8       // queue latency histogram, bucket n is below 64us << n
+#define I2C_LATENCY_SHIFT 6
+#define I2C_TIMEOUT_US 2000         // time a transfer may take on top of clocking its bytes
+#define I2C_ATTEMPTS 2              // tries per sample, with a bus recovery between
+#define I2C_SCL_TIMEOUT 0x7D        // clock low timeout in the I2C peripheral
+#define I2C_RECOVERY_CLOCKS 9
+#define I2C_HALF_CLOCK_DELAY 133    // UtilsDelay loops, about 5us at 80MHz
+#define I2C_SCL_PIN PIN_01          // GPIO10
+#define I2C_SDA_PIN PIN_02          // GPIO11
+#define I2C_SCL_BIT 0x04
+#define I2C_SDA_BIT 0x08
+
+// I2C request priorities, lower runs first
+enum I2C_PRIORITIES {I2C_CONTROL, I2C_SENSOR, I2C_BACKGROUND, NUMBER_OF_I2C_PRIORITIES};
+
+/*
+ * One queued I2C operation: write writeCount bytes (the register, then any
+ * data) and read readCount bytes into readBuf. done is called with the
+ * result once it has run; reads of the same register that are queued while
+ * an identical read is waiting are chained on next and share its result.
+ * serviceI2C() orders the queue by effective, which starts at priority
+ * each time the request is queued and only rises while a higher priority
+ * read is chained on it.
+ */
+struct i2c_request {
+    uint8_t address;
+    uint8_t writeBuf[3];
+    uint8_t writeCount;
+    uint8_t *readBuf;
+    uint16_t readCount;
+    uint8_t priority;
+    uint8_t effective;
+    uint8_t attempts;       // I2C_ATTEMPTS, 1 for a probe that may well not answer
+    void (*done)(struct i2c_request *request, bool ok);
+    bool pending;
+    uint32_t queued;
+    struct i2c_request *next;
+};
+
+extern struct i2c_request *i2cQueue[I2C_QUEUE_SIZE];
+extern int i2cQueued;
+extern uint32_t i2cLatency[NUMBER_OF_I2C_PRIORITIES][I2C_LATENCY_BUCKETS];
+extern uint32_t i2cCoalesced;
+// the transfer the driver is running
+extern I2C_Transaction i2cTransaction;
+extern I2C_Params i2cParams;
+extern uint32_t clockTickPeriod;    // microseconds per ClockP tick
+extern int i2cErrors;
+extern uint32_t i2cTransfers;
+extern uint32_t i2cBusCycles;
+extern uint32_t i2cMaxCycles;
+
+I2C_Handle openI2C(void);
+bool transferI2C(void);
+bool runI2C(struct i2c_request *request);
+void setupRequest(struct i2c_request *request, uint8_t address, uint8_t reg, uint8_t *readBuf,
+                  uint16_t readCount, uint8_t priority, void (*done)(struct i2c_request *, bool));
+bool queueI2C(struct i2c_request *request);
+void serviceI2C();
+void recoverI2C(void);
+bool readDevice(uint8_t address, uint8_t reg, uint8_t *buffer, size_t count);
+bool writeDevice(uint8_t address, uint8_t reg, uint8_t value);
+void sendI2CStatsToUART();
+uint32_t i2cRequests(int priority);
+uint32_t i2cPercentile(int priority, uint8_t percent);
+void sendI2CQueueToUART();
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== quantiles.c ========
+ */
+
+// The daily temperature quantiles, see quantiles.h.
+
+#include "gpiointerrupt.h"
+
+// marker percentiles in Q16, 0.05 is p5
+const uint32_t quantileTargets[QUANTILE_MARKERS] = {0, 1638, 3277, 18022, 32768, 47514, 62259, 63898, 65536};
+int32_t quantileHeights[QUANTILE_MARKERS];      // 1/128 degree C << QUANTILE_FRACTION
+int32_t quantilePositions[QUANTILE_MARKERS];    // 1 based rank of each marker
+uint32_t quantileCount = 0;
+
+/*
+ * Add a reading, in 1/128 degree C, to the P2 quantile markers.
+ *
+ * The first QUANTILE_MARKERS readings are kept sorted as they are. After
+ * that the marker the reading falls above moves up one rank, and each
+ * inner marker that is a whole rank off where its percentile should be is
+ * moved a rank towards it, with its height from a parabola through it and
+ * its neighbours (or a straight line when the parabola would pass a
+ * neighbour). The work per reading is fixed.
+ */
+void quantileSample(int16_t value) {
+    int32_t height = (int32_t)value << QUANTILE_FRACTION;
+    int x, cell;
+
+    if (quantileCount < QUANTILE_MARKERS) {
+        for (x = quantileCount; x > 0 && quantileHeights[x - 1] > height; x--) {
+            quantileHeights[x] = quantileHeights[x - 1];
+        }
+        quantileHeights[x] = height;
+        quantileCount++;
+        quantilePositions[quantileCount - 1] = quantileCount;
+        return;
+    }
+    if (height < quantileHeights[0]) {
+        quantileHeights[0] = height;
+        cell = 0;
+    } else if (height >= quantileHeights[QUANTILE_MARKERS - 1]) {
+        quantileHeights[QUANTILE_MARKERS - 1] = height;
+        cell = QUANTILE_MARKERS - 2;
+    } else {
+        for (cell = 0; height >= quantileHeights[cell + 1]; cell++) {}
+    }
+    for (x = cell + 1; x < QUANTILE_MARKERS; x++) {
+        quantilePositions[x]++;
+    }
+    quantileCount++;
+
+    for (x = 1; x < QUANTILE_MARKERS - 1; x++) {
+        // where the marker should be, in Q16 ranks
+        int64_t off = ((int64_t)1 << 16) + (int64_t)(quantileCount - 1) * quantileTargets[x]
+            - ((int64_t)quantilePositions[x] << 16);
+        int32_t below = quantilePositions[x] - quantilePositions[x - 1];
+        int32_t above = quantilePositions[x + 1] - quantilePositions[x];
+        int32_t step;
+        int64_t moved;
+
+        if (off >= (1 << 16) && above > 1) {
+            step = 1;
+        } else if (off <= -(1 << 16) && below > 1) {
+            step = -1;
+        } else {
+            continue;
+        }
+        moved = quantileHeights[x] + step * (
+            (int64_t)(below + step) * (quantileHeights[x + 1] - quantileHeights[x]) / above
+            + (int64_t)(above - step) * (quantileHeights[x] - quantileHeights[x - 1]) / below)
+            / (below + above);
+        if (moved <= quantileHeights[x - 1] || moved >= quantileHeights[x + 1]) {
+            moved = quantileHeights[x] + (int64_t)step * (quantileHeights[x + step] - quantileHeights[x])
+                / (quantilePositions[x + step] - quantilePositions[x]);
+        }
+        quantileHeights[x] = (int32_t)moved;
+        quantilePositions[x] += step;
+    }
+}
+
+/**
+ * Function for sending the daily quantile summary to UART
+ *
+ * Sends <P,day,readings,m0,...,m8> with the 9 marker heights as 16 bit
+ * hex in 1/128 degree C, p5 is m2, p50 m4 and p95 m6. The markers are
+ * points of the day's distribution at known percentiles, so a host can
+ * merge units by adding up their piecewise linear CDFs weighted by
+ * readings. With fewer readings than markers only the count is sent.
+ * The markers are then cleared for the next day.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void sendQuantilesToUART() {
+    int16_t m[QUANTILE_MARKERS];
+    int x = 0;
+    if (quantileCount < QUANTILE_MARKERS) {
+        DISPLAY(snprintf(output, 64, "<P,%d,%lu>\n\r", seconds / QUANTILE_PERIOD, (unsigned long)quantileCount))
+    } else {
+        for (x = 0; x < QUANTILE_MARKERS; x++) {
+            m[x] = quantileHeights[x] >> QUANTILE_FRACTION;
+        }
+        DISPLAY(snprintf(output, 64, "<P,%d,%lu,%04x,%04x,%04x,%04x,%04x,%04x,%04x,%04x,%04x>\n\r",
+                         seconds / QUANTILE_PERIOD, (unsigned long)quantileCount,
+                         (uint16_t)m[0], (uint16_t)m[1], (uint16_t)m[2], (uint16_t)m[3], (uint16_t)m[4],
+                         (uint16_t)m[5], (uint16_t)m[6], (uint16_t)m[7], (uint16_t)m[8]))
+    }
+    quantileCount = 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== quantiles.h ========
+ */
+
+// Daily temperature quantiles: an extended P2 estimator keeps 9 markers at
+// the 0, 2.5, 5, 27.5, 50, 72.5, 95, 97.5 and 100th percentiles of the
+// readings, 72 bytes whatever the number of readings
+
+#ifndef quantiles_h
+#define quantiles_h
+
+#include <stdint.h>
+
+#define QUANTILE_MARKERS 9
+#define QUANTILE_PERIOD 86400       // seconds between summary frames
+// fraction bits the marker heights keep below 1/128 degree: late in a day
+// a marker moves less than 1/128 degree per reading, and the -40 to 125
+// degree range of the sensors still fits in 32 bits
+#define QUANTILE_FRACTION 16
+
+// marker percentiles in Q16, 0.05 is p5
+extern const uint32_t quantileTargets[QUANTILE_MARKERS];
+extern int32_t quantileHeights[QUANTILE_MARKERS];      // 1/128 degree C << QUANTILE_FRACTION
+extern int32_t quantilePositions[QUANTILE_MARKERS];    // 1 based rank of each marker
+extern uint32_t quantileCount;
+
+void quantileSample(int16_t value);
+void sendQuantilesToUART();
+
+#endif
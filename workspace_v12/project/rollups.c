@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== rollups.c ========
+ */
+
+// The minute, hour, day and week rollups of the temperature, see rollups.h.
+
+#include "gpiointerrupt.h"
+
+struct rollup_bucket secondBuckets[ROLLUP_SECOND_BUCKETS];
+struct rollup_bucket minuteBuckets[ROLLUP_MINUTE_BUCKETS];
+struct rollup_bucket quarterBuckets[ROLLUP_QUARTER_BUCKETS];
+struct rollup_bucket hourBuckets[ROLLUP_HOUR_BUCKETS];
+struct rollup_level rollups[ROLLUP_LEVELS] = {
+    {'s', 1, ROLLUP_SECOND_BUCKETS, 0, 0, {INT16_MAX, INT16_MIN, 0, 0, 0}, secondBuckets},
+    {'m', 60, ROLLUP_MINUTE_BUCKETS, 0, 0, {INT16_MAX, INT16_MIN, 0, 0, 0}, minuteBuckets},
+    {'q', 900, ROLLUP_QUARTER_BUCKETS, 0, 0, {INT16_MAX, INT16_MIN, 0, 0, 0}, quarterBuckets},
+    {'h', 3600, ROLLUP_HOUR_BUCKETS, 0, 0, {INT16_MAX, INT16_MIN, 0, 0, 0}, hourBuckets}
+};
+
+/*
+ * Empty bucket, so the next reading sets its min and max
+ */
+void clearBucket(struct rollup_bucket *bucket) {
+    bucket->min = INT16_MAX;
+    bucket->max = INT16_MIN;
+    bucket->sum = 0;
+    bucket->count = 0;
+    bucket->heatSeconds = 0;
+}
+
+/*
+ * Add everything in from to into
+ */
+void mergeBucket(struct rollup_bucket *into, const struct rollup_bucket *from) {
+    if (from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+    into->sum += from->sum;
+    into->count += from->count;
+    into->heatSeconds += from->heatSeconds;
+}
+
+/*
+ * Add a temperature reading, in 1/128 degree C, to the open 1 second bucket
+ */
+void rollupSample(int16_t value) {
+    struct rollup_bucket *bucket = &rollups[0].open;
+    if (value < bucket->min) {
+        bucket->min = value;
+    }
+    if (value > bucket->max) {
+        bucket->max = value;
+    }
+    bucket->sum += value;
+    bucket->count++;
+}
+
+/**
+ * Function for closing the rollup buckets at the end of a second
+ *
+ * Counts the second as a heater second if the heat is on, then closes the
+ * open bucket of every level whose width the time is a multiple of. A
+ * closed bucket goes into its level's ring and is added to the open
+ * bucket of the level above, so each level only ever handles its own
+ * buckets once.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void rollupSecond() {
+    int x = 0;
+    // whole heater seconds at the current duty, the rest carried over
+    heatSecondFraction += heatDuty;
+    if (heatSecondFraction >= HEAT_DUTY_MAX) {
+        heatSecondFraction -= HEAT_DUTY_MAX;
+        rollups[0].open.heatSeconds++;
+    }
+    for (x = 0; x < ROLLUP_LEVELS && seconds % rollups[x].width == 0; x++) {
+        struct rollup_level *level = &rollups[x];
+        level->ring[level->next] = level->open;
+        level->next = (level->next + 1) % level->size;
+        if (level->used < level->size) {
+            level->used++;
+        }
+        if (x + 1 < ROLLUP_LEVELS) {
+            mergeBucket(&rollups[x + 1].open, &level->open);
+        }
+        clearBucket(&level->open);
+    }
+}
+
+/*
+ * Answer a rollup query with
+ * <A,level,buckets,readings,min,max,average,heatSeconds>
+ * over the last buckets closed buckets of the level named name. The
+ * temperatures are in 1/100 degree C. Unknown levels get <E>.
+ */
+void queryRollup(char name, int buckets) {
+    // a week is more than the 16 and 32 bits of a bucket, so add up here
+    uint32_t readings = 0;
+    uint32_t heatSeconds = 0;
+    int64_t sum = 0;
+    int16_t min = INT16_MAX;
+    int16_t max = INT16_MIN;
+    int x = 0;
+    int slot;
+    struct rollup_level *level;
+
+    while (x < ROLLUP_LEVELS && rollups[x].name != name) {
+        x++;
+    }
+    if (x == ROLLUP_LEVELS || buckets <= 0) {
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    level = &rollups[x];
+    if (buckets > level->used) {
+        buckets = level->used;
+    }
+    for (x = 0, slot = level->next; x < buckets; x++) {
+        slot = slot == 0 ? level->size - 1 : slot - 1;
+        readings += level->ring[slot].count;
+        heatSeconds += level->ring[slot].heatSeconds;
+        sum += level->ring[slot].sum;
+        if (level->ring[slot].min < min) {
+            min = level->ring[slot].min;
+        }
+        if (level->ring[slot].max > max) {
+            max = level->ring[slot].max;
+        }
+    }
+    if (readings == 0) {
+        DISPLAY(snprintf(output, 64, "<A,%c,%d,0,0,0,0,%lu>\n\r", name, buckets, (unsigned long)heatSeconds))
+        return;
+    }
+    DISPLAY(snprintf(output, 64, "<A,%c,%d,%lu,%d,%d,%ld,%lu>\n\r", name, buckets, (unsigned long)readings,
+                     min * 100 / 128, max * 100 / 128,
+                     (long)(sum * 100 / 128 / (int32_t)readings), (unsigned long)heatSeconds))
+}
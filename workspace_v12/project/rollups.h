@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== rollups.h ========
+ */
+
+// Rollups: min, max, average and heater on seconds of the temperature over
+// the last minute, hour, day and week, each level built from the one below
+// when its bucket closes. Read over UART with R<level><buckets>, e.g. Rm15.
+// RAM: 384 buckets of 12 bytes plus 4 levels of 24 bytes, about 4.7KB
+
+#ifndef rollups_h
+#define rollups_h
+
+#include <stdint.h>
+
+#define ROLLUP_LEVELS 4
+#define ROLLUP_SECOND_BUCKETS 60    // 1s each, the last minute
+#define ROLLUP_MINUTE_BUCKETS 60    // 1min each, the last hour
+#define ROLLUP_QUARTER_BUCKETS 96   // 15min each, the last day
+#define ROLLUP_HOUR_BUCKETS 168     // 1h each, the last week
+
+struct rollup_bucket {
+    int16_t min;                // 1/128 degree C, like the sensor
+    int16_t max;
+    int32_t sum;
+    uint16_t count;             // readings in the bucket
+    uint16_t heatSeconds;
+};
+struct rollup_level {
+    char name;                  // letter the level has in a query
+    uint16_t width;             // seconds per bucket
+    uint16_t size;              // buckets in ring
+    uint16_t next;              // slot the open bucket goes into when it closes
+    uint16_t used;              // closed buckets in ring, up to size
+    struct rollup_bucket open;
+    struct rollup_bucket *ring;
+};
+
+extern struct rollup_bucket secondBuckets[ROLLUP_SECOND_BUCKETS];
+extern struct rollup_bucket minuteBuckets[ROLLUP_MINUTE_BUCKETS];
+extern struct rollup_bucket quarterBuckets[ROLLUP_QUARTER_BUCKETS];
+extern struct rollup_bucket hourBuckets[ROLLUP_HOUR_BUCKETS];
+extern struct rollup_level rollups[ROLLUP_LEVELS];
+
+void clearBucket(struct rollup_bucket *bucket);
+void mergeBucket(struct rollup_bucket *into, const struct rollup_bucket *from);
+void rollupSample(int16_t value);
+void rollupSecond();
+void queryRollup(char name, int buckets);
+
+#endif
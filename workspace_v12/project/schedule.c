@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== schedule.c ========
+ */
+
+// The weekly setPoint schedule, see schedule.h.
+
+#include "gpiointerrupt.h"
+
+// an upload goes into the schedule not in use, then the pointer is switched
+struct schedule schedules[2];
+struct schedule *activeSchedule = NULL;
+uint8_t scheduleBlob[SCHEDULE_BLOB_SIZE];
+int scheduleBlobLength = 0;
+int scheduleCursor = 0;         // entry in force
+int scheduleMinute = -1;        // minute of the week last looked at, -1 to look the entry up
+bool setPointOverride = false;  // the buttons changed setPoint since the last entry
+
+/*
+ * Add the bytes written as hex in text to the schedule upload and answer
+ * <B,bytes so far>, or <E> if the text is not whole bytes of hex or is
+ * too long; an <E> starts the upload again
+ */
+void addScheduleBytes(const char *text) {
+    int x, value;
+    if (strlen(text) % 2 != 0) {
+        scheduleBlobLength = 0;
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    for (; text[0] != '\0'; text += 2) {
+        value = 0;
+        for (x = 0; x < 2; x++) {
+            char c = text[x];
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else {
+                value = -1;
+                break;
+            }
+        }
+        if (value < 0 || scheduleBlobLength == SCHEDULE_BLOB_SIZE) {
+            scheduleBlobLength = 0;
+            DISPLAY(snprintf(output, 64, "<E>\n\r"))
+            return;
+        }
+        scheduleBlob[scheduleBlobLength++] = value;
+    }
+    DISPLAY(snprintf(output, 64, "<B,%d>\n\r", scheduleBlobLength))
+}
+
+/*
+ * Check the uploaded schedule and switch to it. It has to be the length
+ * its count says, pass its CRC, and have minutes inside the week in
+ * increasing order and setPoints inside MIN_SETPOINT to MAX_SETPOINT.
+ * Answers <U,entries> or <E>; either way the upload starts again.
+ */
+void useSchedule(void) {
+    struct schedule *table = activeSchedule == &schedules[0] ? &schedules[1] : &schedules[0];
+    int length = scheduleBlobLength;
+    int count = scheduleBlob[0];
+    int x;
+    scheduleBlobLength = 0;
+    if (length < 5 || count > SCHEDULE_ENTRIES || length != 5 + count * 3
+            || crc16(scheduleBlob, length - 2) != (scheduleBlob[length - 2] | scheduleBlob[length - 1] << 8)) {
+        DISPLAY(snprintf(output, 64, "<E>\n\r"))
+        return;
+    }
+    table->count = count;
+    table->utcOffset = (int16_t)(scheduleBlob[1] | scheduleBlob[2] << 8);
+    for (x = 0; x < count; x++) {
+        const uint8_t *entry = &scheduleBlob[3 + x * 3];
+        int minute = entry[0] | entry[1] << 8;
+        int target = entry[2];
+        if (minute >= MINUTES_PER_WEEK || (x > 0 && minute <= table->entries[x - 1].minute)
+                || target > MAX_SETPOINT || target < MIN_SETPOINT) {
+            DISPLAY(snprintf(output, 64, "<E>\n\r"))
+            return;
+        }
+        table->entries[x].minute = minute;
+        table->entries[x].setPoint = target;
+    }
+    activeSchedule = table;
+    scheduleMinute = -1;
+    DISPLAY(snprintf(output, 64, "<U,%d>\n\r", count))
+}
+
+/*
+ * Put the setPoint of entry of the active schedule in force, which ends
+ * any button override
+ */
+void applyScheduleEntry(int entry) {
+    scheduleCursor = entry;
+    setPoint = activeSchedule->entries[entry].setPoint;
+    setPointOverride = false;
+    heatInputChanged();
+}
+
+/**
+ * Function for following the setPoint schedule
+ *
+ * Runs every second once the clock is synced. While the minute of the week
+ * moves on one at a time only the entry after the cursor can start, so
+ * that is the only one looked at. After a new schedule or a jump in the
+ * clock the entry in force is found by binary search: the last one that
+ * started at or before now, or the last of the week before the first one.
+ * If the next entry is warmer the setPoint goes up to it as soon as
+ * preheatMinutes() says the heat needs to start, unless the buttons have
+ * changed it.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void updateSchedule() {
+    struct schedule *table = activeSchedule;
+    int minute, next, low, high;
+    if (table == NULL || table->count == 0 || !synced) {
+        return;
+    }
+    minute = (wallMicros(timeMicros()) / 60000000 + table->utcOffset + EPOCH_WEEKDAY_MINUTES) % MINUTES_PER_WEEK;
+    if (minute == scheduleMinute) {
+        return;
+    }
+    if (scheduleMinute < 0 || minute != (scheduleMinute + 1) % MINUTES_PER_WEEK) {
+        low = 0;
+        high = table->count;
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (table->entries[middle].minute <= minute) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        applyScheduleEntry(low == 0 ? table->count - 1 : low - 1);
+    } else {
+        next = (scheduleCursor + 1) % table->count;
+        if (table->entries[next].minute == minute) {
+            applyScheduleEntry(next);
+        }
+    }
+    scheduleMinute = minute;
+
+    // optimal start: raise the setPoint early enough for the next entry
+    next = (scheduleCursor + 1) % table->count;
+    if (!setPointOverride && table->entries[next].setPoint > setPoint
+            && (table->entries[next].minute - minute + MINUTES_PER_WEEK) % MINUTES_PER_WEEK
+               <= preheatMinutes(table->entries[next].setPoint)) {
+        setPoint = table->entries[next].setPoint;
+        heatInputChanged();
+    }
+}
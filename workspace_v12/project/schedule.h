@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== schedule.h ========
+ */
+
+// Weekly setPoint schedule: up to 8 changes a day, sorted by minute of the
+// week in local time. Uploaded as hex in B lines and put in use with U:
+//   count, UTC offset in minutes (int16), count x (minute (uint16), setPoint),
+//   CRC-16/CCITT of all that, numbers little endian
+// The buttons change the setPoint until the next change in the schedule.
+
+#ifndef schedule_h
+#define schedule_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCHEDULE_ENTRIES 56
+#define MINUTES_PER_WEEK 10080
+#define EPOCH_WEEKDAY_MINUTES (3 * 1440)    // 1 Jan 1970 was a Thursday, weeks start on Monday
+#define SCHEDULE_BLOB_SIZE (3 + SCHEDULE_ENTRIES * 3 + 2)
+
+struct schedule_entry {
+    uint16_t minute;            // of the week, from Monday 00:00
+    uint8_t setPoint;
+};
+struct schedule {
+    int16_t utcOffset;          // minutes local time is ahead of UTC
+    uint8_t count;
+    struct schedule_entry entries[SCHEDULE_ENTRIES];
+};
+
+// an upload goes into the schedule not in use, then the pointer is switched
+extern struct schedule schedules[2];
+extern struct schedule *activeSchedule;
+extern uint8_t scheduleBlob[SCHEDULE_BLOB_SIZE];
+extern int scheduleBlobLength;
+extern int scheduleCursor;          // entry in force
+extern int scheduleMinute;          // minute of the week last looked at, -1 to look the entry up
+extern bool setPointOverride;       // the buttons changed setPoint since the last entry
+
+void addScheduleBytes(const char *text);
+void useSchedule(void);
+void applyScheduleEntry(int entry);
+void updateSchedule();
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== store.c ========
+ */
+
+// The persistent state on the serial flash, see store.h.
+
+#include "gpiointerrupt.h"
+
+enum STORE_STATES STORE_STATE = STORE_OFF;
+bool storeOpen = false;             // the file system answered at boot
+int storeStartSeconds;              // seconds count a save started the network processor at
+struct saved_state saved;           // the record in STORE_FILE
+uint32_t storeWrites = 0;
+uint32_t storeFailures = 0;         // saves the file system did not take, the old record kept
+bool warmBoot = false;
+
+/*
+ * Start the network processor for its file system, load the record in
+ * STORE_FILE into saved and stop it again. With a good record the boot is
+ * warm and setPoint and the calibration come back. No file is a cold
+ * boot, as on the first one. The start blocks: initI2C() needs to know
+ * the boot is warm before it skips the probes.
+ */
+void initStore(void) {
+    struct saved_state record;
+    int32_t file;
+
+    if (sl_Start(NULL, NULL, NULL) < 0) {
+        DISPLAY(snprintf(output, 64, "State store not available, cold boot\n\r"))
+        return;
+    }
+    storeOpen = true;
+    file = sl_FsOpen((const uint8_t *)STORE_FILE, SL_FS_READ, NULL);
+    if (file < 0) {
+        sl_Stop(STORE_STOP_TIMEOUT);
+        return;
+    }
+    if (sl_FsRead(file, 0, (uint8_t *)&record, sizeof record) == (int32_t)sizeof record
+            && record.magic == STORE_MAGIC
+            && record.crc == crc16((uint8_t *)&record, offsetof(struct saved_state, crc))) {
+        saved = record;
+    }
+    sl_FsClose(file, NULL, NULL, 0);
+    sl_Stop(STORE_STOP_TIMEOUT);
+    if (saved.sequence > 0 && saved.setPoint <= MAX_SETPOINT
+            && saved.tempOffset >= -MAX_TEMP_OFFSET && saved.tempOffset <= MAX_TEMP_OFFSET) {
+        warmBoot = true;
+        setPoint = saved.setPoint;
+        tempOffset = saved.tempOffset;
+    }
+}
+
+/*
+ * The record of the state as it is now, false if STORE_FILE already has it
+ */
+bool changedState(struct saved_state *record) {
+    record->sequence = saved.sequence;
+    record->magic = STORE_MAGIC;
+    record->setPoint = setPoint;
+    record->sensor = sensor;
+    record->busSpeed = busSpeed;
+    record->tempOffset = tempOffset;
+    record->spare = 0;
+    record->crc = crc16((uint8_t *)record, offsetof(struct saved_state, crc));
+    if (saved.sequence > 0 && memcmp(record, &saved, sizeof *record) == 0) {
+        return false;
+    }
+    record->sequence++;
+    record->crc = crc16((uint8_t *)record, offsetof(struct saved_state, crc));
+    return true;
+}
+
+/**
+ * Function for saving the persistent state
+ *
+ * When setPoint, the sensor, the bus speed or the calibration differ from
+ * the saved record, starts the network processor without waiting for it;
+ * serviceStore() writes the record once it is up. A start that fails is
+ * counted in storeFailures, which the 60 second report sends as
+ * <J,sequence,writes,failures>, and the change is tried again at the next
+ * check.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void saveState() {
+    struct saved_state record;
+    if (!storeOpen || STORE_STATE != STORE_OFF || !changedState(&record)) {
+        return;
+    }
+    if (sl_Start(NULL, NULL, storeStarted) < 0) {
+        storeFailures++;
+        return;
+    }
+    STORE_STATE = STORE_STARTING;
+    storeStartSeconds = seconds;
+}
+
+/*
+ * sl_Start()'s callback, from sl_Task() in serviceStore(): the network
+ * processor is up
+ */
+void storeStarted(uint32_t status, SlDeviceInitInfo_t *info) {
+    STORE_STATE = STORE_UP;
+}
+
+/*
+ * Write the record to STORE_FILE, creating the file as failsafe the first
+ * time. A write that fails is aborted, which keeps the old record, and
+ * counted in storeFailures. The write and the close hold the loop up for
+ * the file system's commit; the clock catches up after it as after any
+ * late pass.
+ */
+void writeState(void) {
+    struct saved_state record;
+    int32_t file;
+    if (!changedState(&record)) {
+        return;
+    }
+    file = sl_FsOpen((const uint8_t *)STORE_FILE, SL_FS_CREATE | SL_FS_OVERWRITE | SL_FS_CREATE_FAILSAFE
+                     | SL_FS_CREATE_MAX_SIZE(sizeof record), NULL);
+    if (file >= 0) {
+        if (sl_FsWrite(file, 0, (uint8_t *)&record, sizeof record) != (int32_t)sizeof record) {
+            // an abort signature drops the new copy
+            sl_FsClose(file, NULL, (const uint8_t *)"A", 1);
+        } else if (sl_FsClose(file, NULL, NULL, 0) == 0) {
+            saved = record;
+            storeWrites++;
+            return;
+        }
+    }
+    storeFailures++;
+}
+
+/**
+ * Function for finishing a save, every second
+ *
+ * While the network processor a save started is coming up, lets the
+ * SimpleLink driver take its events, which calls storeStarted(). Once it
+ * is up writes the record and stops it again, so it is only powered for
+ * the save. One that is not up after STORE_START_SECONDS is stopped and
+ * the save counted as failed.
+ * Does not take any arguments and does not return anything
+ *
+**/
+void serviceStore(void) {
+    if (STORE_STATE == STORE_STARTING) {
+        sl_Task(NULL);
+        if (STORE_STATE == STORE_STARTING && seconds - storeStartSeconds > STORE_START_SECONDS) {
+            storeFailures++;
+            sl_Stop(STORE_STOP_TIMEOUT);
+            STORE_STATE = STORE_OFF;
+        }
+    }
+    if (STORE_STATE == STORE_UP) {
+        writeState();
+        sl_Stop(STORE_STOP_TIMEOUT);
+        STORE_STATE = STORE_OFF;
+    }
+}
+
+/*
+ * The SimpleLink host driver calls these for the network processor's
+ * events. Only its file system is used, so there is nothing to do but
+ * stop saving if the network processor fails.
+ */
+void SimpleLinkWlanEventHandler(SlWlanEvent_t *event) {}
+void SimpleLinkNetAppEventHandler(SlNetAppEvent_t *event) {}
+void SimpleLinkHttpServerEventHandler(SlNetAppHttpServerEvent_t *event, SlNetAppHttpServerResponse_t *response) {}
+void SimpleLinkGeneralEventHandler(SlDeviceEvent_t *event) {}
+void SimpleLinkSockEventHandler(SlSockEvent_t *event) {}
+void SimpleLinkFatalErrorEventHandler(SlDeviceFatal_t *event) {
+    storeOpen = false;
+    STORE_STATE = STORE_OFF;
+}
+void SimpleLinkNetAppRequestEventHandler(SlNetAppRequest_t *request, SlNetAppResponse_t *response) {}
+void SimpleLinkNetAppRequestMemFreeEventHandler(uint8_t *buffer) {}
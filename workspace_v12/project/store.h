@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015-2020, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ======== store.h ========
+ */
+
+// Persistent state: setPoint, the sensor found, the bus speed and the
+// sensor calibration are kept as a record in STORE_FILE on the serial
+// flash, through the network processor's file system, which owns that
+// flash. The file is failsafe: a write goes to a second copy and only
+// replaces the old one when the file is closed, so a reset in the middle
+// of a write only loses that write, and the file system spreads the
+// wear. A warm boot uses the saved sensor and bus speed without probing,
+// and probes only if the sensor does not answer. The network processor
+// is only powered to load the record at boot and to write a change:
+// saveState() starts it without waiting and serviceStore() writes once it
+// is up and stops it again, so it is on for the 50ms of the boot load and
+// about a second a save instead of all the time.
+
+#ifndef store_h
+#define store_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <ti/drivers/net/wifi/simplelink.h>
+
+#define STORE_FILE "/thermostat/state"
+#define STORE_MAGIC 0x5354
+#define STORE_PERIOD 60             // seconds between checks for a change to save
+#define STORE_STOP_TIMEOUT 200      // ms sl_Stop() gives the network processor to finish
+#define STORE_START_SECONDS 5       // a start that takes longer is given up on
+
+// network processor states for a save
+enum STORE_STATES {STORE_OFF, STORE_STARTING, STORE_UP};
+
+struct saved_state {
+    uint32_t sequence;      // 0 for no record
+    uint16_t magic;
+    uint8_t setPoint;
+    int8_t sensor;          // index in sensors[], -1 for none
+    uint16_t busSpeed;      // Kbps
+    int16_t tempOffset;     // 1/128 degree added to every reading
+    uint16_t spare;
+    uint16_t crc;           // CRC-16/CCITT of the bytes before it
+};
+
+extern enum STORE_STATES STORE_STATE;
+extern bool storeOpen;              // the file system answered at boot
+extern int storeStartSeconds;       // seconds count a save started the network processor at
+extern struct saved_state saved;    // the record in STORE_FILE
+extern uint32_t storeWrites;
+extern uint32_t storeFailures;      // saves the file system did not take, the old record kept
+extern bool warmBoot;
+
+void initStore(void);
+bool changedState(struct saved_state *record);
+void saveState();
+void storeStarted(uint32_t status, SlDeviceInitInfo_t *info);
+void writeState(void);
+void serviceStore(void);
+
+#endif
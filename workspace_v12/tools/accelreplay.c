@@ -0,0 +1,188 @@
+/*
+ *  ======== accelreplay.c ========
+ */
+
+// Problem Description:
+//
+// updateActivity() empties the BMA222E FIFO in one burst every
+// ACCEL_PERIOD on the bus the temperature sensor uses. The burst has to
+// fit the TEMP_PERIOD budget even at the slowest bit rate, must never hold
+// up a temperature read, and must drain the FIFO before it overflows, and
+// the activity it works out has to tell an empty room from an occupied one.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 and a BMA222E
+// model that samples a trace into its FIFO at 15.63Hz. The harness replays
+// a still room until the thermostat sets back, then a person walking until
+// it counts the room occupied again, first at the bit rate the firmware
+// picks and then at 100 kHz. It checks the longest burst against
+// TEMP_PERIOD, that every temperature read ran in the pass it was queued
+// in, that no frame was lost and how long each change took to show.
+// A recorded trace, one "x y z" sample in 8 bit counts a line at 15.63Hz,
+// can be replayed instead; then only the bus checks apply.
+//
+// Build:   make -C tools accelreplay
+// Usage:   accelreplay [trace.txt]
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define TRACE_FRAMES 1563           // 100s at 15.63Hz
+#define MAX_TRACE_FRAMES 1000000
+#define ONE_G 64                    // counts at +/-2g
+#define WALK_HZ 1.8
+#define WALK_COUNTS 12              // sway of a person walking past, on X and Y
+
+static struct host_tmp102 tmp102;
+static struct host_bma222e accel;
+static int8_t still[TRACE_FRAMES][3];
+static int8_t walking[TRACE_FRAMES][3];
+static int8_t (*recorded)[3];
+
+/*
+ * A still room is gravity on Z and a count of noise; walking adds a sway
+ */
+static void makeTraces(void) {
+    int n;
+    srand(1);
+    for (n = 0; n < TRACE_FRAMES; n++) {
+        double t = n * 8.0 / 125;
+        still[n][0] = rand() % 3 - 1;
+        still[n][1] = rand() % 3 - 1;
+        still[n][2] = ONE_G + rand() % 3 - 1;
+        walking[n][0] = still[n][0] + (int8_t)lround(WALK_COUNTS * sin(2 * M_PI * WALK_HZ * t));
+        walking[n][1] = still[n][1] + (int8_t)lround(WALK_COUNTS * cos(2 * M_PI * WALK_HZ * t));
+        walking[n][2] = still[n][2] + (int8_t)lround(WALK_COUNTS / 2 * sin(4 * M_PI * WALK_HZ * t));
+    }
+}
+
+/*
+ * Read a trace of "x y z" lines, returns the number of frames
+ */
+static size_t readTrace(const char *name) {
+    FILE *file = fopen(name, "r");
+    size_t frames = 0;
+    int x, y, z;
+    if (file == NULL) {
+        perror(name);
+        exit(2);
+    }
+    recorded = malloc(MAX_TRACE_FRAMES * sizeof *recorded);
+    while (frames < MAX_TRACE_FRAMES && fscanf(file, "%d %d %d", &x, &y, &z) == 3) {
+        recorded[frames][0] = x;
+        recorded[frames][1] = y;
+        recorded[frames][2] = z;
+        frames++;
+    }
+    fclose(file);
+    if (frames == 0) {
+        fprintf(stderr, "%s: no samples\n", name);
+        exit(2);
+    }
+    return frames;
+}
+
+/*
+ * Run until occupied is as wanted or limit seconds after start have gone,
+ * returns the seconds since start
+ */
+static double until(unsigned char wanted, uint64_t start, double limit) {
+    while (occupied != wanted && hostNow - start < limit * HOST_CYCLES_PER_SECOND) {
+        hostRun(ACCEL_PERIOD * HOST_CYCLES_PER_MS);
+    }
+    return (hostNow - start) / (double)HOST_CYCLES_PER_SECOND;
+}
+
+/*
+ * Reopen the bus at bitRates[rate] and start the bus figures again once
+ * it is saved
+ */
+static void reopen(int rate) {
+    I2C_close(i2c);
+    i2cParams.bitRate = bitRates[rate].bitRate;
+    i2c = openI2C();
+    busSpeed = bitRates[rate].speed;
+    // past the save of the new speed, whose file commit would hold up a read
+    hostRun((STORE_PERIOD + 2) * HOST_CYCLES_PER_SECOND);
+    accel.burstCycles = 0;
+    memset(i2cLatency, 0, sizeof i2cLatency);
+}
+
+/*
+ * The bus checks: the longest burst fits TEMP_PERIOD, no temperature read
+ * waited behind one and the FIFO never overflowed
+ */
+static void checkBus(double seconds, uint32_t framesBefore, uint64_t producedBefore) {
+    int x;
+    double burst = accel.burstCycles / (double)HOST_CYCLES_PER_US;
+    printf("%4u Kbps: longest FIFO burst %7.1f us (TEMP_PERIOD %d us), %lu frames read of %lu, "
+           "%lu lost, %.1f bursts a minute\n", busSpeed, burst, TEMP_PERIOD * 1000,
+           (unsigned long)(accel.framesRead - framesBefore), (unsigned long)(accel.produced - producedBefore),
+           (unsigned long)accel.overruns, accel.bursts * 60.0 / seconds);
+    HOST_CHECK(burst <= TEMP_PERIOD * 1000.0);
+    HOST_CHECK(accel.overruns == 0);
+    for (x = 1; x < I2C_LATENCY_BUCKETS; x++) {
+        HOST_CHECK(i2cLatency[I2C_CONTROL][x] == 0);
+    }
+    HOST_CHECK(health == 0);
+}
+
+int main(int argc, char **argv) {
+    double seconds;
+    uint32_t frames;
+    uint64_t produced, start, stillSince = 0;
+    int rate;
+
+    makeTraces();
+    hostTemperature = 21.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    if (argc > 1) {
+        size_t length = readTrace(argv[1]);
+        hostAttachBma222e(&accel, CONFIG_I2C_0_BMA222E_ADDR, recorded, length);
+    } else {
+        hostAttachBma222e(&accel, CONFIG_I2C_0_BMA222E_ADDR, still, TRACE_FRAMES);
+    }
+    hostBoot();
+    // past the first save, whose file commit would hold up a read
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(accelPresent);
+
+    for (rate = NUMBER_OF_BIT_RATES - 1; rate > 0 && bitRates[rate].speed != busSpeed; rate--) {}
+    for (; rate >= 0; rate = rate > 0 ? 0 : -1) {
+        reopen(rate);
+        frames = accel.framesRead;
+        produced = accel.produced;
+        accel.bursts = 0;
+        start = hostNow;
+        if (argc > 1) {
+            hostRun(accel.length * 8 * HOST_CYCLES_PER_SECOND / 125);
+        } else {
+            // a still room sets back, counted from when it went still, and
+            // a person walking in ends it
+            if (accel.trace != still) {
+                accel.trace = still;
+                stillSince = hostNow;
+            }
+            seconds = until(FALSE, stillSince, 2.0 * VACANT_BURSTS * ACCEL_PERIOD / 1000);
+            printf("%4u Kbps: still room vacant after %.1f s\n", busSpeed, seconds);
+            HOST_CHECK(!occupied);
+            HOST_CHECK(heatTarget() == setPoint - SETBACK_DEGREES);
+            HOST_CHECK(seconds >= VACANT_BURSTS * ACCEL_PERIOD / 1000.0);
+            accel.trace = walking;
+            seconds = until(TRUE, hostNow, 60);
+            printf("%4u Kbps: walking occupied after %.1f s\n", busSpeed, seconds);
+            HOST_CHECK(occupied);
+            HOST_CHECK(seconds <= (1 << ACTIVITY_SHIFT) * ACCEL_PERIOD / 1000.0);
+            HOST_CHECK(heatTarget() == setPoint);
+        }
+        checkBus((hostNow - start) / (double)HOST_CYCLES_PER_SECOND, frames, produced);
+    }
+
+    printf("%s\n", hostFailures == 0 ? "all accelerometer checks hold" : "accelerometer checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+/*
+ *  ======== bootprofile.c ========
+ */
+
+// Problem Description:
+//
+// A warm boot loads the state a cold boot saved in STORE_FILE and takes
+// the saved sensor and bus speed without probing for them, and the boot
+// profile counts from Board_init(). Whether a warm boot really skips the
+// probes, what it saves against a cold one, and whether it still finds a
+// sensor when the saved one has gone, could only be seen on a board
+// reset by hand.
+
+// Solution:
+//
+// Each boot runs in a process of its own, so the firmware starts from
+// its reset state; the parent carries STORE_FILE from one to the next.
+// A cold boot with a TMP102 runs until its state is saved, then a warm
+// boot starts from that file, and a TMP116 is booted cold and its file
+// given to a boot that finds a TMP102 instead. For each the harness
+// takes the <G> phases and the <L> line, the I2C transfers and the probe
+// lines until the first sample, and the host clock at the first sample
+// and when the first telemetry line after it had gone out, which has to
+// agree with what <L> reports; the sample must come within a TEMP_PERIOD
+// of the init and the telemetry line go out with it, not at the next
+// second. The profile must start with "board". The warm boot must send
+// no probes, no more transfers, and have its sensor set up in the init
+// instead of once the tasks run the probes, and it must read it in the
+// first pass, so its first sample and telemetry line come before the
+// cold boot's, which waits for the temperature task. The boot with the
+// sensor gone must probe, find the TMP102 and report itself cold. The
+// cold boots are sent O lines that are empty, not a number, out of range
+// or have something after the number, which must all be answered <E>,
+// then one that is taken and has to be back on the warm boot. Once its
+// state is saved a cold boot has its setPoint moved while the file system
+// refuses writes: <J> must count the failed save, STORE_FILE keep the
+// record before it and the next check write the change, which the warm
+// boot comes up on. The network processor may only be on for the boot's
+// load and about a second for each save, not all the time.
+//
+// Build:   make -C tools bootprofile
+// Usage:   bootprofile
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TELEMETRY_WIRE_US 5000     // a telemetry line on the wire, behind what the ring held
+#define NWP_LOAD_MS 60              // the network processor on to load the record at boot
+#define NWP_SAVE_MS 1100            // and for a save, up to the second after it started
+
+struct boot {
+    int warm;                       // from the <L> line
+    unsigned long init, sample, telemetry;
+    double hostSample;              // host clock us the first sample was seen at
+    double hostTelemetry;           // and the first telemetry line after it had gone out
+    char phases[BOOT_PHASES][16];
+    unsigned long phaseMicros[BOOT_PHASES];
+    int phaseCount;
+    int probes;                     // "Is this" lines
+    uint32_t transfers;             // until the first sample
+    int8_t sensor;
+    int refused;                    // <E> answers
+    int offset;                     // from the last <O> answer
+    int16_t tempOffset;             // at the end
+    int setPoint;
+    unsigned long saveFailures;     // from the last <J> line
+    bool kept;                      // the failed save left STORE_FILE as it was
+    uint32_t nwpStarts;
+    double nwpOn, ran;              // ms the network processor was on, of the ms run
+    int failures;
+    uint8_t file[HOST_FILE_SIZE];   // STORE_FILE once the state is saved
+    size_t fileSize;
+};
+
+static struct boot result;
+static struct host_tmp102 tmp102;
+static struct host_tmp116 tmp116;
+
+static void line(const char *text) {
+    int fields[4];
+    if (result.phaseCount < BOOT_PHASES
+            && sscanf(text, "<G,%15[^,],%lu>", result.phases[result.phaseCount],
+                      &result.phaseMicros[result.phaseCount]) == 2) {
+        result.phaseCount++;
+    }
+    sscanf(text, "<L,%d,%lu,%lu,%lu>", &result.warm, &result.init, &result.sample, &result.telemetry);
+    if (result.hostTelemetry == 0 && sampleMicros != 0
+            && sscanf(text, "<%d,%d,%d,%d>", &fields[0], &fields[1], &fields[2], &fields[3]) == 4) {
+        result.hostTelemetry = hostUartLineSent / (double)HOST_CYCLES_PER_US;
+    }
+    if (strncmp(text, "Is this", 7) == 0) {
+        result.probes++;
+    }
+    if (strcmp(text, "<E>") == 0) {
+        result.refused++;
+    }
+    sscanf(text, "<O,%d>", &result.offset);
+    sscanf(text, "<J,%*u,%*u,%lu>", &result.saveFailures);
+}
+
+/*
+ * Send O lines the firmware has to refuse, then one it takes
+ */
+static void calibrate(void) {
+    static const char *const lines[] = {"O\r", "Ofoo\r", "O1x\r", "O99999\r", "O-1281\r", "O-64\r"};
+    size_t x;
+    for (x = 0; x < sizeof lines / sizeof lines[0]; x++) {
+        hostUartInput(lines[x]);
+        hostRun(2 * COMMAND_PERIOD * HOST_CYCLES_PER_MS);
+    }
+}
+
+/*
+ * Boot with the sensor at address from file, if any, until the first
+ * telemetry line and the state is saved
+ */
+static void boot(uint8_t address, const struct boot *from) {
+    int ms;
+    if (from != NULL) {
+        hostFileWrite(STORE_FILE, from->file, from->fileSize);
+    }
+    hostTemperature = 20.0;
+    if (address == 0x48) {
+        hostAttachTmp102(&tmp102, address);
+    } else {
+        hostAttachTmp116(&tmp116, address, CONFIG_GPIO_TMP_ALERT);
+    }
+    hostUartLine = line;
+    result.warm = -1;
+    hostBoot();
+    for (ms = 0; sampleMicros == 0 && ms < 10000; ms++) {
+        hostRun(HOST_CYCLES_PER_MS);
+    }
+    result.hostSample = hostNow / (double)HOST_CYCLES_PER_US;
+    result.transfers = hostTransfers;
+    if (from == NULL) {
+        calibrate();
+    }
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(storeWrites > 0 || from != NULL);
+    if (from == NULL) {
+        // a change the file system does not take leaves the saved record,
+        // and is written at the next check
+        uint8_t before[HOST_FILE_SIZE], after[HOST_FILE_SIZE];
+        size_t size = hostFileRead(STORE_FILE, before, sizeof before);
+        hostFileFail = true;
+        hostGpioEdge(CONFIG_GPIO_BUTTON_0);
+        hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+        hostFileFail = false;
+        result.kept = hostFileRead(STORE_FILE, after, sizeof after) == size && memcmp(before, after, size) == 0;
+        hostRun(STORE_PERIOD * HOST_CYCLES_PER_SECOND);
+    }
+    result.nwpStarts = hostNwpStarts;
+    result.nwpOn = hostNwpOnCycles() / (double)HOST_CYCLES_PER_MS;
+    result.ran = hostNow / (double)HOST_CYCLES_PER_MS;
+    result.setPoint = setPoint;
+    result.sensor = sensor;
+    result.tempOffset = tempOffset;
+    result.fileSize = hostFileRead(STORE_FILE, result.file, sizeof result.file);
+}
+
+/*
+ * Boot in a child process so the firmware starts from its reset state,
+ * and take back what it found
+ */
+static void inChild(uint8_t address, const struct boot *from, struct boot *found) {
+    int pipes[2];
+    pid_t child;
+    fflush(stdout);
+    if (pipe(pipes) != 0 || (child = fork()) < 0) {
+        perror("bootprofile");
+        exit(2);
+    }
+    if (child == 0) {
+        boot(address, from);
+        result.failures = hostFailures;
+        if (write(pipes[1], &result, sizeof result) != (ssize_t)sizeof result) {
+            _exit(2);
+        }
+        _exit(0);
+    }
+    close(pipes[1]);
+    if (read(pipes[0], found, sizeof *found) != (ssize_t)sizeof *found) {
+        fprintf(stderr, "bootprofile: the boot did not finish\n");
+        exit(2);
+    }
+    close(pipes[0]);
+    waitpid(child, NULL, 0);
+    hostFailures += found->failures;
+}
+
+/*
+ * us of the first phase called name, 0 if there is none
+ */
+static unsigned long phase(const struct boot *profile, const char *name) {
+    int x;
+    for (x = 0; x < profile->phaseCount; x++) {
+        if (strcmp(profile->phases[x], name) == 0) {
+            return profile->phaseMicros[x];
+        }
+    }
+    return 0;
+}
+
+static void report(const char *name, const struct boot *profile) {
+    int x;
+    printf("%-5s boot: sample %7.1f ms, telemetry %7.1f ms, init %6.1f ms, %d probes, %u transfers to "
+           "the first sample\n     ", name, profile->sample / 1000.0, profile->telemetry / 1000.0, profile->init / 1000.0,
+           profile->probes, (unsigned)profile->transfers);
+    for (x = 0; x < profile->phaseCount; x++) {
+        printf(" %s %.1f", profile->phases[x], profile->phaseMicros[x] / 1000.0);
+    }
+    printf("\n     host clock: sample %.1f ms, telemetry %.1f ms\n", profile->hostSample / 1000,
+           profile->hostTelemetry / 1000);
+}
+
+/*
+ * The <L> line agrees with the host clock, and the first sample and
+ * telemetry come as soon as the tasks can give them: the sample within a
+ * TEMP_PERIOD of the end of the init, the telemetry line in the pass
+ * after the sample. <L> has the telemetry line as it was queued,
+ * the host sees it once it is on the wire.
+ */
+static void checkTimes(const struct boot *profile) {
+    HOST_CHECK(profile->sample > 0 && profile->telemetry >= profile->sample);
+    // the sample is seen at the end of the host's 1 ms step it fell in
+    HOST_CHECK(profile->hostSample >= profile->sample && profile->hostSample - profile->sample <= 1000);
+    HOST_CHECK(profile->hostTelemetry >= profile->telemetry
+               && profile->hostTelemetry - profile->telemetry <= TELEMETRY_WIRE_US);
+    HOST_CHECK(profile->sample <= profile->init + TEMP_PERIOD * 1000UL);
+    HOST_CHECK(profile->telemetry <= profile->sample + TELEMETRY_WIRE_US);
+}
+
+int main(void) {
+    static struct boot cold, warm, moved, gone;
+
+    inChild(0x48, NULL, &cold);
+    inChild(0x48, &cold, &warm);
+    inChild(0x49, NULL, &moved);
+    inChild(0x48, &moved, &gone);
+    report("cold", &cold);
+    report("warm", &warm);
+    report("gone", &gone);
+
+    HOST_CHECK(cold.fileSize == sizeof(struct saved_state) && moved.fileSize == sizeof(struct saved_state));
+    HOST_CHECK(cold.phaseCount > 0 && strcmp(cold.phases[0], "board") == 0);
+    checkTimes(&cold);
+    checkTimes(&warm);
+    // the probes and the boot messages wait in the I2C queue and the UART
+    // ring, so nothing after the store holds the init up
+    HOST_CHECK(cold.init - phase(&cold, "store") < 1000);
+    HOST_CHECK(cold.warm == 0 && cold.probes > 0);
+    HOST_CHECK(cold.sensor == TMP102_SENSOR && moved.sensor == TMP116_SENSOR);
+    // the warm boot takes the saved sensor without a probe
+    HOST_CHECK(warm.warm == 1);
+    HOST_CHECK(warm.probes == 0);
+    HOST_CHECK(warm.transfers <= cold.transfers);
+    HOST_CHECK(phase(&warm, "sensor") > 0 && phase(&warm, "sensor") <= warm.init);
+    HOST_CHECK(phase(&cold, "sensor") > cold.init);
+    // and reads it in the first pass, where the cold boot is still
+    // probing, and the telemetry line follows the sample on either
+    HOST_CHECK(warm.sample < cold.sample && warm.telemetry < cold.telemetry);
+    HOST_CHECK(warm.sample <= warm.init + GLOBAL_PERIOD * 1000UL + 1000);
+    HOST_CHECK(warm.sensor == TMP102_SENSOR);
+    // O takes a number within MAX_TEMP_OFFSET and nothing else, and the
+    // calibration comes back on the warm boot
+    HOST_CHECK(cold.refused == 5 && cold.offset == -64 && cold.tempOffset == -64);
+    HOST_CHECK(warm.refused == 0 && warm.tempOffset == -64);
+    // the failed save is counted in <J>, keeps the old record and is
+    // written at the next check
+    HOST_CHECK(cold.saveFailures == 1 && cold.kept);
+    HOST_CHECK(warm.saveFailures == 0 && warm.setPoint == START_TEMP + 1);
+    // the network processor is only on to load the record and for each save
+    printf("network processor on %.1f ms of %.1f s in %u starts on the cold boot, %.1f ms on the warm one\n",
+           cold.nwpOn, cold.ran / 1000, (unsigned)cold.nwpStarts, warm.nwpOn);
+    HOST_CHECK(cold.nwpStarts == 4 && warm.nwpStarts == 1);
+    HOST_CHECK(warm.nwpOn <= NWP_LOAD_MS);
+    HOST_CHECK(cold.nwpOn <= NWP_LOAD_MS + (cold.nwpStarts - 1) * NWP_SAVE_MS);
+    // and one whose saved sensor is gone probes for the one there
+    HOST_CHECK(gone.warm == 0 && gone.probes > 0);
+    HOST_CHECK(gone.sample > 0 && gone.sensor == TMP102_SENSOR);
+
+    printf("%s\n", hostFailures == 0 ? "all boot profile checks hold" : "boot profile checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
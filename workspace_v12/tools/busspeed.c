@@ -0,0 +1,148 @@
+/*
+ *  ======== busspeed.c ========
+ */
+
+// Problem Description:
+//
+// selectBusSpeed() reopens CONFIG_I2C_0 at the fastest rate that the
+// controller, the sensor found and every other device answering support,
+// and transferI2C() times every transfer for the <I> report. Whether the
+// faster rate is worth it depends on how much of each sample is clocking
+// bytes rather than the fixed costs around them.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins, whose bus takes each transfer's
+// bits at the rate it was opened at and NACKs a device driven faster than
+// it can go. Each bus population boots in its own process and the rate
+// selectBusSpeed() picks is checked against the firmware's own tables.
+// Then the bus is reopened at every rate in bitRates[] in turn and the
+// bus time per transfer and per sample is measured from the firmware's
+// counters, which must agree with the time the bus model charged.
+//
+// Build:   make -C tools busspeed
+// Usage:   busspeed
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define RUN_SECONDS 60
+
+static struct host_tmp102 tmp102;
+static struct host_tmp116 tmp116;
+
+/*
+ * A device that acknowledges everything and reads as zeros
+ */
+static bool anything(struct host_device *device, const uint8_t *write, size_t writeCount,
+                     uint8_t *read, size_t readCount) {
+    size_t x;
+    for (x = 0; x < readCount; x++) {
+        read[x] = 0;
+    }
+    return true;
+}
+
+static struct host_device other = {CONFIG_I2C_0_BMA222E_ADDR, CONFIG_I2C_0_BMA222E_MAXSPEED, anything, NULL};
+
+/*
+ * The rate selectBusSpeed() should pick for sensor and, if present, the
+ * other device: the fastest of bitRates[] within all their limits
+ */
+static uint16_t expectedSpeed(int found, bool withOther) {
+    uint16_t limit = I2C_CONTROLLER_MAXSPEED;
+    int x;
+    if (sensors[found].maxSpeed < limit) {
+        limit = sensors[found].maxSpeed;
+    }
+    if (withOther && other.maxSpeed < limit) {
+        limit = other.maxSpeed;
+    }
+    for (x = NUMBER_OF_BIT_RATES - 1; x > 0 && bitRates[x].speed > limit; x--) {}
+    return bitRates[x].speed;
+}
+
+/*
+ * Boot with one sensor and maybe the other device in a process of its own
+ * and check the rate the firmware settles on
+ */
+static void selection(const char *name, int found, bool withOther) {
+    pid_t child = fork();
+    int status = 0;
+    if (child == 0) {
+        if (found == TMP102_SENSOR) {
+            hostAttachTmp102(&tmp102, sensors[found].address);
+        } else {
+            hostAttachTmp116(&tmp116, sensors[found].address, CONFIG_GPIO_TMP_ALERT);
+        }
+        if (withOther) {
+            hostAttach(&other);
+        }
+        hostBoot();
+        hostRun(5 * HOST_CYCLES_PER_SECOND);
+        HOST_CHECK(sensor == found);
+        HOST_CHECK(busSpeed == expectedSpeed(found, withOther));
+        HOST_CHECK(hostBusSpeed == busSpeed);
+        HOST_CHECK(tempAge == 0);
+        printf("%-20s %4u Kbps\n", name, busSpeed);
+        fflush(stdout);
+        _exit(hostFailures == 0 ? 0 : 1);
+    }
+    waitpid(child, &status, 0);
+    HOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/*
+ * Reopen the bus at bitRates[rate] and measure a minute of samples
+ */
+static void benchmark(int rate) {
+    uint32_t transfers = i2cTransfers;
+    uint32_t busCycles = i2cBusCycles;
+    uint64_t modelCycles = hostBusCycles;
+    uint32_t reads = tmp102.reads;
+    double perTransfer, perSample;
+
+    I2C_close(i2c);
+    i2cParams.bitRate = bitRates[rate].bitRate;
+    i2c = openI2C();
+    busSpeed = bitRates[rate].speed;
+    i2cMaxCycles = 0;
+    hostRun(RUN_SECONDS * HOST_CYCLES_PER_SECOND);
+
+    transfers = i2cTransfers - transfers;
+    busCycles = i2cBusCycles - busCycles;
+    perTransfer = busCycles / (double)transfers / HOST_CYCLES_PER_US;
+    perSample = busCycles / (double)(tmp102.reads - reads) / HOST_CYCLES_PER_US;
+    printf("%4u Kbps: %7.1f us a transfer, longest %7.1f us, %7.1f us a sample, %.3f%% of TEMP_PERIOD\n",
+           bitRates[rate].speed, perTransfer, i2cMaxCycles / (double)HOST_CYCLES_PER_US, perSample,
+           perSample / (TEMP_PERIOD * 10.0));
+    // the firmware times what the bus took
+    HOST_CHECK(busCycles == hostBusCycles - modelCycles);
+    HOST_CHECK(i2cMaxCycles == hostTransferCycles(1, 2));
+    HOST_CHECK(tempAge == 0);
+}
+
+int main(void) {
+    int x;
+
+    selection("TMP102", TMP102_SENSOR, false);
+    selection("TMP102 and BMA222E", TMP102_SENSOR, true);
+    selection("TMP116", TMP116_SENSOR, false);
+    selection("TMP116 and BMA222E", TMP116_SENSOR, true);
+
+    hostTemperature = 21.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, sensors[TMP102_SENSOR].address);
+    hostBoot();
+    hostRun(5 * HOST_CYCLES_PER_SECOND);
+    for (x = 0; x < NUMBER_OF_BIT_RATES; x++) {
+        benchmark(x);
+    }
+
+    printf("%s\n", hostFailures == 0 ? "all bus speed checks hold" : "bus speed checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+ *  ======== eventlatency.c ========
+ */
+
+// Problem Description:
+//
+// With REACTIVE_HEAT a button press releases changeTempSetPoint() at once
+// and the heater follows through heatInputChanged(), where it used to wait
+// for the 1 s task. The press still has to wait for the pass it lands in,
+// serviceI2C() and its FIFO bursts included, so how long a press takes to
+// reach the heater output depends on when it comes.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 and a BMA222E at
+// a room temperature on the setPoint, so every press moves the duty. The
+// harness presses the buttons, up and down in turn, at random times and
+// takes the time from the edge to the PWM duty change that the new
+// setPoint makes. A press only waits when it lands in a pass, so it
+// reports p50, p99, p99.9 and the worst case against the 1 s
+// the polled setHeat() could take. It then presses once inside each of
+// COMMIT_PRESSES state file commits, where saveState() holds
+// oneSecondTasks() for the longest, and checks that the firmware's own <R>
+// figure is the worst of those. Every press has to reach the heater
+// within the budget: the cooperative response time of changeTempSetPoint()
+// that schedcheck works out, the wcet.txt figures of all the tasks added
+// up, 50.05 ms at present. Last it presses one button BURST times inside a
+// sample, each way, where the duty may only move the step of the reading
+// before the burst and one more, not a step a press.
+//
+// Build:   make -C tools eventlatency
+// Usage:   eventlatency [wcet.txt]
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define PRESSES 10000
+#define PRESS_GAP_MS 1500           // most time from one press being handled to the next
+#define SETTLE_MS 200               // run on after a press, more than any pass
+#define BURST 10                    // presses in a row, inside one TEMP_PERIOD
+#define BURST_GAP_MS 10
+#define COMMIT_PRESSES 50           // presses that land while a save commits the state file
+
+static struct host_tmp102 tmp102;
+static struct host_bma222e accel;
+static int8_t moving[2][3] = {{0, 0, 64}, {12, -12, 64}};     // someone in, so no setback
+static uint64_t latencies[PRESSES];
+static uint64_t commitLatencies[COMMIT_PRESSES];
+static bool armed;                  // press during the next commit
+static uint64_t pressed;
+static uint64_t reacted;
+static bool waiting;
+static int setPointBefore;
+
+/*
+ * The button edge, arg is the button
+ */
+static void press(void *arg) {
+    pressed = hostNow;
+    waiting = true;
+    setPointBefore = setPoint;
+    hostGpioEdge((uint_least8_t)(uintptr_t)arg);
+}
+
+/*
+ * A duty change counts for the press once the setPoint has moved, not
+ * for a reading that came in before it was handled
+ */
+static void dutyChanged(uint32_t duty) {
+    if (waiting && setPoint != setPointBefore) {
+        reacted = hostNow;
+        waiting = false;
+    }
+}
+
+/*
+ * BURST presses of button BURST_GAP_MS apart, all inside one sample, and
+ * the most the duty moved from where it was before them. The duty may
+ * move a step at the reading before the burst as well as one inside it.
+ */
+static int32_t burst(uint_least8_t button) {
+    int32_t before = zoneDuty[0], most = 0;
+    int n;
+    for (n = 0; n < BURST; n++) {
+        hostGpioEdge(button);
+        hostRun(BURST_GAP_MS * HOST_CYCLES_PER_MS);
+        if (abs(zoneDuty[0] - before) > most) {
+            most = abs(zoneDuty[0] - before);
+        }
+    }
+    return most;
+}
+
+/*
+ * A save is committing the state file for cycles: press at a random time
+ * inside the commit, between the setPoint and one above so the duty can
+ * follow
+ */
+static void committing(uint64_t cycles) {
+    if (armed) {
+        armed = false;
+        hostSchedule(hostNow + (uint64_t)rand() * cycles / RAND_MAX, press,
+                     (void *)(uintptr_t)(setPoint > START_TEMP ? CONFIG_GPIO_BUTTON_1 : CONFIG_GPIO_BUTTON_0));
+    }
+}
+
+/*
+ * The longest a press may take to reach the heater, in cycles. The press
+ * releases changeTempSetPoint() at once, but it has to wait for the rest
+ * of the pass it lands in, so this is the cooperative response time
+ * schedcheck works out for it: the worst cases wcet.txt gives every task,
+ * added up.
+ */
+static uint64_t latencyBudget(const char *path) {
+    char text[256], name[64];
+    long us, total = 0;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(text, sizeof text, file) != NULL) {
+        if (sscanf(text, "%63s %ld", name, &us) == 2 && name[0] != '#') {
+            total += us;
+        }
+    }
+    fclose(file);
+    return (uint64_t)total * HOST_CYCLES_PER_US;
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+    uint64_t gap = PRESS_GAP_MS * HOST_CYCLES_PER_MS;
+    uint64_t budget = latencyBudget(argc > 1 ? argv[1] : "wcet.txt");
+    int n, second, missed = 0;
+    int32_t stepped;
+    double p50, p99, p999, worst, commitWorst;
+
+    hostTemperature = START_TEMP;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostAttachBma222e(&accel, CONFIG_I2C_0_BMA222E_ADDR, moving, 2);
+    hostBoot();
+    // past the first save, whose file commit would be the longest pass
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(REACTIVE_HEAT);
+    HOST_CHECK(accelPresent);
+    hostPwmChanged = dutyChanged;
+    hostLongestPass = 0;
+    maxReaction = 0;
+
+    srand(1);
+    for (n = 0; n < PRESSES; n++) {
+        // a random wait, so the presses land at every phase of the tasks
+        uint64_t offset = (uint64_t)rand() * gap / RAND_MAX;
+        hostSchedule(hostNow + offset, press,
+                     (void *)(uintptr_t)(n % 2 == 0 ? CONFIG_GPIO_BUTTON_0 : CONFIG_GPIO_BUTTON_1));
+        hostRun(offset + SETTLE_MS * HOST_CYCLES_PER_MS);
+        if (waiting) {
+            missed++;
+            latencies[n] = UINT64_MAX;
+        } else {
+            latencies[n] = reacted - pressed;
+        }
+    }
+    HOST_CHECK(missed == 0);
+
+    // the presses of a burst move the duty no more than a reading would
+    hostRun(SETTLE_MS * HOST_CYCLES_PER_MS);
+    stepped = burst(CONFIG_GPIO_BUTTON_0);
+    hostRun(5 * HOST_CYCLES_PER_SECOND);
+    n = burst(CONFIG_GPIO_BUTTON_1);
+    stepped = n > stepped ? n : stepped;
+    hostRun(5 * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(setPoint == START_TEMP);
+
+    // presses while a save commits the state file wait for the rest of
+    // oneSecondTasks(); each one is a change for the next save
+    hostFileCommit = committing;
+    if (saved.setPoint == setPoint) {
+        hostGpioEdge(CONFIG_GPIO_BUTTON_0);
+    }
+    for (n = 0; n < COMMIT_PRESSES; n++) {
+        armed = true;
+        for (second = 0; (armed || waiting) && second < 2 * STORE_PERIOD; second++) {
+            hostRun(HOST_CYCLES_PER_SECOND);
+        }
+        if (armed || waiting) {
+            missed++;
+            commitLatencies[n] = UINT64_MAX;
+        } else {
+            commitLatencies[n] = reacted - pressed;
+        }
+    }
+    HOST_CHECK(missed == 0);
+
+    qsort(latencies, PRESSES, sizeof latencies[0], compare);
+    p50 = latencies[PRESSES / 2] / (double)HOST_CYCLES_PER_US;
+    p99 = latencies[PRESSES * 99 / 100] / (double)HOST_CYCLES_PER_US;
+    p999 = latencies[PRESSES * 999 / 1000] / (double)HOST_CYCLES_PER_US;
+    worst = latencies[PRESSES - 1] / (double)HOST_CYCLES_PER_US;
+    printf("%d presses to the heater output: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, worst %.1f us "
+           "(polled setHeat() up to %d us)\n", PRESSES, p50, p99, p999, worst, UART_PERIOD * 1000);
+    qsort(commitLatencies, COMMIT_PRESSES, sizeof commitLatencies[0], compare);
+    commitWorst = commitLatencies[COMMIT_PRESSES - 1] / (double)HOST_CYCLES_PER_US;
+    printf("%d presses during a state file commit: fastest %.1f us, worst %.1f us\n", COMMIT_PRESSES,
+           commitLatencies[0] / (double)HOST_CYCLES_PER_US, commitWorst);
+    printf("longest pass %.1f us, <R> %.1f us, budget %.1f us from wcet.txt\n",
+           hostLongestPass / (double)HOST_CYCLES_PER_US, maxReaction / (double)HOST_CYCLES_PER_US,
+           budget / (double)HOST_CYCLES_PER_US);
+    printf("%d presses %d ms apart moved the duty by %.1f%% at most, a step is %.1f%%\n", BURST, BURST_GAP_MS,
+           stepped * 100.0 / HEAT_DUTY_MAX, HEAT_DUTY_STEP * 100.0 / HEAT_DUTY_MAX);
+    HOST_CHECK(stepped <= 2 * HEAT_DUTY_STEP);
+    HOST_CHECK(latencies[PRESSES - 1] <= budget);
+    HOST_CHECK(commitLatencies[COMMIT_PRESSES - 1] <= budget);
+    HOST_CHECK(commitLatencies[COMMIT_PRESSES - 1] > latencies[PRESSES - 1]);
+    HOST_CHECK(maxReaction == commitLatencies[COMMIT_PRESSES - 1]);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all event latency checks hold" : "event latency checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+ *  ======== healthfaults.c ========
+ */
+
+// Problem Description:
+//
+// checkHealth() is meant to turn the heat off for a sensor that fails,
+// freezes, jumps about or reads out of range, and to do nothing for a
+// reading that spikes once or a room that really steps. How long each
+// fault takes to be noticed, and that a spike or a step is not taken for
+// one, was never measured.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 in a room below
+// the setPoint, so the heater is on. Each scenario injects a fault at a
+// random time in the TEMP_PERIOD and runs a millisecond at a time until
+// the health flag it should raise is set, which is the detection latency;
+// the heat must be off then. The faults are a sensor that reads out of
+// range, one that jumps between readings that do not agree, one that is
+// gone from the bus and one that holds the same code. A spike of one
+// reading and a step of a few degrees must raise nothing, the spike must
+// not reach the temperature and the step must. Each scenario ends with the
+// fault cleared and the readings back. It then times checkHealth() on the
+// host, against the filterTemp() the same reading goes through.
+//
+// Build:   make -C tools healthfaults
+// Usage:   healthfaults
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define ROOM (START_TEMP - 2.5)      // clear of a whole degree, so noise does not flip it
+#define JUMPS 7
+#define JUMP_MS 100                 // a jump reading lasts, not a divisor of TEMP_PERIOD
+#define BENCHMARK_READINGS 20000000
+
+static struct host_tmp102 tmp102;
+static const double jumps[JUMPS] = {5, -5, 10, -10, 15, -15, 20};
+static int jump;
+static bool jumping;
+
+/*
+ * Move the true temperature to the next of jumps every JUMP_MS, so no two
+ * readings TEMP_PERIOD apart agree
+ */
+static void nextJump(void *arg) {
+    if (!jumping) {
+        return;
+    }
+    hostTemperature = ROOM + jumps[jump];
+    jump = (jump + 1) % JUMPS;
+    hostSchedule(hostNow + JUMP_MS * HOST_CYCLES_PER_MS, nextJump, NULL);
+}
+
+/*
+ * Wait for a random part of a TEMP_PERIOD, so the fault lands at any phase
+ * of the reads
+ */
+static void randomPhase(void) {
+    hostRun((uint64_t)rand() * TEMP_PERIOD * HOST_CYCLES_PER_MS / RAND_MAX);
+}
+
+/*
+ * Run a millisecond at a time until flag is set, for at most limit ms,
+ * and return the ms it took, or -1. The heat has to be off by then.
+ */
+static long detect(unsigned char flag, long limit) {
+    long ms;
+    for (ms = 0; ms <= limit; ms++) {
+        if (health & flag) {
+            HOST_CHECK(hostPwmDuty == 0);
+            HOST_CHECK(HEAT_STATE == HEAT_OFF);
+            return ms;
+        }
+        hostRun(HOST_CYCLES_PER_MS);
+    }
+    return -1;
+}
+
+/*
+ * Report a detection latency against its bound, both in ms
+ */
+static void report(const char *name, long ms, long bound) {
+    printf("%-22s detected in %8ld ms, %6.1f readings, bound %8ld ms\n", name, ms, ms / (double)TEMP_PERIOD,
+           bound);
+    HOST_CHECK(ms >= 0);
+    HOST_CHECK(ms <= bound);
+}
+
+/*
+ * The fault has cleared: within a few readings the health is back and the
+ * temperature is the room's
+ */
+static void checkRecovered(void) {
+    hostRun(2 * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(health == 0);
+    HOST_CHECK(temperature == (int)hostTemperature);
+    HOST_CHECK(hostPwmDuty > 0);
+}
+
+/*
+ * A single reading far off: dropped, no flag and no change of temperature
+ */
+static void spike(void) {
+    int before = temperature;
+    bool raised = false;
+    int ms;
+    randomPhase();
+    hostTemperature = ROOM + 20;
+    // one reading's worth, then back
+    for (ms = 0; ms < TEMP_PERIOD; ms++) {
+        hostRun(HOST_CYCLES_PER_MS);
+        raised |= health != 0 || temperature != before;
+    }
+    hostTemperature = ROOM;
+    for (ms = 0; ms < 5 * TEMP_PERIOD; ms++) {
+        hostRun(HOST_CYCLES_PER_MS);
+        raised |= health != 0 || temperature != before;
+    }
+    printf("%-22s %s\n", "one reading spike", raised ? "taken for a fault" : "dropped");
+    HOST_CHECK(!raised);
+}
+
+/*
+ * A real step of 3 degrees: no flag, taken after HEALTH_SLEW_REJECTS
+ * readings that agree
+ */
+static void step(void) {
+    uint64_t start;
+    bool raised = false;
+    long ms;
+    randomPhase();
+    start = hostNow;
+    hostTemperature = ROOM + 3;
+    for (ms = 0; ms < 20 * TEMP_PERIOD && temperature != (int)hostTemperature; ms++) {
+        hostRun(HOST_CYCLES_PER_MS);
+        raised |= health != 0;
+    }
+    printf("%-22s taken after %8.0f ms\n", "3 degree step", (hostNow - start) / (double)HOST_CYCLES_PER_MS);
+    HOST_CHECK(!raised);
+    HOST_CHECK(temperature == (int)hostTemperature);
+    hostTemperature = ROOM;
+    hostRun(20 * TEMP_PERIOD * HOST_CYCLES_PER_MS);
+    HOST_CHECK(health == 0);
+}
+
+int main(void) {
+    long bound;
+    int x;
+    double start, perCheck, perFilter;
+    volatile int16_t sink;
+
+    hostTemperature = ROOM;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostBoot();
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(health == 0);
+    HOST_CHECK(hostPwmDuty > 0);
+    srand(1);
+
+    spike();
+    step();
+
+    randomPhase();
+    hostTemperature = 200;
+    bound = 2 * TEMP_PERIOD;
+    report("out of range", detect(HEALTH_RANGE, bound), bound);
+    hostTemperature = ROOM;
+    checkRecovered();
+
+    randomPhase();
+    jumping = true;
+    nextJump(NULL);
+    bound = (HEALTH_SLEW_REJECTS + 1) * TEMP_PERIOD;
+    report("readings that jump", detect(HEALTH_SLEW, bound), bound);
+    jumping = false;
+    hostTemperature = ROOM;
+    checkRecovered();
+
+    randomPhase();
+    hostDetach(&tmp102.device);
+    // MAX_TEMP_AGE missed reads, and their retries
+    bound = (MAX_TEMP_AGE + 1) * TEMP_PERIOD + 100;
+    report("sensor gone", detect(HEALTH_STALE, bound), bound);
+    hostAttach(&tmp102.device);
+    // the reads back off after failures
+    hostRun(30 * HOST_CYCLES_PER_SECOND);
+    checkRecovered();
+
+    randomPhase();
+    hostNoise = 0;
+    bound = (HEALTH_STUCK_SECONDS + 2) * 1000L;
+    report("stuck code", detect(HEALTH_STUCK, bound), bound);
+    hostNoise = 0.05;
+    checkRecovered();
+
+    start = hostSeconds();
+    for (x = 0; x < BENCHMARK_READINGS; x++) {
+        checkHealth((int16_t)(ROOM * 128 + (x & 7)));
+    }
+    perCheck = (hostSeconds() - start) * 1e9 / BENCHMARK_READINGS;
+    start = hostSeconds();
+    for (x = 0; x < BENCHMARK_READINGS; x++) {
+        sink = filterTemp((int16_t)(ROOM * 128 + (x & 7)));
+    }
+    (void)sink;
+    perFilter = (hostSeconds() - start) * 1e9 / BENCHMARK_READINGS;
+    printf("checkHealth %.1f ns a reading, filterTemp %.1f ns on the host\n", perCheck, perFilter);
+
+    printf("%s\n", hostFailures == 0 ? "all health fault checks hold" : "health fault checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
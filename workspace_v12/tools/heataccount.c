@@ -0,0 +1,145 @@
+/*
+ *  ======== heataccount.c ========
+ */
+
+// Problem Description:
+//
+// accountHeat() adds up the heater's on time from the cycle counter at
+// every duty change, where a count of seconds the heat was seen on would
+// miss whatever happened between two looks. The <D> block and the duty
+// cycle are only as good as those totals, and nothing compared them with
+// the on time the heater really had.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 in the room of
+// the telemetry harness for a day, with the setPoint stepped up in the
+// morning and down in the evening so the heat goes off and on again. The
+// host PWM adds up the true on time, weighted by the duty, and counts the
+// times the heat came on. Alongside, the harness reconstructs the on time
+// the way a once a second look at the output would. It checks the
+// firmware's totals, turn on count and DUTY_WINDOW duty against the true
+// ones, reports how far the per second reconstruction is off, and checks
+// the <D> block against the totals it was sent from.
+//
+// Build:   make -C tools heataccount
+// Usage:   heataccount
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAY 86400
+#define OUTSIDE 8.0                 // degrees C, the mean of the day
+#define OUTSIDE_SWING 5.0           // degrees either way over the day
+#define LOSS (1.0 / 3600)           // of the difference to the outside a second
+#define HEATER (25.0 / 3600)        // degrees a second at full duty
+#define MORNING (7 * 3600)          // the setPoint goes up two degrees
+#define EVENING (22 * 3600)         // and down four
+#define PWM_FULL 4294967296.0       // PWM_DUTY_FRACTION_MAX + 1
+
+static struct host_tmp102 tmp102;
+static uint32_t turnedOn;
+static unsigned long blockCycles, blockOnSeconds, blockPermille, blockWh;
+static int blocks;
+static uint64_t windowOn[DAY / DUTY_WINDOW + 2];
+static uint64_t windowAt[DAY / DUTY_WINDOW + 2];
+
+static void dutyChanged(uint32_t duty) {
+    if (hostPwmDuty == 0 && duty > 0) {
+        turnedOn++;
+    }
+}
+
+static void line(const char *text) {
+    if (sscanf(text, "<D,%lu,%lu,%lu,%lu>", &blockCycles, &blockOnSeconds, &blockPermille, &blockWh) == 4) {
+        blocks++;
+        // the block goes out with the totals of this second
+        HOST_CHECK(blockCycles == heatCycles);
+        HOST_CHECK(blockOnSeconds == heatOnCycles / CPU_FREQUENCY);
+        HOST_CHECK(blockPermille == dutyPermille);
+        HOST_CHECK(blockWh == blockOnSeconds * HEATER_WATTS / 3600);
+    }
+}
+
+/*
+ * Press a button count times, a pass apart
+ */
+static void press(uint_least8_t button, int count) {
+    while (count-- > 0) {
+        hostGpioEdge(button);
+        hostRun(GLOBAL_PERIOD * HOST_CYCLES_PER_MS);
+    }
+}
+
+int main(void) {
+    uint64_t onBefore, accountedBefore, trueOn, accounted;
+    uint32_t cyclesBefore;
+    double polled = 0, exactError, polledError, windowDuty;
+    int second, windows = 0, lastWindow;
+
+    hostTemperature = 18.0;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(HEAT_PWM);
+    press(CONFIG_GPIO_BUTTON_1, START_TEMP - 19);
+    hostPwmChanged = dutyChanged;
+    accountHeat();
+    onBefore = hostPwmOnCycles();
+    accountedBefore = heatOnCycles;
+    cyclesBefore = heatCycles;
+    lastWindow = seconds / DUTY_WINDOW;
+
+    for (second = 0; second < DAY; second++) {
+        double outside = OUTSIDE + OUTSIDE_SWING * sin(2 * M_PI * (second - 9 * 3600) / DAY);
+        double duty = hostPwmDuty / PWM_FULL;
+        hostTemperature += HEATER * duty - LOSS * (hostTemperature - outside);
+        // what a look at the output once a second sees
+        polled += duty;
+        if (second == MORNING) {
+            press(CONFIG_GPIO_BUTTON_0, 2);
+        } else if (second == EVENING) {
+            press(CONFIG_GPIO_BUTTON_1, 4);
+        }
+        hostRun(HOST_CYCLES_PER_SECOND);
+        if (seconds / DUTY_WINDOW != lastWindow && windows < DAY / DUTY_WINDOW + 2) {
+            lastWindow = seconds / DUTY_WINDOW;
+            windowOn[windows] = hostPwmOnCycles();
+            windowAt[windows] = hostNow;
+            windows++;
+        }
+    }
+
+    accountHeat();
+    trueOn = hostPwmOnCycles() - onBefore;
+    accounted = heatOnCycles - accountedBefore;
+    exactError = fabs((double)accounted - (double)trueOn) / CPU_FREQUENCY;
+    polledError = fabs(polled - (double)trueOn / CPU_FREQUENCY);
+    printf("a day: heat on %.3f s, accounted %.3f s (off by %.6f s), polled each second %.3f s (off by %.3f s)\n",
+           (double)trueOn / CPU_FREQUENCY, (double)accounted / CPU_FREQUENCY, exactError, polled, polledError);
+    printf("heat came on %lu times, accounted %lu; %d <D> blocks\n", (unsigned long)turnedOn,
+           (unsigned long)(heatCycles - cyclesBefore), blocks);
+    // the duty goes to the PWM in 32 bits from 16, so at most a part in 65536 is lost
+    HOST_CHECK(exactError <= (double)trueOn / CPU_FREQUENCY / 65536 + 0.001);
+    HOST_CHECK(exactError < polledError);
+    HOST_CHECK(heatCycles - cyclesBefore == turnedOn);
+    HOST_CHECK(turnedOn > 1);
+    HOST_CHECK(blocks >= DAY / WCET_REPORT_PERIOD - 1);
+
+    // the last full window, as the host saw it, within the second the
+    // window edges can be apart
+    HOST_CHECK(windows >= 2);
+    windowDuty = 1000.0 * (windowOn[windows - 1] - windowOn[windows - 2])
+        / (windowAt[windows - 1] - windowAt[windows - 2]);
+    printf("last DUTY_WINDOW %u permille, true %.1f permille\n", dutyPermille, windowDuty);
+    HOST_CHECK(fabs(dutyPermille - windowDuty) <= 1000.0 / DUTY_WINDOW + 1);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all heat accounting checks hold" : "heat accounting checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,698 @@
+/*
+ *  ======== host.c ========
+ *  Simulated clock and drivers behind the host stand-in headers, see host.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ti/drivers/GPIO.h>
+#include <ti/drivers/I2C.h>
+#include <ti/drivers/PWM.h>
+#include <ti/drivers/Timer.h>
+#include <ti/drivers/UART.h>
+#include <ti/drivers/dpl/ClockP.h>
+#include <ti/drivers/net/wifi/simplelink.h>
+#include <ti/devices/cc32xx/inc/hw_memmap.h>
+#include <ti/devices/cc32xx/driverlib/gpio.h>
+#include <ti/devices/cc32xx/driverlib/i2c.h>
+#include <ti/devices/cc32xx/driverlib/pin.h>
+#include <ti/devices/cc32xx/driverlib/prcm.h>
+#include <ti/devices/cc32xx/driverlib/utils.h>
+
+#include "ti_drivers_config.h"
+#include "host.h"
+
+#define MAX_EVENTS 32
+#define MAX_PINS 8
+#define LINE_LENGTH 256
+#define INPUT_LENGTH 1024
+#define SCL_BIT 0x04                // I2C_SCL_BIT and I2C_SDA_BIT of the firmware
+#define SDA_BIT 0x08
+#define BITS_PER_BYTE 9             // eight and the acknowledge
+#define UART_BITS_PER_BYTE 10       // start, eight, stop
+#define MAX_FILES 4
+#define SL_START_US 50000           // the network processor starting up, roughly
+#define SL_COMMIT_US 20000          // writing a failsafe file's copy and closing it, roughly
+#define SL_STOP_US 1000             // the network processor hibernating, roughly
+#define PAINT 0xA5A5A5A5
+
+// what the firmware has to give us
+extern volatile unsigned char ready_tasks;
+void initProfiler(void);
+void bootMark(const char *name);
+void initThermostat(void);
+void runTasks(void);
+
+// the stack and heap the linker symbols point at, see HOST_LDFLAGS
+uint32_t hostStack[0x1000 / 4];
+uint32_t hostHeap[0x8000 / 4];
+
+struct event {
+    uint64_t when;
+    void (*fire)(void *arg);
+    void *arg;
+};
+
+uint32_t hostDemcr = 0;
+uint32_t hostDwtCtrl = 0;
+uint64_t hostNow = 0;
+void (*hostCounterRead)(void) = NULL;
+uint64_t hostLongestPass = 0;
+uint16_t hostBusSpeed = 0;
+int hostNacks = 0;
+int hostStuckClocks = 0;
+uint32_t hostTransfers = 0;
+uint64_t hostBusCycles = 0;
+void (*hostUartLine)(const char *line) = NULL;
+uint64_t hostUartLineSent = 0;
+bool hostEcho = false;
+uint64_t hostUartBytes = 0;
+uint32_t hostPwmDuty = 0;
+void (*hostPwmChanged)(uint32_t duty) = NULL;
+int hostFailures = 0;
+uint32_t hostFileCommits = 0;
+bool hostFileFail = false;
+uint32_t hostNwpStarts = 0;
+void (*hostFileCommit)(uint64_t cycles) = NULL;
+
+static struct event events[MAX_EVENTS];
+static int numberOfEvents = 0;
+
+static uint32_t counter = 0;        // DWT_CYCCNT, as the firmware may write it
+static uint32_t given = 0;          // what it last read as
+static uint64_t counterBase = 0;    // hostNow the counter was at 0
+static bool inCounterRead = false;
+
+static struct host_device *devices = NULL;
+static bool busOpen = false;
+static bool sclHigh = true;
+
+static struct {
+    GPIO_CallbackFxn callback;
+    bool enabled;
+    unsigned int value;
+} pins[MAX_PINS];
+
+static UART_Params uartParams;
+static void *readBuffer = NULL;
+static char input[INPUT_LENGTH];
+static int inputHead = 0, inputTail = 0;
+static uint64_t inputFree = 0;      // hostNow the line is free for the next input byte
+static size_t writeSize = 0;        // of the write in progress in callback mode
+static char line[LINE_LENGTH];
+static int lineLength = 0;
+
+static Timer_Params timerParams;
+static uint64_t pwmChecked = 0;
+static uint64_t pwmOn = 0;
+static struct {
+    char name[64];
+    uint8_t data[HOST_FILE_SIZE];   // what a read sees
+    uint8_t copy[HOST_FILE_SIZE];   // what the open write has written
+    uint32_t size, copySize, maxSize;
+    bool writing;
+} files[MAX_FILES];
+static int numberOfFiles = 0;
+static enum {NWP_OFF, NWP_STARTING, NWP_UP} nwpState = NWP_OFF;
+static uint64_t nwpChanged;             // hostNow it was started or stopped at
+static uint64_t nwpOnCycles;            // before that
+static P_INIT_CALLBACK nwpStarted;
+
+static int handle;                  // something for the handles to point at
+
+/*
+ * Cortex-M4 cycle counter. A value written to it since the last read
+ * restarts the count from there.
+ */
+volatile uint32_t *hostCycleCounter(void) {
+    if (counter != given) {
+        counterBase = hostNow - counter;
+    }
+    if (hostCounterRead != NULL && !inCounterRead) {
+        inCounterRead = true;
+        hostCounterRead();
+        inCounterRead = false;
+    }
+    counter = given = (uint32_t)(hostNow - counterBase);
+    return &counter;
+}
+
+void hostSchedule(uint64_t when, void (*fire)(void *arg), void *arg) {
+    int x = numberOfEvents;
+    if (numberOfEvents == MAX_EVENTS) {
+        fprintf(stderr, "host: too many events\n");
+        exit(2);
+    }
+    while (x > 0 && events[x - 1].when > when) {
+        events[x] = events[x - 1];
+        x--;
+    }
+    events[x].when = when;
+    events[x].fire = fire;
+    events[x].arg = arg;
+    numberOfEvents++;
+}
+
+/*
+ * Move the clock on by cycles, running every event that falls due on the
+ * way at its own time, the way an interrupt would cut in
+ */
+void hostAdvance(uint64_t cycles) {
+    uint64_t end = hostNow + cycles;
+    while (numberOfEvents > 0 && events[0].when <= end) {
+        struct event due = events[0];
+        numberOfEvents--;
+        memmove(&events[0], &events[1], numberOfEvents * sizeof events[0]);
+        if (due.when > hostNow) {
+            hostNow = due.when;
+        }
+        due.fire(due.arg);
+    }
+    hostNow = end;
+}
+
+/*
+ * Start the firmware the way main() and mainThread() do, less painting
+ * the stack, which on the host is not where paintMemory() thinks it is
+ */
+void hostBoot(void) {
+    int x;
+    for (x = 0; x < (int)(sizeof hostStack / sizeof hostStack[0]); x++) {
+        hostStack[x] = PAINT;
+    }
+    for (x = 0; x < (int)(sizeof hostHeap / sizeof hostHeap[0]); x++) {
+        hostHeap[x] = PAINT;
+    }
+    initProfiler();
+    Board_init();
+    bootMark("board");
+    initThermostat();
+}
+
+/*
+ * mainThread()'s loop: wait for the timer to release a task, then run a
+ * pass, for cycles of simulated time
+ */
+void hostRun(uint64_t cycles) {
+    uint64_t end = hostNow + cycles;
+    while (hostNow < end) {
+        uint64_t start;
+        if (!ready_tasks) {
+            uint64_t next = numberOfEvents > 0 && events[0].when < end ? events[0].when : end;
+            hostAdvance(next > hostNow ? next - hostNow : 0);
+            continue;
+        }
+        ready_tasks = 0;
+        start = hostNow;
+        runTasks();
+        if (hostNow - start > hostLongestPass) {
+            hostLongestPass = hostNow - start;
+        }
+    }
+}
+
+void hostCheck(bool ok, const char *what, const char *file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        hostFailures++;
+    }
+}
+
+double hostSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// ======== I2C ========
+
+void hostAttach(struct host_device *device) {
+    device->next = devices;
+    devices = device;
+}
+
+void hostDetach(struct host_device *device) {
+    struct host_device **link = &devices;
+    while (*link != NULL && *link != device) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = device->next;
+    }
+}
+
+/*
+ * Time on the bus of a transfer at hostBusSpeed: START, the address and
+ * the bytes written, a repeated START and the address again if it reads,
+ * the bytes read, and STOP
+ */
+uint64_t hostTransferCycles(size_t writeCount, size_t readCount) {
+    uint64_t bits = 2 + BITS_PER_BYTE * (1 + writeCount);
+    if (readCount > 0) {
+        bits += 1 + BITS_PER_BYTE * (1 + readCount);
+    }
+    return bits * HOST_CYCLES_PER_MS / hostBusSpeed;
+}
+
+void I2C_init(void) {
+}
+
+void I2C_Params_init(I2C_Params *params) {
+    memset(params, 0, sizeof *params);
+    params->bitRate = I2C_100kHz;
+}
+
+I2C_Handle I2C_open(uint_least8_t index, I2C_Params *params) {
+    static const uint16_t speeds[] = {100, 400, 1000, 3400};
+    hostBusSpeed = speeds[params->bitRate];
+    busOpen = true;
+    return (I2C_Handle)&handle;
+}
+
+void I2C_close(I2C_Handle handle) {
+    busOpen = false;
+}
+
+/*
+ * A held SDA lets nothing through and the driver waits out the timeout.
+ * Otherwise the transfer takes its bytes at the bus speed, or one address
+ * byte if nobody acknowledges.
+ */
+int_fast16_t I2C_transferTimeout(I2C_Handle handle, I2C_Transaction *transaction, uint32_t timeout) {
+    uint64_t limit = (uint64_t)timeout * HOST_TICK_US * HOST_CYCLES_PER_US;
+    uint64_t cycles = hostTransferCycles(transaction->writeCount, transaction->readCount);
+    struct host_device *device = devices;
+    bool ok;
+
+    hostTransfers++;
+    if (!busOpen) {
+        return I2C_STATUS_ERROR;
+    }
+    if (hostStuckClocks != 0) {
+        hostBusCycles += limit;
+        hostAdvance(limit);
+        return I2C_STATUS_TIMEOUT;
+    }
+    while (device != NULL && device->address != transaction->slaveAddress) {
+        device = device->next;
+    }
+    if (device == NULL || hostBusSpeed > device->maxSpeed || hostNacks > 0) {
+        if (hostNacks > 0) {
+            hostNacks--;
+        }
+        cycles = hostTransferCycles(0, 0);
+        hostBusCycles += cycles;
+        hostAdvance(cycles);
+        return I2C_STATUS_ADDR_NACK;
+    }
+    if (cycles > limit) {
+        hostBusCycles += limit;
+        hostAdvance(limit);
+        return I2C_STATUS_TIMEOUT;
+    }
+    hostBusCycles += cycles;
+    hostAdvance(cycles);
+    ok = device->transfer(device, transaction->writeBuf, transaction->writeCount,
+                          transaction->readBuf, transaction->readCount);
+    return ok ? I2C_STATUS_SUCCESS : I2C_STATUS_ADDR_NACK;
+}
+
+void I2CMasterTimeoutSet(unsigned long ulBase, unsigned long ulValue) {
+}
+
+void PRCMPeripheralClkEnable(unsigned long ulPeripheral, unsigned long ulClkFlags) {
+}
+
+void PinTypeGPIO(unsigned long ulPin, unsigned long ulPinMode, bool bOpenDrain) {
+}
+
+void PinConfigSet(unsigned long ulPin, unsigned long ulPinStrength, unsigned long ulPinType) {
+}
+
+void GPIODirModeSet(unsigned long ulPort, unsigned char ucPins, unsigned long ulPinIO) {
+}
+
+/*
+ * SDA reads low while a device holds it
+ */
+long GPIOPinRead(unsigned long ulPort, unsigned char ucPins) {
+    if (ulPort == GPIOA1_BASE && (ucPins & SDA_BIT) && hostStuckClocks != 0) {
+        return ucPins & ~SDA_BIT;
+    }
+    return ucPins;
+}
+
+/*
+ * Each rising edge of SCL clocks a bit out of a device holding SDA, which
+ * lets go after hostStuckClocks of them
+ */
+void GPIOPinWrite(unsigned long ulPort, unsigned char ucPins, unsigned char ucVal) {
+    if (ulPort != GPIOA1_BASE || !(ucPins & SCL_BIT)) {
+        return;
+    }
+    if ((ucVal & SCL_BIT) && !sclHigh && hostStuckClocks > 0) {
+        hostStuckClocks--;
+    }
+    sclHigh = (ucVal & SCL_BIT) != 0;
+}
+
+void UtilsDelay(unsigned long ulCount) {
+    hostAdvance((uint64_t)ulCount * HOST_UTILS_DELAY_CYCLES);
+}
+
+uint32_t ClockP_getSystemTickPeriod(void) {
+    return HOST_TICK_US;
+}
+
+// ======== GPIO ========
+
+void GPIO_init(void) {
+}
+
+int_fast16_t GPIO_setConfig(uint_least8_t index, GPIO_PinConfig pinConfig) {
+    return 0;
+}
+
+void GPIO_setCallback(uint_least8_t index, GPIO_CallbackFxn callback) {
+    pins[index].callback = callback;
+}
+
+void GPIO_enableInt(uint_least8_t index) {
+    pins[index].enabled = true;
+}
+
+void GPIO_disableInt(uint_least8_t index) {
+    pins[index].enabled = false;
+}
+
+void GPIO_write(uint_least8_t index, unsigned int value) {
+    pins[index].value = value;
+}
+
+unsigned int GPIO_read(uint_least8_t index) {
+    return pins[index].value;
+}
+
+void hostGpioEdge(uint_least8_t index) {
+    if (pins[index].enabled && pins[index].callback != NULL) {
+        pins[index].callback(index);
+    }
+}
+
+// ======== UART ========
+
+void UART_init(void) {
+}
+
+void UART_Params_init(UART_Params *params) {
+    memset(params, 0, sizeof *params);
+    params->baudRate = 115200;
+}
+
+UART_Handle UART_open(uint_least8_t index, UART_Params *params) {
+    uartParams = *params;
+    return (UART_Handle)&handle;
+}
+
+static uint64_t uartCycles(size_t count) {
+    return count * UART_BITS_PER_BYTE * HOST_CYCLES_PER_SECOND / uartParams.baudRate;
+}
+
+static void writeDone(void *arg) {
+    uartParams.writeCallback((UART_Handle)&handle, arg, writeSize);
+}
+
+/*
+ * The bytes go out at the baud rate; in callback mode the callback runs
+ * when the last one has
+ */
+int_fast32_t UART_write(UART_Handle uart, const void *buffer, size_t size) {
+    const char *bytes = buffer;
+    size_t x;
+    for (x = 0; x < size; x++) {
+        if (bytes[x] == '\n' || bytes[x] == '\r') {
+            if (lineLength > 0) {
+                line[lineLength] = '\0';
+                if (hostEcho) {
+                    printf("%s\n", line);
+                }
+                hostUartLineSent = hostNow + uartCycles(x + 1);
+                if (hostUartLine != NULL) {
+                    hostUartLine(line);
+                }
+            }
+            lineLength = 0;
+        } else if (lineLength < LINE_LENGTH - 1) {
+            line[lineLength++] = bytes[x];
+        }
+    }
+    hostUartBytes += size;
+    if (uartParams.writeMode == UART_MODE_CALLBACK) {
+        writeSize = size;
+        hostSchedule(hostNow + uartCycles(size), writeDone, (void *)buffer);
+    } else {
+        hostAdvance(uartCycles(size));
+    }
+    return size;
+}
+
+int_fast32_t UART_read(UART_Handle uart, void *buffer, size_t size) {
+    readBuffer = buffer;
+    return 0;
+}
+
+/*
+ * The next input byte has arrived: hand it to a waiting read
+ */
+static void inputArrived(void *arg) {
+    char c = input[inputTail];
+    inputTail = (inputTail + 1) % INPUT_LENGTH;
+    if (readBuffer != NULL) {
+        void *buffer = readBuffer;
+        *(char *)buffer = c;
+        readBuffer = NULL;
+        uartParams.readCallback((UART_Handle)&handle, buffer, 1);
+    }
+}
+
+void hostUartInput(const char *text) {
+    if (inputFree < hostNow) {
+        inputFree = hostNow;
+    }
+    for (; *text != '\0'; text++) {
+        input[inputHead] = *text;
+        inputHead = (inputHead + 1) % INPUT_LENGTH;
+        inputFree += uartCycles(1);
+        hostSchedule(inputFree, inputArrived, NULL);
+    }
+}
+
+// ======== Timer ========
+
+void Timer_init(void) {
+}
+
+void Timer_Params_init(Timer_Params *params) {
+    memset(params, 0, sizeof *params);
+}
+
+Timer_Handle Timer_open(uint_least8_t index, Timer_Params *params) {
+    timerParams = *params;
+    return (Timer_Handle)&handle;
+}
+
+static void timerFired(void *arg) {
+    hostSchedule(hostNow + timerParams.period * HOST_CYCLES_PER_US, timerFired, NULL);
+    timerParams.timerCallback((Timer_Handle)&handle, 0);
+}
+
+int32_t Timer_start(Timer_Handle timer) {
+    hostSchedule(hostNow + timerParams.period * HOST_CYCLES_PER_US, timerFired, NULL);
+    return Timer_STATUS_SUCCESS;
+}
+
+// ======== PWM ========
+
+void PWM_init(void) {
+}
+
+void PWM_Params_init(PWM_Params *params) {
+    memset(params, 0, sizeof *params);
+}
+
+PWM_Handle PWM_open(uint_least8_t index, PWM_Params *params) {
+    hostPwmDuty = params->dutyValue;
+    pwmChecked = hostNow;
+    return (PWM_Handle)&handle;
+}
+
+void PWM_start(PWM_Handle pwm) {
+}
+
+uint64_t hostPwmOnCycles(void) {
+    pwmOn += (uint64_t)(((unsigned __int128)(hostNow - pwmChecked) * hostPwmDuty) >> 32);
+    pwmChecked = hostNow;
+    return pwmOn;
+}
+
+int_fast16_t PWM_setDuty(PWM_Handle pwm, uint32_t duty) {
+    hostPwmOnCycles();
+    if (duty != hostPwmDuty && hostPwmChanged != NULL) {
+        hostPwmChanged(duty);
+    }
+    hostPwmDuty = duty;
+    return 0;
+}
+
+// ======== SimpleLink file system ========
+
+/*
+ * Without a callback the start blocks until the network processor is up,
+ * with one it returns at once and sl_Task() calls it once it is
+ */
+int16_t sl_Start(const void *ifHdl, int8_t *devName, const P_INIT_CALLBACK initCallBack) {
+    if (nwpState != NWP_OFF) {
+        return -1;
+    }
+    nwpState = NWP_STARTING;
+    nwpChanged = hostNow;
+    hostNwpStarts++;
+    nwpStarted = initCallBack;
+    if (initCallBack == NULL) {
+        hostAdvance(SL_START_US * HOST_CYCLES_PER_US);
+        nwpState = NWP_UP;
+    }
+    return 0;
+}
+
+int16_t sl_Task(void *entry) {
+    if (nwpState == NWP_STARTING && hostNow - nwpChanged >= SL_START_US * HOST_CYCLES_PER_US) {
+        SlDeviceInitInfo_t info = {0, 0};
+        nwpState = NWP_UP;
+        nwpStarted(0, &info);
+    }
+    return 0;
+}
+
+int16_t sl_Stop(const uint16_t timeout) {
+    if (nwpState == NWP_OFF) {
+        return -1;
+    }
+    hostAdvance(SL_STOP_US * HOST_CYCLES_PER_US);
+    nwpOnCycles += hostNow - nwpChanged;
+    nwpState = NWP_OFF;
+    return 0;
+}
+
+uint64_t hostNwpOnCycles(void) {
+    return nwpOnCycles + (nwpState != NWP_OFF ? hostNow - nwpChanged : 0);
+}
+
+static int findFile(const char *name) {
+    int x;
+    for (x = 0; x < numberOfFiles; x++) {
+        if (strcmp(files[x].name, name) == 0) {
+            return x;
+        }
+    }
+    return -1;
+}
+
+/*
+ * The handle is the file's index. Writes go to its copy, which the close
+ * commits, as for a failsafe file.
+ */
+static int32_t openFile(const char *name, uint32_t accessModeAndMaxSize) {
+    int x = findFile(name);
+    uint32_t mode = accessModeAndMaxSize & (0x7U << SL_FS_OPEN_MODE_BIT);
+    if (mode == SL_FS_READ) {
+        return x < 0 || files[x].size == 0 ? SL_ERROR_FS_FILE_NOT_EXISTS : x;
+    }
+    if (x < 0) {
+        if (!(mode & SL_FS_CREATE) || numberOfFiles == MAX_FILES) {
+            return SL_ERROR_FS_FILE_NOT_EXISTS;
+        }
+        x = numberOfFiles++;
+        snprintf(files[x].name, sizeof files[x].name, "%s", name);
+        files[x].maxSize = (accessModeAndMaxSize & SL_FS_OPEN_MAXSIZE_BIT_MASK) * 256;
+    }
+    files[x].writing = true;
+    files[x].copySize = 0;
+    return x;
+}
+
+int32_t sl_FsOpen(const uint8_t *fileName, const uint32_t accessModeAndMaxSize, uint32_t *token) {
+    if (nwpState != NWP_UP) {
+        return SL_RET_CODE_DEV_NOT_STARTED;
+    }
+    return openFile((const char *)fileName, accessModeAndMaxSize);
+}
+
+int16_t sl_FsClose(const int32_t fileHdl, const uint8_t *certificateFileName, const uint8_t *signature,
+                   const uint32_t signatureLen) {
+    if (fileHdl < 0 || fileHdl >= numberOfFiles) {
+        return -1;
+    }
+    if (files[fileHdl].writing && !(signature != NULL && signature[0] == 'A')) {
+        memcpy(files[fileHdl].data, files[fileHdl].copy, files[fileHdl].copySize);
+        files[fileHdl].size = files[fileHdl].copySize;
+        if (hostFileCommit != NULL) {
+            hostFileCommit(SL_COMMIT_US * HOST_CYCLES_PER_US);
+        }
+        hostAdvance(SL_COMMIT_US * HOST_CYCLES_PER_US);
+        hostFileCommits++;
+    }
+    files[fileHdl].writing = false;
+    return 0;
+}
+
+int32_t sl_FsRead(const int32_t fileHdl, uint32_t offset, uint8_t *data, uint32_t len) {
+    if (fileHdl < 0 || fileHdl >= numberOfFiles || offset > files[fileHdl].size) {
+        return -1;
+    }
+    if (len > files[fileHdl].size - offset) {
+        len = files[fileHdl].size - offset;
+    }
+    memcpy(data, &files[fileHdl].data[offset], len);
+    return len;
+}
+
+int32_t sl_FsWrite(const int32_t fileHdl, uint32_t offset, uint8_t *data, uint32_t len) {
+    if (fileHdl < 0 || fileHdl >= numberOfFiles || !files[fileHdl].writing || hostFileFail) {
+        return -1;
+    }
+    if (offset + len > files[fileHdl].maxSize || offset + len > HOST_FILE_SIZE) {
+        return SL_ERROR_FS_FILE_MAX_SIZE_EXCEEDED;
+    }
+    memcpy(&files[fileHdl].copy[offset], data, len);
+    if (offset + len > files[fileHdl].copySize) {
+        files[fileHdl].copySize = offset + len;
+    }
+    return len;
+}
+
+size_t hostFileRead(const char *name, void *data, size_t size) {
+    int x = findFile(name);
+    if (x < 0) {
+        return 0;
+    }
+    size = size < files[x].size ? size : files[x].size;
+    memcpy(data, files[x].data, size);
+    return size;
+}
+
+void hostFileWrite(const char *name, const void *data, size_t size) {
+    int32_t file = openFile(name, SL_FS_OVERWRITE | SL_FS_CREATE_MAX_SIZE(HOST_FILE_SIZE));
+    if (file >= 0) {
+        sl_FsWrite(file, 0, (uint8_t *)data, size);
+        files[file].size = files[file].copySize;
+        memcpy(files[file].data, files[file].copy, files[file].size);
+        files[file].writing = false;
+    }
+}
+
+void Board_init(void) {
+}
@@ -0,0 +1,175 @@
+/*
+ *  ======== host.h ========
+ */
+
+// Problem Description:
+//
+// The thermostat only ever ran on a LaunchPad, so a fault such as a
+// sensor holding the I2C bus, or a claim such as "the heater follows a
+// button in under a millisecond", could only be checked by hand on a
+// board, and nothing checked it again after the next change.
+
+// Solution:
+//
+// Host stand-ins for the CC3220S drivers and the devices on its I2C bus.
+// A program in tools/ includes this file and then ../project/gpiointerrupt.h,
+// and links the firmware's units in ../project, so it runs the real
+// firmware, built with HOST_BUILD, against host.c and sensors.c instead of
+// the SimpleLink SDK. Time is simulated: hostNow
+// counts CPU cycles and only moves on in the drivers (a transfer takes
+// its bytes at the bus speed, a timeout takes its ticks, the UART takes
+// its baud rate) and in hostAdvance(), which runs the timer, UART and
+// sensor interrupts that fall due on the way. The firmware's own code
+// takes no simulated time; benchmarks of it use the host clock.
+
+#ifndef host_h
+#define host_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_CYCLES_PER_US 80ULL    // CPU_FREQUENCY of the firmware
+#define HOST_CYCLES_PER_MS 80000ULL
+#define HOST_CYCLES_PER_SECOND 80000000ULL
+#define HOST_TICK_US 1000           // ClockP tick of the NoRTOS default configuration
+#define HOST_UTILS_DELAY_CYCLES 3   // cycles per UtilsDelay() loop
+
+// Cortex-M4 debug registers; the cycle counter counts the simulated clock
+extern uint32_t hostDemcr;
+extern uint32_t hostDwtCtrl;
+volatile uint32_t *hostCycleCounter(void);
+#define DEMCR hostDemcr
+#define DWT_CTRL hostDwtCtrl
+#define DWT_CYCCNT (*hostCycleCounter())
+
+// Simulated clock
+extern uint64_t hostNow;                // CPU cycles since power on
+extern void (*hostCounterRead)(void);   // called on every DWT_CYCCNT read, to preempt a reader
+void hostAdvance(uint64_t cycles);
+void hostSchedule(uint64_t when, void (*fire)(void *arg), void *arg);
+
+// The firmware's task loop
+extern uint64_t hostLongestPass;        // cycles of the longest runTasks()
+void hostBoot(void);
+void hostRun(uint64_t cycles);
+
+// I2C bus. A device answers transfers to its address while the bus runs
+// no faster than maxSpeed; transfer() returns false to NACK.
+struct host_device {
+    uint8_t address;
+    uint16_t maxSpeed;                  // Kbps
+    bool (*transfer)(struct host_device *device, const uint8_t *write, size_t writeCount,
+                     uint8_t *read, size_t readCount);
+    struct host_device *next;
+};
+extern uint16_t hostBusSpeed;           // Kbps the driver opened the bus at
+extern int hostNacks;                   // transfers still to be NACKed
+extern int hostStuckClocks;             // SCL clocks before SDA is let go, 0 not stuck, -1 never
+extern uint32_t hostTransfers;
+extern uint64_t hostBusCycles;          // time the transfers held the bus
+void hostAttach(struct host_device *device);
+void hostDetach(struct host_device *device);
+uint64_t hostTransferCycles(size_t writeCount, size_t readCount);
+
+// GPIO
+void hostGpioEdge(uint_least8_t index);
+
+// UART: every line the firmware sends goes to hostUartLine without its
+// end as the write that holds it starts, and the other end's bytes arrive
+// at the baud rate
+extern void (*hostUartLine)(const char *line);
+extern uint64_t hostUartLineSent;       // hostNow the last byte of that line goes out
+extern bool hostEcho;                   // print the lines as well
+extern uint64_t hostUartBytes;
+void hostUartInput(const char *text);
+
+// PWM
+extern uint32_t hostPwmDuty;            // PWM_DUTY_FRACTION
+extern void (*hostPwmChanged)(uint32_t duty);  // called when the duty changes
+uint64_t hostPwmOnCycles(void);         // on time so far, weighted by the duty
+
+// SimpleLink network processor and file system: files live in RAM for the
+// life of the process, and the file system only answers while the network
+// processor is up.
+// A boot is warm if a harness gives it the file a cold boot in another
+// process saved, through hostFileRead() and hostFileWrite().
+#define HOST_FILE_SIZE 256
+extern uint32_t hostFileCommits;        // closes that committed a write
+extern bool hostFileFail;               // writes fail, as on a full file system
+extern void (*hostFileCommit)(uint64_t cycles);  // called as a close starts a commit that takes cycles
+extern uint32_t hostNwpStarts;          // sl_Start() calls
+uint64_t hostNwpOnCycles(void);         // time the network processor has been on so far
+size_t hostFileRead(const char *name, void *data, size_t size);
+void hostFileWrite(const char *name, const void *data, size_t size);
+
+// Sensors, in sensors.c. hostTemperature is the true temperature the
+// sensors convert, in degrees C.
+extern double hostTemperature;
+extern double hostNoise;                // degrees either way the readings scatter by
+#define HOST_TMP102_CONVERSION_MS 26    // TMP102 conversion time, typical
+struct host_tmp102 {
+    struct host_device device;
+    uint16_t config;
+    uint8_t pointer;
+    int16_t result;                     // in the 1/128 degree units the firmware reads
+    uint64_t converted;                 // hostNow the result was converted at
+    uint64_t ready;                     // hostNow a one-shot conversion finishes at
+    uint64_t phase;                     // hostNow continuous conversion started at
+    uint32_t conversions;
+    uint32_t reads;                     // of the result register
+    uint32_t early;                     // reads while a one-shot conversion was still running
+    uint64_t ageSum;                    // age of the result at the reads
+    uint64_t ageMax;
+};
+void hostAttachTmp102(struct host_tmp102 *sensor, uint8_t address);
+
+// TMP116 in continuous conversion. ALERT follows the limit flags as the
+// firmware configures it (alert mode, active low); it falls on the GPIO
+// pin given unless broken is set, and reading the configuration register
+// releases it.
+struct host_tmp116 {
+    struct host_device device;
+    uint8_t pin;
+    bool broken;                        // ALERT is not wired
+    uint16_t config;
+    uint16_t high;
+    uint16_t low;
+    uint8_t pointer;
+    int16_t result;
+    uint16_t flags;                     // HIGH_Alert, LOW_Alert and Data_Ready
+    bool alertLow;                      // the state of the ALERT line
+    uint32_t conversions;
+    uint32_t alerts;                    // falling edges of ALERT
+};
+void hostAttachTmp116(struct host_tmp116 *sensor, uint8_t address, uint8_t pin);
+
+// BMA222E sampling X, Y and Z into its 32 frame FIFO in stream mode at
+// 15.63 samples a second. Frame n is trace[n % length], in 8 bit counts.
+#define HOST_BMA222E_FIFO_DEPTH 32
+struct host_bma222e {
+    struct host_device device;
+    const int8_t (*trace)[3];
+    size_t length;
+    uint64_t start;                     // hostNow of frame 0
+    uint64_t produced;                  // frames sampled so far
+    int8_t fifo[HOST_BMA222E_FIFO_DEPTH][3];
+    int head;
+    int count;
+    bool overrun;
+    uint8_t pointer;
+    uint8_t registers[0x40];
+    uint32_t overruns;                  // frames pushed out before they were read
+    uint32_t bursts;                    // FIFO reads
+    uint32_t framesRead;
+    uint64_t burstCycles;               // longest FIFO read on the bus
+};
+void hostAttachBma222e(struct host_bma222e *accel, uint8_t address, const int8_t (*trace)[3], size_t length);
+
+// Checks: HOST_CHECK() counts a failure and says where it was
+extern int hostFailures;
+#define HOST_CHECK(condition) hostCheck((condition), #condition, __FILE__, __LINE__)
+void hostCheck(bool ok, const char *what, const char *file, int line);
+double hostSeconds(void);               // host clock, for benchmarks
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ *  ======== sensors.c ========
+ *  Models of the devices on the thermostat's I2C bus, see host.h
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "host.h"
+
+#define TMP102_RESULT_REG 0x00
+#define TMP102_CONFIG_REG 0x01
+#define TMP102_SHUTDOWN 0x0100
+#define TMP102_ONE_SHOT 0x8000
+#define TMP102_PERIOD_MS 250        // continuous conversion at the default 4Hz
+#define TMP102_SPEED 3400U
+#define TMP102_REGISTERS 4
+
+#define TMP116_RESULT_REG 0x00
+#define TMP116_CONFIG_REG 0x01
+#define TMP116_HIGH_LIMIT_REG 0x02
+#define TMP116_LOW_LIMIT_REG 0x03
+#define TMP116_REGISTERS 4
+#define TMP116_HIGH_ALERT 0x8000
+#define TMP116_LOW_ALERT 0x4000
+#define TMP116_DATA_READY 0x2000
+#define TMP116_FLAGS 0xE000
+#define TMP116_THERM_MODE 0x0010
+#define TMP116_POWER_UP 0x8000      // result register before the first conversion, -256C
+#define TMP116_SPEED 400U
+
+#define BMA222E_CHIP_ID_REG 0x00
+#define BMA222E_CHIP_ID 0xF8
+#define BMA222E_FIFO_STATUS_REG 0x0E
+#define BMA222E_FIFO_DATA_REG 0x3F
+#define BMA222E_FRAME_BYTES 6
+#define BMA222E_RATE_NUMERATOR 125  // 15.625 samples a second
+#define BMA222E_RATE_DENOMINATOR 8
+#define BMA222E_SPEED 400U
+
+double hostTemperature = 20.0;
+double hostNoise = 0.0;
+
+/*
+ * The true temperature as a result register code, 1/128 degree a bit,
+ * with up to hostNoise either way
+ */
+static int16_t temperatureCode(void) {
+    static uint32_t random = 1;
+    random = random * 1103515245 + 12345;
+    return (int16_t)lround((hostTemperature + hostNoise * ((random >> 8) / 8388608.0 - 1)) * 128);
+}
+
+/*
+ * Bring the result register up to hostNow: a one-shot conversion that
+ * has finished, or the last continuous conversion
+ */
+static void convertTmp102(struct host_tmp102 *sensor) {
+    if (sensor->ready != 0 && hostNow >= sensor->ready) {
+        sensor->result = temperatureCode();
+        sensor->converted = sensor->ready;
+        sensor->ready = 0;
+        sensor->conversions++;
+    } else if (!(sensor->config & TMP102_SHUTDOWN)) {
+        uint64_t period = TMP102_PERIOD_MS * HOST_CYCLES_PER_MS;
+        uint64_t last = hostNow - (hostNow - sensor->phase) % period;
+        if (last > sensor->converted) {
+            sensor->result = temperatureCode();
+            sensor->conversions += (last - sensor->converted + period - 1) / period;
+            sensor->converted = last;
+        }
+    }
+}
+
+/*
+ * A write sets the pointer and, with two more bytes, the register it
+ * points at; a read returns that register, MSB first
+ */
+static bool transferTmp102(struct host_device *device, const uint8_t *write, size_t writeCount,
+                           uint8_t *read, size_t readCount) {
+    struct host_tmp102 *sensor = (struct host_tmp102 *)device;
+    uint16_t value = 0;
+    size_t x;
+
+    convertTmp102(sensor);
+    if (writeCount > 0) {
+        if (write[0] >= TMP102_REGISTERS) {
+            return false;
+        }
+        sensor->pointer = write[0];
+    }
+    if (writeCount == 3 && sensor->pointer == TMP102_CONFIG_REG) {
+        uint16_t config = (write[1] << 8) | write[2];
+        if ((sensor->config & TMP102_SHUTDOWN) && !(config & TMP102_SHUTDOWN)) {
+            sensor->phase = hostNow;
+        }
+        if ((config & TMP102_SHUTDOWN) && (config & TMP102_ONE_SHOT)) {
+            sensor->ready = hostNow + HOST_TMP102_CONVERSION_MS * HOST_CYCLES_PER_MS;
+        }
+        sensor->config = config & ~TMP102_ONE_SHOT;
+    }
+    if (sensor->pointer == TMP102_RESULT_REG) {
+        value = sensor->result;
+        if (readCount > 0) {
+            sensor->reads++;
+            sensor->early += sensor->ready != 0;
+            sensor->ageSum += hostNow - sensor->converted;
+            if (hostNow - sensor->converted > sensor->ageMax) {
+                sensor->ageMax = hostNow - sensor->converted;
+            }
+        }
+    } else if (sensor->pointer == TMP102_CONFIG_REG) {
+        // the one-shot bit reads 0 while a conversion is running
+        value = sensor->config | (sensor->ready == 0 ? TMP102_ONE_SHOT : 0);
+    }
+    for (x = 0; x < readCount; x++) {
+        read[x] = x == 0 ? value >> 8 : x == 1 ? value & 0xFF : 0;
+    }
+    return true;
+}
+
+void hostAttachTmp102(struct host_tmp102 *sensor, uint8_t address) {
+    memset(sensor, 0, sizeof *sensor);
+    sensor->device.address = address;
+    sensor->device.maxSpeed = TMP102_SPEED;
+    sensor->device.transfer = transferTmp102;
+    sensor->config = 0x60A0;
+    sensor->phase = hostNow;
+    sensor->converted = hostNow;
+    sensor->result = temperatureCode();
+    hostAttach(&sensor->device);
+}
+
+/*
+ * Time the averaging of the TMP116 configuration register takes, the AVG
+ * bits
+ */
+static uint64_t tmp116Active(uint16_t config) {
+    static const uint16_t averaging[4] = {16, 125, 500, 1000};
+    return averaging[(config >> 5) & 3] * HOST_CYCLES_PER_MS;
+}
+
+/*
+ * Conversion cycle of the TMP116 configuration register: the CONV bits,
+ * but never shorter than the averaging
+ */
+static uint64_t tmp116Cycle(uint16_t config) {
+    static const uint16_t cycles[8] = {16, 125, 250, 500, 1000, 4000, 8000, 16000};
+    uint64_t cycle = cycles[(config >> 7) & 7] * HOST_CYCLES_PER_MS;
+    return cycle > tmp116Active(config) ? cycle : tmp116Active(config);
+}
+
+/*
+ * Finish a conversion: the result, the limit flags in alert mode and
+ * ALERT, then start the next one
+ */
+static void convertTmp116(void *arg) {
+    struct host_tmp116 *sensor = arg;
+    sensor->result = temperatureCode();
+    sensor->flags |= TMP116_DATA_READY;
+    sensor->conversions++;
+    if (!(sensor->config & TMP116_THERM_MODE)) {
+        if (sensor->result > (int16_t)sensor->high) {
+            sensor->flags |= TMP116_HIGH_ALERT;
+        }
+        if (sensor->result < (int16_t)sensor->low) {
+            sensor->flags |= TMP116_LOW_ALERT;
+        }
+    }
+    if ((sensor->flags & (TMP116_HIGH_ALERT | TMP116_LOW_ALERT)) && !sensor->alertLow) {
+        sensor->alertLow = true;
+        sensor->alerts++;
+        if (!sensor->broken) {
+            hostGpioEdge(sensor->pin);
+        }
+    }
+    hostSchedule(hostNow + tmp116Cycle(sensor->config), convertTmp116, sensor);
+}
+
+static bool transferTmp116(struct host_device *device, const uint8_t *write, size_t writeCount,
+                           uint8_t *read, size_t readCount) {
+    struct host_tmp116 *sensor = (struct host_tmp116 *)device;
+    uint16_t value = 0;
+    size_t x;
+
+    if (writeCount > 0) {
+        if (write[0] >= TMP116_REGISTERS) {
+            return false;
+        }
+        sensor->pointer = write[0];
+    }
+    if (writeCount == 3) {
+        uint16_t written = (write[1] << 8) | write[2];
+        if (sensor->pointer == TMP116_CONFIG_REG) {
+            sensor->config = written & ~TMP116_FLAGS;
+        } else if (sensor->pointer == TMP116_HIGH_LIMIT_REG) {
+            sensor->high = written;
+        } else if (sensor->pointer == TMP116_LOW_LIMIT_REG) {
+            sensor->low = written;
+        }
+    }
+    if (readCount == 0) {
+        return true;
+    }
+    if (sensor->pointer == TMP116_RESULT_REG) {
+        value = sensor->result;
+        sensor->flags &= ~TMP116_DATA_READY;
+    } else if (sensor->pointer == TMP116_CONFIG_REG) {
+        // reading the flags clears them and lets ALERT go
+        value = sensor->config | sensor->flags;
+        sensor->flags = 0;
+        sensor->alertLow = false;
+    } else if (sensor->pointer == TMP116_HIGH_LIMIT_REG) {
+        value = sensor->high;
+    } else {
+        value = sensor->low;
+    }
+    for (x = 0; x < readCount; x++) {
+        read[x] = x == 0 ? value >> 8 : x == 1 ? value & 0xFF : 0;
+    }
+    return true;
+}
+
+void hostAttachTmp116(struct host_tmp116 *sensor, uint8_t address, uint8_t pin) {
+    memset(sensor, 0, sizeof *sensor);
+    sensor->device.address = address;
+    sensor->device.maxSpeed = TMP116_SPEED;
+    sensor->device.transfer = transferTmp116;
+    sensor->pin = pin;
+    sensor->config = 0x0220;
+    sensor->high = 0x6000;
+    sensor->low = 0x8000;
+    sensor->result = (int16_t)TMP116_POWER_UP;
+    hostAttach(&sensor->device);
+    hostSchedule(hostNow + tmp116Active(sensor->config), convertTmp116, sensor);
+}
+
+/*
+ * Sample the trace into the FIFO up to hostNow, pushing the oldest frame
+ * out when it is full
+ */
+static void sampleBma222e(struct host_bma222e *accel) {
+    uint64_t due = (hostNow - accel->start) * BMA222E_RATE_NUMERATOR
+        / (BMA222E_RATE_DENOMINATOR * HOST_CYCLES_PER_SECOND);
+    for (; accel->produced < due; accel->produced++) {
+        int slot = (accel->head + accel->count) % HOST_BMA222E_FIFO_DEPTH;
+        memcpy(accel->fifo[slot], accel->trace[accel->produced % accel->length], 3);
+        if (accel->count == HOST_BMA222E_FIFO_DEPTH) {
+            accel->head = (accel->head + 1) % HOST_BMA222E_FIFO_DEPTH;
+            accel->overrun = true;
+            accel->overruns++;
+        } else {
+            accel->count++;
+        }
+    }
+}
+
+/*
+ * Register reads and writes; a read of the FIFO data register takes
+ * frames out of the FIFO, each axis as an LSB and MSB pair with the 8 bit
+ * sample in the MSB
+ */
+static bool transferBma222e(struct host_device *device, const uint8_t *write, size_t writeCount,
+                            uint8_t *read, size_t readCount) {
+    struct host_bma222e *accel = (struct host_bma222e *)device;
+    size_t x;
+
+    sampleBma222e(accel);
+    if (writeCount > 0) {
+        accel->pointer = write[0] & 0x3F;
+    }
+    if (writeCount == 2) {
+        accel->registers[accel->pointer] = write[1];
+    }
+    if (readCount == 0) {
+        return true;
+    }
+    if (accel->pointer == BMA222E_FIFO_DATA_REG) {
+        uint64_t cycles = hostTransferCycles(writeCount, readCount);
+        if (cycles > accel->burstCycles) {
+            accel->burstCycles = cycles;
+        }
+        accel->bursts++;
+        memset(read, 0, readCount);
+        for (x = 0; x + BMA222E_FRAME_BYTES <= readCount && accel->count > 0; x += BMA222E_FRAME_BYTES) {
+            int axis;
+            for (axis = 0; axis < 3; axis++) {
+                read[x + axis * 2 + 1] = (uint8_t)accel->fifo[accel->head][axis];
+            }
+            accel->head = (accel->head + 1) % HOST_BMA222E_FIFO_DEPTH;
+            accel->count--;
+            accel->framesRead++;
+        }
+        accel->overrun = false;
+        return true;
+    }
+    for (x = 0; x < readCount; x++) {
+        uint8_t reg = (accel->pointer + x) & 0x3F;
+        if (reg == BMA222E_CHIP_ID_REG) {
+            read[x] = BMA222E_CHIP_ID;
+        } else if (reg == BMA222E_FIFO_STATUS_REG) {
+            read[x] = accel->count | (accel->overrun ? 0x80 : 0);
+        } else {
+            read[x] = accel->registers[reg];
+        }
+    }
+    return true;
+}
+
+void hostAttachBma222e(struct host_bma222e *accel, uint8_t address, const int8_t (*trace)[3], size_t length) {
+    memset(accel, 0, sizeof *accel);
+    accel->device.address = address;
+    accel->device.maxSpeed = BMA222E_SPEED;
+    accel->device.transfer = transferBma222e;
+    accel->trace = trace;
+    accel->length = length;
+    accel->start = hostNow;
+    hostAttach(&accel->device);
+}
@@ -0,0 +1,16 @@
+/*
+ *  ======== gpio.h ========
+ *  Host stand-in for the CC32xx driverlib GPIO functions the I2C bus
+ *  recovery uses
+ */
+#ifndef __DRIVERLIB_GPIO_H__
+#define __DRIVERLIB_GPIO_H__
+
+#define GPIO_DIR_MODE_IN    0x00000000
+#define GPIO_DIR_MODE_OUT   0x00000001
+
+void GPIODirModeSet(unsigned long ulPort, unsigned char ucPins, unsigned long ulPinIO);
+long GPIOPinRead(unsigned long ulPort, unsigned char ucPins);
+void GPIOPinWrite(unsigned long ulPort, unsigned char ucPins, unsigned char ucVal);
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ *  ======== i2c.h ========
+ *  Host stand-in for the CC32xx driverlib I2C functions the thermostat uses
+ */
+#ifndef __DRIVERLIB_I2C_H__
+#define __DRIVERLIB_I2C_H__
+
+void I2CMasterTimeoutSet(unsigned long ulBase, unsigned long ulValue);
+
+#endif
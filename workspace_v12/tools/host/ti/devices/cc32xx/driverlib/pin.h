@@ -0,0 +1,20 @@
+/*
+ *  ======== pin.h ========
+ *  Host stand-in for the CC32xx driverlib pin functions the I2C bus
+ *  recovery uses
+ */
+#ifndef __DRIVERLIB_PIN_H__
+#define __DRIVERLIB_PIN_H__
+
+#include <stdbool.h>
+
+#define PIN_01              0x00000000
+#define PIN_02              0x00000001
+#define PIN_MODE_0          0x00000000
+#define PIN_STRENGTH_2MA    0x00000020
+#define PIN_TYPE_OD_PU      0x00000310
+
+void PinTypeGPIO(unsigned long ulPin, unsigned long ulPinMode, bool bOpenDrain);
+void PinConfigSet(unsigned long ulPin, unsigned long ulPinStrength, unsigned long ulPinType);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ *  ======== prcm.h ========
+ *  Host stand-in for the CC32xx driverlib clock functions the I2C bus
+ *  recovery uses
+ */
+#ifndef __DRIVERLIB_PRCM_H__
+#define __DRIVERLIB_PRCM_H__
+
+#define PRCM_RUN_MODE_CLK   0x00000001
+#define PRCM_GPIOA1         0x00000005
+
+void PRCMPeripheralClkEnable(unsigned long ulPeripheral, unsigned long ulClkFlags);
+
+#endif
@@ -0,0 +1,10 @@
+/*
+ *  ======== utils.h ========
+ *  Host stand-in for the CC32xx driverlib delay loop
+ */
+#ifndef __DRIVERLIB_UTILS_H__
+#define __DRIVERLIB_UTILS_H__
+
+void UtilsDelay(unsigned long ulCount);
+
+#endif
@@ -0,0 +1,12 @@
+/*
+ *  ======== hw_memmap.h ========
+ *  Host stand-in for the CC32xx driverlib header, the base addresses only
+ *  name the peripheral to the stand-ins in host.c
+ */
+#ifndef __HW_MEMMAP_H__
+#define __HW_MEMMAP_H__
+
+#define GPIOA1_BASE     0x40005000
+#define I2CA0_BASE      0x40020000
+
+#endif
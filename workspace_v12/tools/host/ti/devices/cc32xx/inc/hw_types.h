@@ -0,0 +1,11 @@
+/*
+ *  ======== hw_types.h ========
+ *  Host stand-in for the CC32xx driverlib header
+ */
+#ifndef __HW_TYPES_H__
+#define __HW_TYPES_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ *  ======== GPIO.h ========
+ *  Host stand-in for the SimpleLink GPIO driver, only what the thermostat
+ *  uses. host.c keeps the pins and runs the callbacks.
+ */
+#ifndef ti_drivers_GPIO__include
+#define ti_drivers_GPIO__include
+
+#include <stdint.h>
+
+typedef uint32_t GPIO_PinConfig;
+typedef void (*GPIO_CallbackFxn)(uint_least8_t index);
+
+#define GPIO_CFG_OUT_STD        0x00000000
+#define GPIO_CFG_IN_PU          0x00010000
+#define GPIO_CFG_IN_INT_FALLING 0x00020000
+
+void GPIO_init(void);
+int_fast16_t GPIO_setConfig(uint_least8_t index, GPIO_PinConfig pinConfig);
+void GPIO_setCallback(uint_least8_t index, GPIO_CallbackFxn callback);
+void GPIO_enableInt(uint_least8_t index);
+void GPIO_disableInt(uint_least8_t index);
+void GPIO_write(uint_least8_t index, unsigned int value);
+unsigned int GPIO_read(uint_least8_t index);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ *  ======== I2C.h ========
+ *  Host stand-in for the SimpleLink I2C driver, only what the thermostat
+ *  uses. host.c runs the transfers against the simulated bus.
+ */
+#ifndef ti_drivers_I2C__include
+#define ti_drivers_I2C__include
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct I2C_Config_ *I2C_Handle;
+
+typedef enum {
+    I2C_100kHz = 0,
+    I2C_400kHz = 1,
+    I2C_1000kHz = 2,
+    I2C_3330kHz = 3,
+    I2C_3400kHz = 3
+} I2C_BitRate;
+
+typedef enum {
+    I2C_MODE_BLOCKING,
+    I2C_MODE_CALLBACK
+} I2C_TransferMode;
+
+typedef struct {
+    void *writeBuf;
+    size_t writeCount;
+    void *readBuf;
+    size_t readCount;
+    uint_least8_t slaveAddress;
+    void *arg;
+    volatile int_fast16_t status;
+    void *nextPtr;
+} I2C_Transaction;
+
+typedef struct {
+    I2C_TransferMode transferMode;
+    void *transferCallbackFxn;
+    I2C_BitRate bitRate;
+    void *custom;
+} I2C_Params;
+
+#define I2C_STATUS_SUCCESS          0
+#define I2C_STATUS_ERROR            (-1)
+#define I2C_STATUS_CLOCK_TIMEOUT    (-4)
+#define I2C_STATUS_ADDR_NACK        (-5)
+#define I2C_STATUS_TIMEOUT          (-7)
+
+void I2C_init(void);
+void I2C_Params_init(I2C_Params *params);
+I2C_Handle I2C_open(uint_least8_t index, I2C_Params *params);
+void I2C_close(I2C_Handle handle);
+int_fast16_t I2C_transferTimeout(I2C_Handle handle, I2C_Transaction *transaction, uint32_t timeout);
+
+#endif
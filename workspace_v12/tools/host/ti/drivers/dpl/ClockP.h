@@ -0,0 +1,13 @@
+/*
+ *  ======== ClockP.h ========
+ *  Host stand-in for the driver porting layer clock, only what the
+ *  thermostat uses
+ */
+#ifndef ti_dpl_ClockP__include
+#define ti_dpl_ClockP__include
+
+#include <stdint.h>
+
+uint32_t ClockP_getSystemTickPeriod(void);
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *  ======== simplelink.h ========
+ *  Host stand-in for the SimpleLink Wi-Fi host driver, only starting and
+ *  stopping the network processor, the file system the thermostat uses
+ *  and the event handler types. host.c keeps the files in RAM.
+ */
+#ifndef __SIMPLELINK_H__
+#define __SIMPLELINK_H__
+
+#include <stdint.h>
+
+#define SL_FS_OPEN_MODE_BIT             29
+#define SL_FS_OPEN_FLAGS_BIT            16
+#define SL_FS_OPEN_MAXSIZE_BIT_MASK     0xFFFF
+
+#define SL_FS_READ                      ((uint32_t)0x0 << SL_FS_OPEN_MODE_BIT)
+#define SL_FS_WRITE                     ((uint32_t)0x1 << SL_FS_OPEN_MODE_BIT)
+#define SL_FS_CREATE                    ((uint32_t)0x2 << SL_FS_OPEN_MODE_BIT)
+#define SL_FS_OVERWRITE                 (SL_FS_CREATE | SL_FS_WRITE)
+#define SL_FS_CREATE_FAILSAFE           ((uint32_t)0x1 << SL_FS_OPEN_FLAGS_BIT)
+#define SL_FS_CREATE_MAX_SIZE(size)     ((((uint32_t)(size) + 255) / 256) & SL_FS_OPEN_MAXSIZE_BIT_MASK)
+
+#define SL_RET_CODE_DEV_NOT_STARTED     (-2018)
+#define SL_ERROR_FS_FILE_NOT_EXISTS     (-11669)
+#define SL_ERROR_FS_FILE_MAX_SIZE_EXCEEDED (-10282)
+
+typedef struct SlWlanEvent_ SlWlanEvent_t;
+typedef struct SlNetAppEvent_ SlNetAppEvent_t;
+typedef struct SlNetAppHttpServerEvent_ SlNetAppHttpServerEvent_t;
+typedef struct SlNetAppHttpServerResponse_ SlNetAppHttpServerResponse_t;
+typedef struct SlDeviceEvent_ SlDeviceEvent_t;
+typedef struct SlSockEvent_ SlSockEvent_t;
+typedef struct SlDeviceFatal_ SlDeviceFatal_t;
+typedef struct SlNetAppRequest_ SlNetAppRequest_t;
+typedef struct SlNetAppResponse_ SlNetAppResponse_t;
+
+typedef struct {
+    uint32_t ChipId;
+    uint32_t MoreData;
+} SlDeviceInitInfo_t;
+
+typedef void (*P_INIT_CALLBACK)(uint32_t status, SlDeviceInitInfo_t *deviceInitInfo);
+
+int16_t sl_Start(const void *ifHdl, int8_t *devName, const P_INIT_CALLBACK initCallBack);
+int16_t sl_Stop(const uint16_t timeout);
+int16_t sl_Task(void *entry);
+int32_t sl_FsOpen(const uint8_t *fileName, const uint32_t accessModeAndMaxSize, uint32_t *token);
+int16_t sl_FsClose(const int32_t fileHdl, const uint8_t *certificateFileName, const uint8_t *signature,
+                   const uint32_t signatureLen);
+int32_t sl_FsRead(const int32_t fileHdl, uint32_t offset, uint8_t *data, uint32_t len);
+int32_t sl_FsWrite(const int32_t fileHdl, uint32_t offset, uint8_t *data, uint32_t len);
+
+#endif
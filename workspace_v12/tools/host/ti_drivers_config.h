@@ -0,0 +1,31 @@
+/*
+ *  ======== ti_drivers_config.h ========
+ *  Host stand-in for the file SysConfig generates from
+ *  gpiointerrupt.syscfg: the same instance names and bus devices, the
+ *  numbers only index the stand-ins in host.c
+ */
+#ifndef ti_drivers_config_h
+#define ti_drivers_config_h
+
+#include <stdint.h>
+
+#define CONFIG_GPIO_BUTTON_0            0
+#define CONFIG_GPIO_BUTTON_1            1
+#define CONFIG_GPIO_TMP_ALERT           2
+#define CONFIG_TI_DRIVERS_GPIO_COUNT    3
+
+#define CONFIG_I2C_0                    0
+
+/* ---- CONFIG_I2C_0 I2C bus components ---- */
+#define CONFIG_I2C_0_BMA222E_ADDR       (0x18)
+#define CONFIG_I2C_0_BMA222E_MAXSPEED   (400U)  /* Kbps */
+#define CONFIG_I2C_0_TMP006_ADDR        (0x41)
+#define CONFIG_I2C_0_TMP006_MAXSPEED    (3400U) /* Kbps */
+
+#define CONFIG_PWM_0                    0
+#define CONFIG_TIMER_0                  0
+#define CONFIG_UART_0                   0
+
+void Board_init(void);
+
+#endif
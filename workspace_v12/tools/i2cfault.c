@@ -0,0 +1,157 @@
+/*
+ *  ======== i2cfault.c ========
+ */
+
+// Problem Description:
+//
+// readTemp() and serviceI2C() retry a failed transfer and recover the bus
+// in between, and the tasks behind serviceI2C in the pass wait for all of
+// it. A sensor that NACKs or holds SDA low must neither stall the pass for
+// longer than the retries allow nor leave the heater on a stale reading.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 at 0x48. Each
+// scenario injects a fault on the bus: NACKs, SDA held until the recovery
+// clocks it free, SDA held until it is healed, and the sensor gone. It then
+// checks that no serviceI2C() and no pass took longer than I2C_ATTEMPTS
+// timed out transfers plus the bus recoveries between them, that the last
+// good temperature is kept, that the heat goes off once the reading is
+// MAX_TEMP_AGE samples old and that readings resume once the fault clears.
+//
+// Build:   make -C tools i2cfault
+// Usage:   i2cfault
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define SERVICE_I2C_TASK (NUMBER_OF_TASKS - 1)
+#define LONGEST_REQUEST 5           // bytes written and read by the largest request
+
+static struct host_tmp102 tmp102;
+
+/*
+ * Cycles serviceI2C() may take for one request that never gets through:
+ * every attempt waits out its transfer timeout, in whole ClockP ticks as
+ * transferI2C() asks for them, and recovers the bus
+ */
+static uint64_t stallBound(void) {
+    uint64_t timeout = I2C_TIMEOUT_US + (LONGEST_REQUEST + 1) * 9 * 1000 / busSpeed;
+    uint64_t transfer = (timeout / HOST_TICK_US + 1) * HOST_TICK_US * HOST_CYCLES_PER_US;
+    uint64_t recovery = (2 * I2C_RECOVERY_CLOCKS + 3) * I2C_HALF_CLOCK_DELAY * HOST_UTILS_DELAY_CYCLES;
+    return I2C_ATTEMPTS * (transfer + recovery);
+}
+
+/*
+ * Start a scenario: forget the longest stall so far
+ */
+static void begin(void) {
+    tasks[SERVICE_I2C_TASK].max_cycles = 0;
+    hostLongestPass = 0;
+}
+
+/*
+ * Check the stalls of the scenario against the bound and report them
+ */
+static void end(const char *name) {
+    uint64_t bound = stallBound();
+    HOST_CHECK(tasks[SERVICE_I2C_TASK].max_cycles <= bound);
+    HOST_CHECK(hostLongestPass <= bound);
+    printf("%-24s serviceI2C %6.3f ms, pass %6.3f ms, bound %6.3f ms\n", name,
+           tasks[SERVICE_I2C_TASK].max_cycles / (double)HOST_CYCLES_PER_MS,
+           hostLongestPass / (double)HOST_CYCLES_PER_MS, bound / (double)HOST_CYCLES_PER_MS);
+}
+
+/*
+ * The reading has come back: fresh, healthy and at hostTemperature
+ */
+static void checkResumed(void) {
+    HOST_CHECK(tempAge == 0);
+    HOST_CHECK(health == 0);
+    HOST_CHECK(temperature == (int)hostTemperature);
+}
+
+/*
+ * The reading is stale: the last good temperature is kept and the heat is off
+ */
+static void checkStale(int lastGood) {
+    HOST_CHECK(tempAge == MAX_TEMP_AGE);
+    HOST_CHECK(health & HEALTH_STALE);
+    HOST_CHECK(temperature == lastGood);
+    HOST_CHECK(zoneDuty[0] == 0);
+    HOST_CHECK(hostPwmDuty == 0);
+}
+
+int main(void) {
+    int errors;
+
+    hostTemperature = 20.0;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostBoot();
+    // past the first save, whose file commit would be the longest pass
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(storeWrites == 1);
+    HOST_CHECK(sensor == TMP102_SENSOR);
+    HOST_CHECK(tempOneShot);
+    HOST_CHECK(busSpeed == I2C_CONTROLLER_MAXSPEED);
+    checkResumed();
+    HOST_CHECK(zoneDuty[0] > 0);
+
+    // one NACK: the second attempt gets through and no sample is lost
+    begin();
+    hostNacks = 1;
+    hostRun(2 * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(hostNacks == 0);
+    checkResumed();
+    end("single NACK");
+
+    // both attempts of several transfers NACKed: samples are missed and
+    // backed off, then read again
+    begin();
+    hostNacks = 8;
+    hostRun(10 * HOST_CYCLES_PER_SECOND);
+    checkResumed();
+    end("NACK burst");
+
+    // SDA held until the recovery has clocked it three times
+    begin();
+    errors = i2cErrors;
+    hostStuckClocks = 3;
+    hostRun(2 * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(hostStuckClocks == 0);
+    HOST_CHECK(i2cErrors > errors);
+    checkResumed();
+    end("SDA freed by recovery");
+
+    // SDA held for good: the reading goes stale and the heat off, and
+    // comes back at the new temperature once the bus is healed
+    begin();
+    hostStuckClocks = -1;
+    hostTemperature = 22.0;
+    hostRun(30 * HOST_CYCLES_PER_SECOND);
+    checkStale(20);
+    end("SDA stuck");
+    begin();
+    hostStuckClocks = 0;
+    hostRun(10 * HOST_CYCLES_PER_SECOND);
+    checkResumed();
+    HOST_CHECK(zoneDuty[0] > 0);
+    end("SDA healed");
+
+    // the sensor stops answering altogether, then comes back
+    begin();
+    hostDetach(&tmp102.device);
+    hostTemperature = 21.0;
+    hostRun(30 * HOST_CYCLES_PER_SECOND);
+    checkStale(22);
+    end("sensor gone");
+    begin();
+    hostAttach(&tmp102.device);
+    hostRun(10 * HOST_CYCLES_PER_SECOND);
+    checkResumed();
+    end("sensor back");
+
+    printf("%s\n", hostFailures == 0 ? "all I2C fault checks hold" : "I2C fault checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
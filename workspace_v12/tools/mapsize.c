@@ -0,0 +1,550 @@
+/*
+ *  ======== mapsize.c ========
+ */
+
+// Problem Description:
+//
+// cc32xxs_nortos.cmd reserves a 4KB stack and a 32KB heap and nobody knew
+// how much of either the thermostat needs, or which symbols take up the
+// rest of the SRAM. The linker map has the answer but it is 1200 lines.
+
+// Solution:
+//
+// The tool reads the SECTION ALLOCATION MAP of a TI linker map and lists
+// every input section with the symbol it holds (the compiler puts each
+// function and variable in its own subsection), split into what lives
+// only in RAM (.bss, .data and the .common variables) and what is part of
+// the image the boot loader copies out of the serial flash (.text, .const
+// and .cinit). Given a UART capture it also picks out the <K,stackUsed,
+// stackSize,heapUsed,heapSize> lines the firmware prints and sets the
+// deepest stack and heap use seen against the reservations.
+//
+// The image is also what the boot loader copies into the SRAM before
+// main, so the tool can add up the symbols per object file, to see what
+// pulls in the code (printf, the soft float library, the driver tables),
+// and estimate the copy time from the image size and the serial flash
+// clock. To measure a change it writes the symbols to a baseline file and
+// on a later build lists every symbol and object that grew, shrank, came
+// or went since.
+//
+// Build:   make -C tools
+// Usage:   mapsize [-n count] [-l uart.log] [-o] [-k kHz] [-w baseline]
+//                  [-b baseline] project.map
+// count is how many of the largest symbols to list in each table
+// (default 20, 0 for all). -o adds the table per object file, -k sets the
+// serial flash clock for the load time (default 20000). -w writes the
+// baseline and -b prints the changes against one instead of the tables.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_SECTIONS 64
+#define MAX_SYMBOLS 4096
+#define NAME_LENGTH 64
+#define LINE_LENGTH 512
+#define DEFAULT_COUNT 20
+#define RESERVE_MARGIN 25           // percent kept above the deepest use seen
+#define FLASH_KHZ 20000             // serial flash clock of the boot loader
+#define FLASH_LINES 1               // data lines the boot loader reads with
+
+struct section_info {
+    char name[NAME_LENGTH];
+    unsigned long origin;
+    unsigned long length;
+    int ram;                // not in the image: uninitialized or NOLOAD
+};
+
+struct symbol_info {
+    char name[NAME_LENGTH];         // function or variable, or the object for a whole section
+    char object[2 * NAME_LENGTH];   // library: object, or the object alone
+    char input[NAME_LENGTH];        // input section without the symbol, e.g. .text
+    unsigned long size;
+    int section;                    // index in sections[]
+};
+
+struct section_info sections[MAX_SECTIONS];
+int number_of_sections = 0;
+struct symbol_info symbols[MAX_SYMBOLS];
+int number_of_symbols = 0;
+struct symbol_info baseline[MAX_SYMBOLS];
+int number_of_baseline = 0;
+unsigned long stack_used = 0, stack_size = 0, heap_used = 0, heap_size = 0;
+int measured = FALSE;
+
+/*
+ * Copy at most NAME_LENGTH - 1 characters of the count at from into to,
+ * without the spaces around them
+ */
+void copyTrimmed(char *to, const char *from, int count) {
+    while (count > 0 && isspace((unsigned char)*from)) {
+        from++;
+        count--;
+    }
+    while (count > 0 && isspace((unsigned char)from[count - 1])) {
+        count--;
+    }
+    if (count > NAME_LENGTH - 1) {
+        count = NAME_LENGTH - 1;
+    }
+    memcpy(to, from, count);
+    to[count] = '\0';
+}
+
+/*
+ * Start an output section from the part of its line after the name:
+ * page, origin, length and the attributes
+ */
+void addSection(const char *name, const char *rest) {
+    struct section_info *section;
+    int page;
+    if (number_of_sections == MAX_SECTIONS) {
+        return;
+    }
+    section = &sections[number_of_sections];
+    if (sscanf(rest, "%d %lx %lx", &page, &section->origin, &section->length) != 3) {
+        return;
+    }
+    copyTrimmed(section->name, name, strlen(name));
+    section->ram = strstr(rest, "UNINITIALIZED") != NULL || strstr(rest, "NOLOAD") != NULL
+                   || strstr(rest, "COPY") != NULL;
+    number_of_sections++;
+}
+
+/*
+ * Add an input section line of the current output section. lib is the
+ * library of the line before, which a line starting with ':' is from too.
+ */
+void addSymbol(const char *line, char *lib) {
+    struct symbol_info *symbol;
+    unsigned long address, size;
+    int used = 0;
+    const char *rest, *open, *close, *colon;
+    char object[NAME_LENGTH] = "";
+
+    if (number_of_sections == 0 || number_of_symbols == MAX_SYMBOLS
+            || sscanf(line, "%lx %lx %n", &address, &size, &used) != 2) {
+        return;
+    }
+    rest = line + used;
+    symbol = &symbols[number_of_symbols];
+    symbol->size = size;
+    symbol->section = number_of_sections - 1;
+    if (strncmp(rest, "--HOLE--", 8) == 0) {
+        strcpy(symbol->name, "--HOLE--");
+        strcpy(symbol->object, "");
+        strcpy(symbol->input, sections[symbol->section].name);
+        number_of_symbols++;
+        return;
+    }
+    open = strrchr(rest, '(');
+    close = strrchr(rest, ')');
+    if (open == NULL || close == NULL || close < open) {
+        return;
+    }
+
+    // the object: "lib : obj", ": obj" for the same lib, "obj" or nothing
+    colon = memchr(rest, ':', open - rest);
+    if (colon != NULL) {
+        if (colon > rest) {
+            copyTrimmed(lib, rest, colon - rest);
+        }
+        copyTrimmed(object, colon + 1, open - colon - 1);
+        snprintf(symbol->object, sizeof symbol->object, "%s: %s", lib, object);
+    } else {
+        copyTrimmed(object, rest, open - rest);
+        strcpy(symbol->object, object);
+        lib[0] = '\0';
+    }
+
+    // the input section, ".text:readTemp" or ".common:output" or ".data"
+    colon = memchr(open, ':', close - open);
+    if (colon != NULL) {
+        copyTrimmed(symbol->input, open + 1, colon - open - 1);
+        copyTrimmed(symbol->name, colon + 1, close - colon - 1);
+    } else {
+        copyTrimmed(symbol->input, open + 1, close - open - 1);
+        snprintf(symbol->name, NAME_LENGTH, "(%s)", object);
+    }
+    number_of_symbols++;
+}
+
+/**
+ * Function for reading the linker map
+ *
+ * Reads the output sections and their input sections out of the SECTION
+ * ALLOCATION MAP. A name too long for its column is on a line of its own
+ * and the rest follows on the next line after a '*'. Returns FALSE if the
+ * file can not be read or has no allocation map.
+ *
+**/
+int readMap(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    char name[NAME_LENGTH] = "";
+    char lib[NAME_LENGTH] = "";
+    int in_map = FALSE;
+
+    if (file == NULL) {
+        perror(path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof line, file) != NULL) {
+        if (strncmp(line, "SECTION ALLOCATION MAP", 22) == 0) {
+            in_map = TRUE;
+            continue;
+        }
+        if (!in_map) {
+            continue;
+        }
+        if (strncmp(line, "MODULE SUMMARY", 14) == 0 || strncmp(line, "GLOBAL SYMBOLS", 14) == 0) {
+            break;
+        }
+        if (line[0] == '.' || isalpha((unsigned char)line[0]) || line[0] == '_') {
+            // output section, maybe with the rest on the next line
+            int length = strcspn(line, " \t\r\n");
+            copyTrimmed(name, line, length);
+            if (strcmp(name, "output") == 0 || strcmp(name, "section") == 0) {
+                name[0] = '\0';
+                continue;
+            }
+            addSection(name, line + length);
+        } else if (line[0] == '*' && name[0] != '\0') {
+            addSection(name, line + 1);
+        } else if (isspace((unsigned char)line[0]) && isxdigit((unsigned char)line[strspn(line, " \t")])) {
+            addSymbol(line + strspn(line, " \t"), lib);
+        }
+    }
+    fclose(file);
+    if (number_of_sections == 0) {
+        fprintf(stderr, "mapsize: %s has no section allocation map\n", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Function for reading the stack and heap use from a UART capture
+ *
+ * Keeps the largest used values of the <K,stackUsed,stackSize,heapUsed,
+ * heapSize> lines in the capture. Returns FALSE if the file can not be read.
+ *
+**/
+int readMeasurements(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    if (file == NULL) {
+        perror(path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof line, file) != NULL) {
+        const char *start = strstr(line, "<K,");
+        unsigned long su, ss, hu, hs;
+        if (start != NULL && sscanf(start, "<K,%lu,%lu,%lu,%lu>", &su, &ss, &hu, &hs) == 4) {
+            if (su > stack_used) {
+                stack_used = su;
+            }
+            if (hu > heap_used) {
+                heap_used = hu;
+            }
+            stack_size = ss;
+            heap_size = hs;
+            measured = TRUE;
+        }
+    }
+    fclose(file);
+    return TRUE;
+}
+
+int bySize(const void *a, const void *b) {
+    const struct symbol_info *x = a, *y = b;
+    if (x->size != y->size) {
+        return x->size < y->size ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/*
+ * List the largest count symbols (all for 0) of the RAM only or the image
+ * sections, with the share of the total each one has. Holes, which is
+ * where the stack and heap reservations are, are only counted.
+ */
+void printSymbols(const char *title, int ram, int count) {
+    unsigned long total = 0, holes = 0;
+    int x, shown = 0;
+    for (x = 0; x < number_of_symbols; x++) {
+        if (sections[symbols[x].section].ram == ram) {
+            total += symbols[x].size;
+            if (strcmp(symbols[x].name, "--HOLE--") == 0) {
+                holes += symbols[x].size;
+            }
+        }
+    }
+    printf("\n%s: %lu bytes, %lu of them holes and reservations\n", title, total, holes);
+    printf("%-32s %-10s %8s %6s  %s\n", "symbol", "section", "bytes", "%", "object");
+    for (x = 0; x < number_of_symbols && (count == 0 || shown < count); x++) {
+        const struct symbol_info *symbol = &symbols[x];
+        if (sections[symbol->section].ram != ram || strcmp(symbol->name, "--HOLE--") == 0) {
+            continue;
+        }
+        printf("%-32s %-10s %8lu %6.2f  %s\n", symbol->name, symbol->input, symbol->size,
+               total > 0 ? symbol->size * 100.0 / total : 0.0, symbol->object);
+        shown++;
+    }
+}
+
+/*
+ * Set the deepest use seen against a reservation and suggest a size with
+ * RESERVE_MARGIN percent on top, rounded up to 256 bytes
+ */
+void printReserve(const char *name, unsigned long used, unsigned long size) {
+    unsigned long suggested = (used * (100 + RESERVE_MARGIN) / 100 + 255) & ~255UL;
+    printf("%-8s %8lu of %8lu bytes used (%5.1f%%), with %d%% margin %#lx would do\n",
+           name, used, size, size > 0 ? used * 100.0 / size : 0.0, RESERVE_MARGIN, suggested);
+}
+
+/*
+ * Add up the symbols per object file and list the largest count (all for
+ * 0) by image size, with the RAM only bytes of each next to it
+ */
+void printObjects(int count) {
+    static struct object_info {
+        char name[2 * NAME_LENGTH];
+        unsigned long image;
+        unsigned long ram;
+    } objects[MAX_SYMBOLS], swap;
+    int number_of_objects = 0;
+    int x, y;
+
+    for (x = 0; x < number_of_symbols; x++) {
+        const struct symbol_info *symbol = &symbols[x];
+        if (symbol->object[0] == '\0') {
+            continue;
+        }
+        for (y = 0; y < number_of_objects && strcmp(objects[y].name, symbol->object) != 0; y++) {
+        }
+        if (y == number_of_objects) {
+            strcpy(objects[y].name, symbol->object);
+            objects[y].image = objects[y].ram = 0;
+            number_of_objects++;
+        }
+        if (sections[symbol->section].ram) {
+            objects[y].ram += symbol->size;
+        } else {
+            objects[y].image += symbol->size;
+        }
+    }
+    for (x = 1; x < number_of_objects; x++) {
+        for (y = x; y > 0 && objects[y].image > objects[y - 1].image; y--) {
+            swap = objects[y];
+            objects[y] = objects[y - 1];
+            objects[y - 1] = swap;
+        }
+    }
+    printf("\nObjects: %d\n", number_of_objects);
+    printf("%-56s %8s %8s\n", "object", "image", "RAM only");
+    for (x = 0; x < number_of_objects && (count == 0 || x < count); x++) {
+        printf("%-56s %8lu %8lu\n", objects[x].name, objects[x].image, objects[x].ram);
+    }
+}
+
+/*
+ * Write every symbol but the holes as a line of name, input section,
+ * object, kind and size separated by tabs. Returns FALSE if the file can
+ * not be written.
+ */
+int writeBaseline(const char *path) {
+    FILE *file = fopen(path, "w");
+    int x;
+    if (file == NULL) {
+        perror(path);
+        return FALSE;
+    }
+    for (x = 0; x < number_of_symbols; x++) {
+        const struct symbol_info *symbol = &symbols[x];
+        if (strcmp(symbol->name, "--HOLE--") != 0) {
+            fprintf(file, "%s\t%s\t%s\t%s\t%lu\n", symbol->name, symbol->input, symbol->object,
+                    sections[symbol->section].ram ? "ram" : "image", symbol->size);
+        }
+    }
+    fclose(file);
+    return TRUE;
+}
+
+/*
+ * Read a baseline written by writeBaseline. The section of a baseline
+ * symbol is 0 for the image and 1 for RAM only. Returns FALSE if the file
+ * can not be read.
+ */
+int readBaseline(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    if (file == NULL) {
+        perror(path);
+        return FALSE;
+    }
+    while (number_of_baseline < MAX_SYMBOLS && fgets(line, sizeof line, file) != NULL) {
+        struct symbol_info *symbol = &baseline[number_of_baseline];
+        char *field[5];
+        int x;
+        field[0] = line;
+        for (x = 1; x < 5 && (field[x] = strchr(field[x - 1], '\t')) != NULL; x++) {
+            *field[x]++ = '\0';
+        }
+        if (x < 5) {
+            continue;
+        }
+        copyTrimmed(symbol->name, field[0], strlen(field[0]));
+        copyTrimmed(symbol->input, field[1], strlen(field[1]));
+        snprintf(symbol->object, sizeof symbol->object, "%s", field[2]);
+        symbol->section = strcmp(field[3], "ram") == 0;
+        symbol->size = strtoul(field[4], NULL, 10);
+        number_of_baseline++;
+    }
+    fclose(file);
+    return TRUE;
+}
+
+int sameSymbol(const struct symbol_info *a, const struct symbol_info *b) {
+    return strcmp(a->name, b->name) == 0 && strcmp(a->input, b->input) == 0
+           && strcmp(a->object, b->object) == 0;
+}
+
+/*
+ * Print one changed symbol and add its change to the image or RAM only total
+ */
+void printChange(const struct symbol_info *symbol, int ram, long before, long after, long *total) {
+    printf("%-32s %-10s %-5s %8ld %8ld %+8ld  %s\n", symbol->name, symbol->input,
+           ram ? "ram" : "image", before, after, after - before, symbol->object);
+    total[ram] += after - before;
+}
+
+/**
+ * Function for comparing the map against the baseline
+ *
+ * Lists every symbol that changed size, is new or is gone since the
+ * baseline, then the change in image and RAM only bytes. Returns the
+ * number of symbols that changed.
+ *
+**/
+int printChanges(void) {
+    static int seen[MAX_SYMBOLS];
+    long total[2] = {0, 0};
+    int changes = 0;
+    int x, y;
+
+    printf("\n%-32s %-10s %-5s %8s %8s %8s  %s\n", "symbol", "section", "kind", "before", "after",
+           "change", "object");
+    for (x = 0; x < number_of_symbols; x++) {
+        const struct symbol_info *symbol = &symbols[x];
+        int ram = sections[symbol->section].ram;
+        if (strcmp(symbol->name, "--HOLE--") == 0) {
+            continue;
+        }
+        for (y = 0; y < number_of_baseline && (seen[y] || !sameSymbol(&baseline[y], symbol)); y++) {
+        }
+        if (y == number_of_baseline) {
+            printChange(symbol, ram, 0, symbol->size, total);
+            changes++;
+            continue;
+        }
+        seen[y] = TRUE;
+        if (baseline[y].size != symbol->size) {
+            printChange(symbol, ram, baseline[y].size, symbol->size, total);
+            changes++;
+        }
+    }
+    for (y = 0; y < number_of_baseline; y++) {
+        if (!seen[y]) {
+            printChange(&baseline[y], baseline[y].section, baseline[y].size, 0, total);
+            changes++;
+        }
+    }
+    printf("%d symbols changed, image %+ld bytes, RAM only %+ld bytes\n", changes, total[0], total[1]);
+    return changes;
+}
+
+void usage(void) {
+    fprintf(stderr, "usage: mapsize [-n count] [-l uart.log] [-o] [-k kHz] [-w baseline] "
+            "[-b baseline] project.map\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *map = NULL;
+    const char *log = NULL;
+    const char *write = NULL;
+    const char *compare = NULL;
+    int count = DEFAULT_COUNT;
+    int objects = FALSE;
+    long khz = FLASH_KHZ;
+    unsigned long image = 0, ram = 0;
+    int x;
+
+    for (x = 1; x < argc; x++) {
+        if (strcmp(argv[x], "-n") == 0 && x + 1 < argc) {
+            count = atoi(argv[++x]);
+        } else if (strcmp(argv[x], "-l") == 0 && x + 1 < argc) {
+            log = argv[++x];
+        } else if (strcmp(argv[x], "-o") == 0) {
+            objects = TRUE;
+        } else if (strcmp(argv[x], "-k") == 0 && x + 1 < argc) {
+            khz = atol(argv[++x]);
+        } else if (strcmp(argv[x], "-w") == 0 && x + 1 < argc) {
+            write = argv[++x];
+        } else if (strcmp(argv[x], "-b") == 0 && x + 1 < argc) {
+            compare = argv[++x];
+        } else if (argv[x][0] != '-' && map == NULL) {
+            map = argv[x];
+        } else {
+            usage();
+        }
+    }
+    if (map == NULL || count < 0 || khz <= 0) {
+        usage();
+    }
+    if (!readMap(map) || (log != NULL && !readMeasurements(log))
+            || (compare != NULL && !readBaseline(compare))) {
+        return 2;
+    }
+    qsort(symbols, number_of_symbols, sizeof symbols[0], bySize);
+
+    printf("%-14s %10s %10s  %s\n", "section", "origin", "bytes", "kind");
+    for (x = 0; x < number_of_sections; x++) {
+        printf("%-14s %#10lx %10lu  %s\n", sections[x].name, sections[x].origin, sections[x].length,
+               sections[x].ram ? "RAM only" : "image");
+        if (sections[x].ram) {
+            ram += sections[x].length;
+        } else {
+            image += sections[x].length;
+        }
+    }
+    printf("image %lu bytes, RAM only %lu bytes, SRAM total %lu bytes\n", image, ram, image + ram);
+    // the copy alone, the boot loader's own start and checks come on top
+    printf("load %.2f ms for the image at %ld kHz on %d line(s)\n",
+           image * 8.0 / FLASH_LINES / khz, khz, FLASH_LINES);
+
+    if (write != NULL && !writeBaseline(write)) {
+        return 2;
+    }
+    if (compare != NULL) {
+        printChanges();
+        return 0;
+    }
+
+    if (objects) {
+        printObjects(count);
+    }
+    printSymbols("RAM only symbols", TRUE, count);
+    printSymbols("Image symbols", FALSE, count);
+
+    if (measured) {
+        printf("\nmeasured on the device\n");
+        printReserve(".stack", stack_used, stack_size);
+        printReserve(".sysmem", heap_used, heap_size);
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ *  ======== objecttemp.c ========
+ */
+
+// Problem Description:
+//
+// objectTemp() works out the TMP006 object temperature from the sensor
+// voltage and die temperature in 64 bit fixed point, because the M4 has
+// no FPU. Every scaling in it is a chance to lose accuracy or overflow
+// somewhere in the sensor's range, and it runs on every sample.
+
+// Solution:
+//
+// The harness runs objectTemp() over die temperatures from -40 to 125C in
+// the die register's 1/32 degree steps and sensor voltages across
+// +/-VOLTAGE_RANGE, and compares each result with the user's guide
+// formula in double precision. The result is truncated to 1/128 degree,
+// so the error must stay below one output LSB. It then times the function
+// on the host.
+//
+// Build:   make -C tools objecttemp
+// Usage:   objecttemp
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DIE_MIN (-40 * 128)         // die register, 1/128 degree
+#define DIE_MAX (125 * 128)
+#define DIE_STEP 4                  // the register's 14 bits are 1/32 degree
+#define VOLTAGE_RANGE 600           // register LSBs of 156.25nV, about +/-94uV
+#define VOLTAGE_STEP 3
+#define BENCHMARK_CALLS 10000000
+
+/*
+ * The user's guide formula in double precision, degrees C
+ */
+static double reference(int16_t voltage, int16_t die) {
+    double tdie = die / 128.0 + 273.15;
+    double dt = die / 128.0 - 25.0;
+    double s = 6.4e-14 * (1 + 1.75e-3 * dt - 1.678e-5 * dt * dt);
+    double vos = -2.94e-5 - 5.7e-7 * dt + 4.63e-9 * dt * dt;
+    double v = voltage * 156.25e-9 - vos;
+    double f = v + 13.4 * v * v;
+    return pow(pow(tdie, 4) + f / s, 0.25) - 273.15;
+}
+
+int main(void) {
+    double worst = 0, error, start, seconds;
+    int worstVoltage = 0, worstDie = 0;
+    int die, voltage;
+    volatile int16_t sink;
+    uint32_t calls = 0;
+
+    for (die = DIE_MIN; die <= DIE_MAX; die += DIE_STEP) {
+        for (voltage = -VOLTAGE_RANGE; voltage <= VOLTAGE_RANGE; voltage += VOLTAGE_STEP) {
+            error = fabs(objectTemp(voltage, die) / 128.0 - reference(voltage, die));
+            calls++;
+            if (error > worst) {
+                worst = error;
+                worstVoltage = voltage;
+                worstDie = die;
+            }
+        }
+    }
+    printf("%lu points, worst error %.4f C at die %.3f C, voltage %d (LSB %.4f C)\n",
+           (unsigned long)calls, worst, worstDie / 128.0, worstVoltage, 1 / 128.0);
+    HOST_CHECK(worst < 1 / 128.0);
+
+    start = hostSeconds();
+    for (calls = 0; calls < BENCHMARK_CALLS; calls++) {
+        sink = objectTemp((int16_t)(calls % (2 * VOLTAGE_RANGE)) - VOLTAGE_RANGE,
+                          (int16_t)(calls % (DIE_MAX - DIE_MIN)) + DIE_MIN);
+    }
+    seconds = hostSeconds() - start;
+    (void)sink;
+    printf("objectTemp %.1f ns a sample on the host\n", seconds * 1e9 / BENCHMARK_CALLS);
+
+    printf("%s\n", hostFailures == 0 ? "all objectTemp checks hold" : "objectTemp checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/*
+ *  ======== oneshot.c ========
+ */
+
+// Problem Description:
+//
+// In TMP102 one-shot mode startConversion() wakes the sensor
+// CONVERSION_LEAD before updateTemp() reads it, so the sensor sleeps
+// between samples. That only pays if every read finds the conversion it
+// asked for already finished, and the sample is no older than it was
+// with the sensor converting continuously.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with the TMP102 model, which
+// takes HOST_TMP102_CONVERSION_MS to convert and tracks how old its result
+// is at every read. The harness runs an hour in one-shot mode, then an
+// hour with the sensor left converting at its default 4Hz, as the
+// firmware did before, and compares the sample age, the reads that came
+// before the conversion finished, the time the sensor spent converting
+// and the bus time per sample.
+//
+// Build:   make -C tools oneshot
+// Usage:   oneshot
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define RUN_SECONDS 3600
+#define TMP102_CONTINUOUS 0x60A0    // power-up configuration, 4Hz
+
+static struct host_tmp102 tmp102;
+
+struct result {
+    double ageMean;                 // ms
+    double ageMax;
+    uint32_t early;
+    double converting;              // fraction of the time
+    double busPerSample;            // us
+    double transfersPerSample;
+};
+
+/*
+ * Run an hour and work out the figures for it
+ */
+static struct result measure(const char *mode) {
+    struct result result;
+    uint32_t conversions, transfers;
+    uint64_t busCycles;
+    uint32_t reads;
+
+    tmp102.reads = tmp102.early = 0;
+    tmp102.ageSum = tmp102.ageMax = 0;
+    conversions = tmp102.conversions;
+    transfers = hostTransfers;
+    busCycles = hostBusCycles;
+    hostRun(RUN_SECONDS * HOST_CYCLES_PER_SECOND);
+    reads = tmp102.reads;
+
+    result.ageMean = tmp102.ageSum / (double)reads / HOST_CYCLES_PER_MS;
+    result.ageMax = tmp102.ageMax / (double)HOST_CYCLES_PER_MS;
+    result.early = tmp102.early;
+    result.converting = (tmp102.conversions - conversions) * HOST_TMP102_CONVERSION_MS / (RUN_SECONDS * 1000.0);
+    result.busPerSample = (hostBusCycles - busCycles) / (double)reads / HOST_CYCLES_PER_US;
+    result.transfersPerSample = (hostTransfers - transfers) / (double)reads;
+    printf("%-10s %6lu reads, sample age mean %6.1f ms max %6.1f ms, %lu early, "
+           "converting %4.1f%%, bus %5.1f us in %.1f transfers a sample\n",
+           mode, (unsigned long)reads, result.ageMean, result.ageMax, (unsigned long)result.early,
+           result.converting * 100, result.busPerSample, result.transfersPerSample);
+    HOST_CHECK(reads >= RUN_SECONDS * 1000 / TEMP_PERIOD - 1);
+    return result;
+}
+
+int main(void) {
+    struct result oneShot, continuous;
+    uint8_t config[3] = {TMP102_CONFIG_REG, TMP102_CONTINUOUS >> 8, TMP102_CONTINUOUS & 0xFF};
+    uint8_t pointer = 0;
+
+    hostTemperature = 21.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostBoot();
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(tempOneShot);
+
+    oneShot = measure("one-shot");
+    // every read finds its own conversion done, CONVERSION_LEAD after it started
+    HOST_CHECK(oneShot.early == 0);
+    HOST_CHECK(oneShot.ageMax <= CONVERSION_LEAD - HOST_TMP102_CONVERSION_MS + 1);
+
+    // the sensor converting on its own, as without TMP102_ONE_SHOT
+    tempOneShot = false;
+    tmp102.device.transfer(&tmp102.device, config, sizeof config, NULL, 0);
+    tmp102.device.transfer(&tmp102.device, &pointer, 1, NULL, 0);
+    continuous = measure("continuous");
+
+    // the sensor sleeps most of the time for no older a sample
+    HOST_CHECK(oneShot.converting < continuous.converting);
+    HOST_CHECK(oneShot.ageMean <= continuous.ageMean);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all one-shot checks hold" : "one-shot checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
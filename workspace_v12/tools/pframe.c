@@ -0,0 +1,159 @@
+/*
+ *  ======== pframe.c ========
+ */
+
+// The straight lines between the markers are a guess at the CDF between
+// them, and the markers themselves are estimates. mergedBracket() gives
+// what is known for certain instead: if every height of a unit is within
+// its error of the percentile it stands for, a unit's CDF at x is at
+// least the percentile of the highest marker below x - error and less
+// than that of the lowest marker above x + error. Adding those up over the
+// units, weighted by readings, bounds the merged CDF from below and above,
+// and where the two bounds reach p bounds the merged percentile.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pframe.h"
+
+#define TRUE 1
+#define FALSE 0
+#define LSB (1 / 128.0)
+#define BISECTIONS 60
+
+// the percentiles of quantileTargets[] in the firmware
+const double p_targets[P_MARKERS] = {0, 0.025, 0.05, 0.275, 0.5, 0.725, 0.95, 0.975, 1};
+
+/**
+ * Function for decoding a <P> frame
+ *
+ * Looks for <P,day,readings,m0,...,m8> in line and fills in frame with the
+ * heights in degrees and an error of 0. Returns TRUE for a frame with
+ * markers, FALSE for none or one sent with too few readings for them.
+ *
+**/
+int decodeFrame(const char *line, struct p_frame *frame) {
+    const char *start = strstr(line, "<P,");
+    unsigned m[P_MARKERS];
+    int x = 0;
+    if (start == NULL || sscanf(start, "<P,%d,%lu,%x,%x,%x,%x,%x,%x,%x,%x,%x>", &frame->day, &frame->readings,
+                                &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], &m[6], &m[7], &m[8]) != 2 + P_MARKERS) {
+        return FALSE;
+    }
+    for (x = 0; x < P_MARKERS; x++) {
+        frame->heights[x] = (short)m[x] * LSB;
+        if (x > 0 && frame->heights[x] < frame->heights[x - 1]) {
+            return FALSE;
+        }
+    }
+    frame->error = 0;
+    return TRUE;
+}
+
+/*
+ * A unit's CDF at x, the straight line between the markers either side
+ */
+static double unitCdf(const struct p_frame *frame, double x) {
+    int x0 = 0;
+    if (x < frame->heights[0]) {
+        return 0;
+    }
+    if (x >= frame->heights[P_MARKERS - 1]) {
+        return 1;
+    }
+    while (frame->heights[x0 + 1] <= x) {
+        x0++;
+    }
+    return p_targets[x0] + (p_targets[x0 + 1] - p_targets[x0]) * (x - frame->heights[x0])
+        / (frame->heights[x0 + 1] - frame->heights[x0]);
+}
+
+/**
+ * Function for the merged CDF of count frames at x
+ *
+ * Returns the units' CDFs weighted by their readings.
+ *
+**/
+double mergedCdf(const struct p_frame *frames, int count, double x) {
+    double sum = 0, readings = 0;
+    int u = 0;
+    for (u = 0; u < count; u++) {
+        sum += frames[u].readings * unitCdf(&frames[u], x);
+        readings += frames[u].readings;
+    }
+    return readings > 0 ? sum / readings : 0;
+}
+
+/**
+ * Function for the merged percentile p of count frames
+ *
+ * Returns the lowest x where mergedCdf() reaches p, in degrees.
+ *
+**/
+double mergedQuantile(const struct p_frame *frames, int count, double p) {
+    double low = frames[0].heights[0], high = frames[0].heights[P_MARKERS - 1];
+    int u = 0;
+    for (u = 1; u < count; u++) {
+        low = frames[u].heights[0] < low ? frames[u].heights[0] : low;
+        high = frames[u].heights[P_MARKERS - 1] > high ? frames[u].heights[P_MARKERS - 1] : high;
+    }
+    for (u = 0; u < BISECTIONS; u++) {
+        double middle = (low + high) / 2;
+        if (mergedCdf(frames, count, middle) >= p) {
+            high = middle;
+        } else {
+            low = middle;
+        }
+    }
+    return high;
+}
+
+/*
+ * The bound on the merged CDF at x: the least it can be if below is TRUE,
+ * otherwise what it stays under
+ */
+static double cdfBound(const struct p_frame *frames, int count, double x, int below) {
+    double sum = 0, readings = 0;
+    int u = 0, m = 0;
+    for (u = 0; u < count; u++) {
+        double cdf = below ? 0 : 1;
+        for (m = 0; m < P_MARKERS; m++) {
+            if (below && frames[u].heights[m] + frames[u].error <= x) {
+                cdf = p_targets[m];
+            } else if (!below && frames[u].heights[m] - frames[u].error > x) {
+                cdf = p_targets[m];
+                break;
+            }
+        }
+        sum += frames[u].readings * cdf;
+        readings += frames[u].readings;
+    }
+    return readings > 0 ? sum / readings : 0;
+}
+
+/**
+ * Function for bounding the merged percentile p of count frames
+ *
+ * Sets low and high to the range the percentile p of the merged readings
+ * has to be in, given that every height is within its frame's error. The
+ * bounds only step at the heights give or take the error, so those are
+ * the only places to look.
+ *
+**/
+void mergedBracket(const struct p_frame *frames, int count, double p, double *low, double *high) {
+    int u = 0, m = 0;
+    *low = 1e9;
+    *high = 1e9;
+    for (u = 0; u < count; u++) {
+        for (m = 0; m < P_MARKERS; m++) {
+            double up = frames[u].heights[m] + frames[u].error;
+            double down = frames[u].heights[m] - frames[u].error;
+            if (up < *high && cdfBound(frames, count, up, TRUE) >= p) {
+                *high = up;
+            }
+            if (down < *low && cdfBound(frames, count, down, FALSE) >= p) {
+                *low = down;
+            }
+        }
+    }
+}
@@ -0,0 +1,30 @@
+/*
+ *  ======== pframe.h ========
+ */
+
+// Decoding the <P,day,readings,m0,...,m8> daily quantile frames that
+// sendQuantilesToUART() sends, and merging the frames of several units.
+// Each frame gives points of a unit's day at known percentiles, so a
+// unit's CDF is taken as the straight lines between them and the merged
+// CDF as the units' CDFs weighted by their readings.
+
+#ifndef PFRAME_H
+#define PFRAME_H
+
+#define P_MARKERS 9
+
+struct p_frame {
+    int day;
+    unsigned long readings;
+    double heights[P_MARKERS];  // degree C, at p_targets
+    double error;               // most a height may be off its percentile, degree C
+};
+
+extern const double p_targets[P_MARKERS];
+
+int decodeFrame(const char *line, struct p_frame *frame);
+double mergedCdf(const struct p_frame *frames, int count, double x);
+double mergedQuantile(const struct p_frame *frames, int count, double p);
+void mergedBracket(const struct p_frame *frames, int count, double p, double *low, double *high);
+
+#endif
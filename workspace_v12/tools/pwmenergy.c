@@ -0,0 +1,170 @@
+/*
+ *  ======== pwmenergy.c ========
+ */
+
+// Problem Description:
+//
+// HEAT_PWM replaced the on/off heater with a PI controller on the
+// filtered temperature to save the overshoot and cycling of on/off, and
+// TMP116 event mode only reads the sensor when the temperature leaves a
+// window. Whether the PI holds the room any closer, what it costs in
+// energy, and whether it still sees the sub-degree errors it acts on
+// through the event window, was never measured.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP116 in event mode, in
+// a room whose heater takes LAG seconds to pass its heat on, for a day
+// with the setPoint stepped up in the morning and down in the evening.
+// Alongside, the harness runs the same room under the firmware's on/off
+// rule, heat on while below heatTarget(), looked at every second. For
+// both it adds up the energy at HEATER_WATTS, the mean and the worst
+// distance from heatTarget() once each step has been reached, and the
+// times the heat came on, and for the PI how far the room got from the
+// temperature it last acted on. Through the event window that must stay
+// within TMP116_PI_WINDOW and the room within a tenth of a degree on
+// average, where a window of whole degrees left it half a degree low
+// and an integral that moved by readings instead of time never got it
+// there. The on/off room is held as close only by switching the heat
+// every half minute, so the PI must switch a hundredth as often for the
+// same energy within 2%, on a fraction of the I2C traffic of reading
+// every sample.
+//
+// Build:   make -C tools pwmenergy
+// Usage:   pwmenergy
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAY 86400
+#define OUTSIDE 8.0                 // degrees C
+#define LOSS (1.0 / 3600)           // of the difference to the outside a second
+#define HEATER (25.0 / 3600)        // degrees a second at full duty
+#define LAG 600.0                   // seconds the heater takes to pass its heat on
+#define MORNING (7 * 3600)          // the setPoint goes up two degrees
+#define EVENING (22 * 3600)         // and down four
+#define REACHED 0.1                 // degrees from heatTarget() that count as having reached it
+#define PWM_FULL 4294967296.0       // PWM_DUTY_FRACTION_MAX + 1
+
+struct room {
+    const char *name;
+    double temperature;             // degrees C
+    double heat;                    // duty the heater passes on, behind the one it is driven at
+    double onSeconds;               // weighted by the duty
+    double errorSum;                // of the distance from heatTarget()
+    double worstOver, worstUnder;
+    int compared;
+    int turnedOn;
+    bool reached;                   // within REACHED of heatTarget() since it last moved
+};
+
+static struct host_tmp116 tmp116;
+static struct room pi = {.name = "PI"}, onOff = {.name = "on/off"};
+static double unseen;                // worst distance of the room from what the PI last saw
+
+static void dutyChanged(uint32_t duty) {
+    if (hostPwmDuty == 0 && duty > 0) {
+        pi.turnedOn++;
+    }
+}
+
+/*
+ * Press a button count times, a pass apart
+ */
+static void press(uint_least8_t button, int count) {
+    while (count-- > 0) {
+        hostGpioEdge(button);
+        hostRun(GLOBAL_PERIOD * HOST_CYCLES_PER_MS);
+    }
+}
+
+/*
+ * A second of room at duty, and how far it is from target once it has
+ * reached it
+ */
+static void heatRoom(struct room *room, double duty, int target) {
+    double error;
+    room->heat += (duty - room->heat) / LAG;
+    room->temperature += HEATER * room->heat - LOSS * (room->temperature - OUTSIDE);
+    room->onSeconds += duty;
+    error = room->temperature - target;
+    room->reached = room->reached || fabs(error) <= REACHED;
+    if (room->reached) {
+        room->errorSum += fabs(error);
+        room->compared++;
+        room->worstOver = error > room->worstOver ? error : room->worstOver;
+        room->worstUnder = -error > room->worstUnder ? -error : room->worstUnder;
+    }
+}
+
+static void report(const struct room *room) {
+    printf("%-6s %7.1f Wh, %.3f degrees off on average, %.3f over and %.3f under at worst, on %d times\n",
+           room->name, room->onSeconds * HEATER_WATTS / 3600, room->errorSum / room->compared,
+           room->worstOver, room->worstUnder, room->turnedOn);
+}
+
+int main(void) {
+    double polled = DAY * 1000.0 / TEMP_PERIOD;
+    uint32_t transfers;
+    int second, target, lastTarget;
+    bool on = false;
+
+    hostTemperature = 18.25;
+    hostNoise = 0.01;
+    hostAttachTmp116(&tmp116, 0x49, CONFIG_GPIO_TMP_ALERT);
+    hostBoot();
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(HEAT_PWM);
+    HOST_CHECK(tempEvents);
+    press(CONFIG_GPIO_BUTTON_1, START_TEMP - 19);
+    hostPwmChanged = dutyChanged;
+    pi.temperature = onOff.temperature = hostTemperature;
+    lastTarget = heatTarget();
+    transfers = hostTransfers;
+
+    for (second = 0; second < DAY; second++) {
+        if (second == MORNING) {
+            press(CONFIG_GPIO_BUTTON_0, 2);
+        } else if (second == EVENING) {
+            press(CONFIG_GPIO_BUTTON_1, 4);
+        }
+        target = heatTarget();
+        if (target != lastTarget) {
+            pi.reached = onOff.reached = false;
+            lastTarget = target;
+        }
+        heatRoom(&pi, hostPwmDuty / PWM_FULL, target);
+        hostTemperature = pi.temperature;
+        // the firmware's on/off rule on the second room
+        if (!on && onOff.temperature < target) {
+            onOff.turnedOn++;
+        }
+        on = onOff.temperature < target;
+        heatRoom(&onOff, on ? 1.0 : 0.0, target);
+        hostRun(HOST_CYCLES_PER_SECOND);
+        if (pi.reached && fabs(hostTemperature - zoneFine[0] / 128.0) > unseen) {
+            unseen = fabs(hostTemperature - zoneFine[0] / 128.0);
+        }
+    }
+
+    report(&pi);
+    report(&onOff);
+    printf("the room at worst %.3f degrees from what the PI last saw, %lu I2C transfers, reading every sample "
+           "takes %.0f\n", unseen, (unsigned long)(hostTransfers - transfers), polled);
+    HOST_CHECK(pi.compared > DAY / 2 && onOff.compared > DAY / 2);
+    // the event window lets the PI see the sub-degree errors it acts on
+    HOST_CHECK(unseen <= (TMP116_PI_WINDOW + TMP116_PI_FOLLOW) / 128.0);
+    HOST_CHECK(pi.errorSum / pi.compared <= 0.1);
+    HOST_CHECK(pi.worstUnder <= 0.5);
+    HOST_CHECK(pi.turnedOn * 100 < onOff.turnedOn);
+    HOST_CHECK(fabs(pi.onSeconds - onOff.onSeconds) <= onOff.onSeconds * 0.02);
+    HOST_CHECK(hostTransfers - transfers < polled / 10);
+    HOST_CHECK(alertMisses == 0);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all PWM energy checks hold" : "PWM energy checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
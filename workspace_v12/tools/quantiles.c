@@ -0,0 +1,298 @@
+/*
+ *  ======== quantiles.c ========
+ */
+
+// Problem Description:
+//
+// quantileSample() keeps a day's p5, p50 and p95 in 9 P2 markers in
+// integer arithmetic, and sendQuantilesToUART() sends them as a <P> frame.
+// P2 has no error bound of its own, so how close the markers come to the
+// day's real percentiles has to be worked out for the kind of day, and
+// whether the fixed point loses anything against the textbook algorithm
+// in floating point has to be measured. The frames of several units are
+// meant to be merged on a host, which nothing did.
+
+// Solution:
+//
+// The harness feeds a day of readings, two a second, from three rooms: a
+// steady one with sensor noise, one that drifts over the day, and one the
+// heating steps up in the morning and down at night. Alongside it runs
+// the same extended P2 in double precision and keeps every reading for an
+// exact sort. It checks the fixed point markers against the double ones
+// and every marker against the exact percentile, checks the <P> frame has
+// the markers in it, and times a reading on the host.
+//
+// The bound a marker is checked against depends on the kind of day:
+//
+// steady    21.5 degrees, noise of 0.1 deviation: 2/128 degree. The
+//           readings do not change over the day, the case P2 is made for,
+//           and 172800 of them put a few thousand at every 1/128 step
+//           near p5 and p95, so a marker settles on its percentile's
+//           reading. What is left is one reading either side of it.
+// drifting  21 + 3 sin over the day, the same noise: 1.95 degrees. Late
+//           in the day P2 moves a marker by the parabola through its
+//           neighbours, which assumes the readings now come from the
+//           day's distribution. Here they come from wherever the drift
+//           is, so all that holds is that the marker stays between its
+//           neighbours. Take them on their percentiles, and a marker is
+//           off by at most the distance to the farther one. For the
+//           arcsine distribution of the drift, p50 = 21 with p27.5 and
+//           p72.5 at 21 -+ 3 sin(0.225 pi) = 19.05 and 22.95, so 1.95;
+//           p5 and p95 are off by at most 1.01.
+// stepped   16 at night and 21 from 7 to 22, noise of 0.2 deviation:
+//           4.71 degrees, the same argument. 37.5% of the readings are
+//           near 16, so p50 is in the 21 group at 20.83 and p27.5 in
+//           the 16 group at 16.12. Between the groups there are no
+//           readings, so P2 can put the median anywhere in the gap.
+//
+// A unit's <P> heights are those bounds off plus the 1/128 degree the
+// frame drops. The harness merges the frames with pframe.c, two steady
+// units of different lengths and then all four, and checks that the
+// exact p5, p50 and p95 of all the readings together are in the range
+// mergedBracket() works out from those errors, as is the merged estimate.
+//
+// Build:   make -C tools quantiles
+// Usage:   quantiles
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+#include "pframe.h"
+
+#include <math.h>
+
+#define READINGS (2 * 86400)
+#define LSB (1 / 128.0)
+#define BENCHMARK_READINGS 20000000
+#define UNITS 4
+// the bounds of the header, in degrees
+#define STEADY_BOUND (2 * LSB)
+#define DRIFTING_BOUND 1.95
+#define STEPPED_BOUND 4.71
+
+static struct host_tmp102 tmp102;
+static int16_t readings[READINGS];
+static int16_t sorted[READINGS];
+static double heights[QUANTILE_MARKERS];
+static double positions[QUANTILE_MARKERS];
+static long count;
+static unsigned frame[QUANTILE_MARKERS];
+static int frameFields;
+static char frameText[128];
+static struct p_frame units[UNITS];
+static int16_t merged[UNITS * READINGS];
+static long mergedReadings;
+
+static void line(const char *text) {
+    if (strncmp(text, "<P,", 3) == 0) {
+        frameFields = sscanf(text, "<P,%*d,%*d,%x,%x,%x,%x,%x,%x,%x,%x,%x>", &frame[0], &frame[1], &frame[2],
+                             &frame[3], &frame[4], &frame[5], &frame[6], &frame[7], &frame[8]);
+        snprintf(frameText, sizeof frameText, "%s", text);
+    }
+}
+
+/*
+ * The extended P2 of quantileSample() in double precision
+ */
+static void referenceSample(double value) {
+    int x, cell;
+    if (count < QUANTILE_MARKERS) {
+        for (x = count; x > 0 && heights[x - 1] > value; x--) {
+            heights[x] = heights[x - 1];
+        }
+        heights[x] = value;
+        count++;
+        positions[count - 1] = count;
+        return;
+    }
+    if (value < heights[0]) {
+        heights[0] = value;
+        cell = 0;
+    } else if (value >= heights[QUANTILE_MARKERS - 1]) {
+        heights[QUANTILE_MARKERS - 1] = value;
+        cell = QUANTILE_MARKERS - 2;
+    } else {
+        for (cell = 0; value >= heights[cell + 1]; cell++) {}
+    }
+    for (x = cell + 1; x < QUANTILE_MARKERS; x++) {
+        positions[x]++;
+    }
+    count++;
+    for (x = 1; x < QUANTILE_MARKERS - 1; x++) {
+        double off = 1 + (count - 1) * (quantileTargets[x] / 65536.0) - positions[x];
+        double below = positions[x] - positions[x - 1];
+        double above = positions[x + 1] - positions[x];
+        double moved;
+        int step;
+        if (off >= 1 && above > 1) {
+            step = 1;
+        } else if (off <= -1 && below > 1) {
+            step = -1;
+        } else {
+            continue;
+        }
+        moved = heights[x] + step / (below + above)
+            * ((below + step) * (heights[x + 1] - heights[x]) / above
+               + (above - step) * (heights[x] - heights[x - 1]) / below);
+        if (moved <= heights[x - 1] || moved >= heights[x + 1]) {
+            moved = heights[x] + step * (heights[x + step] - heights[x]) / (positions[x + step] - positions[x]);
+        }
+        heights[x] = moved;
+        positions[x] += step;
+    }
+}
+
+/*
+ * Gaussian noise of deviation sigma
+ */
+static double noise(double sigma) {
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static int compare(const void *a, const void *b) {
+    return *(const int16_t *)a - *(const int16_t *)b;
+}
+
+/*
+ * The percentile p of count sorted readings, in degrees: the lowest
+ * reading with at least p of them at or below it
+ */
+static double exact(const int16_t *readings, long count, double p) {
+    long rank = (long)ceil(p * count);
+    return readings[rank > 0 ? rank - 1 : 0] / 128.0;
+}
+
+/*
+ * Run count readings through both sketches and check the markers, in
+ * degrees, against each other and the exact percentiles. The <P> frame is
+ * decoded into unit with the bound as the error of its heights, and a
+ * LSB on top for the fraction the frame drops.
+ */
+static void day(const char *name, long readingCount, double bound, struct p_frame *unit) {
+    static const int printed[3] = {2, 4, 6};
+    double worstDouble = 0, worstExact = 0;
+    int x;
+
+    quantileCount = 0;
+    count = 0;
+    for (x = 0; x < readingCount; x++) {
+        quantileSample(readings[x]);
+        referenceSample(readings[x]);
+    }
+    memcpy(sorted, readings, readingCount * sizeof sorted[0]);
+    qsort(sorted, readingCount, sizeof sorted[0], compare);
+    memcpy(&merged[mergedReadings], readings, readingCount * sizeof merged[0]);
+    mergedReadings += readingCount;
+    for (x = 0; x < QUANTILE_MARKERS; x++) {
+        double fixed = quantileHeights[x] / 65536.0 / 128;
+        double error = fabs(fixed - exact(sorted, readingCount, quantileTargets[x] / 65536.0));
+        if (fabs(fixed - heights[x] / 128) > worstDouble) {
+            worstDouble = fabs(fixed - heights[x] / 128);
+        }
+        if (error > worstExact) {
+            worstExact = error;
+        }
+    }
+    printf("%-8s", name);
+    for (x = 0; x < 3; x++) {
+        int marker = printed[x];
+        double p = quantileTargets[marker] / 65536.0;
+        printf(" p%-2.0f %7.3f (exact %7.3f)", p * 100, quantileHeights[marker] / 65536.0 / 128,
+               exact(sorted, readingCount, p));
+    }
+    printf("\n         fixed against double %.4f C, against exact %.3f C (bound %.3f C)\n", worstDouble,
+           worstExact, bound);
+    HOST_CHECK(worstDouble <= LSB);
+    HOST_CHECK(worstExact <= bound);
+    HOST_CHECK(quantileHeights[0] >> QUANTILE_FRACTION == sorted[0]);
+    HOST_CHECK(quantileHeights[QUANTILE_MARKERS - 1] >> QUANTILE_FRACTION == sorted[readingCount - 1]);
+
+    frameFields = 0;
+    sendQuantilesToUART();
+    hostAdvance(10 * HOST_CYCLES_PER_MS);
+    HOST_CHECK(frameFields == QUANTILE_MARKERS);
+    HOST_CHECK((int16_t)frame[4] == quantileHeights[4] >> QUANTILE_FRACTION);
+    HOST_CHECK(quantileCount == 0);
+    HOST_CHECK(decodeFrame(frameText, unit));
+    HOST_CHECK(unit->readings == (unsigned long)readingCount);
+    unit->error = bound + LSB;
+}
+
+/*
+ * Merge the <P> frames of the first count units and check the merged p5,
+ * p50 and p95 against the exact ones of all their readings together: the
+ * exact percentile has to be in the range mergedBracket() gives for the
+ * bounds of the units, and so does the merged estimate
+ */
+static void merge(const char *name, int count) {
+    static const double percentiles[3] = {0.05, 0.5, 0.95};
+    long readingCount = 0;
+    int x;
+
+    for (x = 0; x < count; x++) {
+        readingCount += units[x].readings;
+    }
+    qsort(merged, readingCount, sizeof merged[0], compare);
+    printf("%s\n", name);
+    for (x = 0; x < 3; x++) {
+        double low, high, estimate = mergedQuantile(units, count, percentiles[x]);
+        double truth = exact(merged, readingCount, percentiles[x]);
+        mergedBracket(units, count, percentiles[x], &low, &high);
+        printf("         p%-2.0f %7.3f (exact %7.3f), in %7.3f to %7.3f\n", percentiles[x] * 100, estimate, truth,
+               low, high);
+        HOST_CHECK(truth >= low && truth <= high);
+        HOST_CHECK(estimate >= low && estimate <= high);
+    }
+}
+
+int main(void) {
+    double start, perReading;
+    int x;
+
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostAdvance(HOST_CYCLES_PER_SECOND);
+    srand(1);
+
+    // a steady room: sensor noise only
+    for (x = 0; x < READINGS; x++) {
+        readings[x] = (int16_t)lround(128 * (21.5 + noise(0.1)));
+    }
+    day("steady", READINGS, STEADY_BOUND, &units[0]);
+
+    // a cooler room, on since noon
+    for (x = 0; x < READINGS / 2; x++) {
+        readings[x] = (int16_t)lround(128 * (19.5 + noise(0.15)));
+    }
+    day("half", READINGS / 2, STEADY_BOUND, &units[1]);
+    merge("steady and half merged", 2);
+
+    // drifting over the day, warmest in the afternoon
+    for (x = 0; x < READINGS; x++) {
+        double t = x / 2.0;
+        readings[x] = (int16_t)lround(128 * (21 + 3 * sin(2 * M_PI * (t - 9 * 3600) / 86400) + noise(0.1)));
+    }
+    day("drifting", READINGS, DRIFTING_BOUND, &units[2]);
+
+    // set back to 16 at night and heated to 21 from 7 to 22
+    for (x = 0; x < READINGS; x++) {
+        double t = x / 2.0;
+        double target = t >= 7 * 3600 && t < 22 * 3600 ? 21 : 16;
+        readings[x] = (int16_t)lround(128 * (target + noise(0.2)));
+    }
+    day("stepped", READINGS, STEPPED_BOUND, &units[3]);
+    merge("all four merged", UNITS);
+
+    start = hostSeconds();
+    quantileCount = 0;
+    for (x = 0; x < BENCHMARK_READINGS; x++) {
+        quantileSample(readings[x % READINGS]);
+    }
+    perReading = (hostSeconds() - start) * 1e9 / BENCHMARK_READINGS;
+    printf("quantileSample %.1f ns a reading on the host\n", perReading);
+
+    printf("%s\n", hostFailures == 0 ? "all quantile checks hold" : "quantile checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+ *  ======== quantmerge.c ========
+ */
+
+// Problem Description:
+//
+// Every thermostat sends its own day's p5, p50 and p95 in a <P> frame. A
+// building with several units wants the same figures over all its rooms,
+// and percentiles of the units can not be averaged into percentiles of
+// the building.
+
+// Solution:
+//
+// The tool reads the <P> frames out of the UART captures of the units,
+// one capture a unit, and for every day they have frames for merges the
+// units as their piecewise linear CDFs weighted by readings (see
+// pframe.c). It prints the merged p5, p50 and p95 and the range each has
+// to be in, given how far a unit's markers may be off; quantiles.c has
+// the bounds for the kinds of day the harness knows.
+//
+// Build:   make -C tools
+// Usage:   quantmerge [-e degrees] uart.log...
+// degrees is how far a marker of the captures after it may be off its
+// percentile (default 0, as if the markers were exact).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pframe.h"
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_FRAMES 4096
+#define LINE_LENGTH 512
+
+struct p_frame frames[MAX_FRAMES];
+int number_of_frames = 0;
+
+void usage(void) {
+    fprintf(stderr, "usage: quantmerge [-e degrees] uart.log...\n");
+    exit(2);
+}
+
+/**
+ * Function for reading the <P> frames of a UART capture
+ *
+ * Adds the frames with markers to frames[] with error as their error.
+ * Returns FALSE if the file can not be read.
+ *
+**/
+int readFrames(const char *path, double error) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    if (file == NULL) {
+        perror(path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof line, file) != NULL && number_of_frames < MAX_FRAMES) {
+        if (decodeFrame(line, &frames[number_of_frames])) {
+            frames[number_of_frames].error = error;
+            number_of_frames++;
+        }
+    }
+    fclose(file);
+    return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+    static const double percentiles[3] = {0.05, 0.5, 0.95};
+    static struct p_frame day[MAX_FRAMES];
+    static int done[MAX_FRAMES];
+    double error = 0;
+    int x, y, units, files = 0;
+
+    for (x = 1; x < argc; x++) {
+        if (strcmp(argv[x], "-e") == 0 && x + 1 < argc) {
+            error = atof(argv[++x]);
+        } else if (argv[x][0] != '-') {
+            if (!readFrames(argv[x], error)) {
+                return 2;
+            }
+            files++;
+        } else {
+            usage();
+        }
+    }
+    if (files == 0 || error < 0) {
+        usage();
+    }
+
+    printf("%-5s %5s %9s  %-26s %-26s %-26s\n", "day", "units", "readings", "p5 (range)", "p50 (range)",
+           "p95 (range)");
+    for (x = 0; x < number_of_frames; x++) {
+        unsigned long readings = 0;
+        if (done[x]) {
+            continue;
+        }
+        units = 0;
+        for (y = x; y < number_of_frames; y++) {
+            if (!done[y] && frames[y].day == frames[x].day) {
+                day[units++] = frames[y];
+                readings += frames[y].readings;
+                done[y] = TRUE;
+            }
+        }
+        printf("%-5d %5d %9lu ", frames[x].day, units, readings);
+        for (y = 0; y < 3; y++) {
+            double low, high;
+            mergedBracket(day, units, percentiles[y], &low, &high);
+            printf(" %7.3f (%7.3f %7.3f)  ", mergedQuantile(day, units, percentiles[y]), low, high);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  ======== queuelatency.c ========
+ */
+
+// Problem Description:
+//
+// serviceI2C() runs the queued I2C requests by priority, so a temperature
+// read queued behind a FIFO burst should still go first, and a background
+// read that a control read was coalesced onto should only run at control
+// priority that one time. The <Q> reply only gives bucket percentiles, so
+// nothing showed what the queue latency of each priority looks like under
+// load or that a coalesced read keeps its own priority afterwards.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 and a BMA222E, the
+// FIFO bursts of which are the longest background requests. The harness
+// reports p50/p95/p99 of each priority from i2cPercentile() over ten
+// minutes at the bit rate the firmware picks and at 100 kHz, where a burst
+// outlasts I2C_PASS_BUDGET_US, and checks that control reads never wait
+// past the first bucket. It then queues background reads by hand, chains a
+// control read onto one of them and checks the order they run in, before
+// and after.
+//
+// Build:   make -C tools queuelatency
+// Usage:   queuelatency
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define MINUTES 10
+#define ORDERED 4
+
+static const char *const names[NUMBER_OF_I2C_PRIORITIES] = {"control", "sensor", "background"};
+
+static struct host_tmp102 tmp102;
+static struct host_bma222e accel;
+static int8_t still[1][3] = {{0, 0, 64}};
+static uint8_t buffers[ORDERED][2];
+static struct i2c_request requests[ORDERED];
+static struct i2c_request *ran[ORDERED];
+static int runs;
+
+/*
+ * done of the hand queued requests, notes the order they ran in
+ */
+static void noteRun(struct i2c_request *request, bool ok) {
+    if (runs < ORDERED) {
+        ran[runs++] = request;
+    }
+}
+
+/*
+ * Reopen the bus at bitRates[rate]
+ */
+static void reopen(int rate) {
+    I2C_close(i2c);
+    i2cParams.bitRate = bitRates[rate].bitRate;
+    i2c = openI2C();
+    busSpeed = bitRates[rate].speed;
+}
+
+/*
+ * Run the firmware at bitRates[rate] for MINUTES and report the latency
+ * percentiles of every priority
+ */
+static void measure(int rate) {
+    int x;
+    reopen(rate);
+    memset(i2cLatency, 0, sizeof i2cLatency);
+    hostRun(MINUTES * 60 * HOST_CYCLES_PER_SECOND);
+    for (x = 0; x < NUMBER_OF_I2C_PRIORITIES; x++) {
+        if (i2cRequests(x) == 0) {
+            continue;
+        }
+        printf("%4u Kbps %-10s %6lu requests, p50 %5lu us, p95 %5lu us, p99 %5lu us\n", busSpeed,
+               names[x], (unsigned long)i2cRequests(x), (unsigned long)i2cPercentile(x, 50),
+               (unsigned long)i2cPercentile(x, 95), (unsigned long)i2cPercentile(x, 99));
+    }
+    HOST_CHECK(i2cRequests(I2C_CONTROL) > 0);
+    HOST_CHECK(i2cRequests(I2C_BACKGROUND) > 0);
+    HOST_CHECK(i2cPercentile(I2C_CONTROL, 99) == 1 << I2C_LATENCY_SHIFT);
+    HOST_CHECK(health == 0);
+}
+
+/*
+ * Queue requests[0..count-1] in that order, service the queue and return
+ * how many ran
+ */
+static int runQueued(int count) {
+    int x;
+    runs = 0;
+    HOST_CHECK(i2cQueued == 0);
+    for (x = 0; x < count; x++) {
+        HOST_CHECK(queueI2C(&requests[x]));
+        hostAdvance(HOST_CYCLES_PER_US);
+    }
+    serviceI2C();
+    return runs;
+}
+
+int main(void) {
+    uint32_t coalesced;
+    int rate;
+
+    hostTemperature = 21.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostAttachBma222e(&accel, CONFIG_I2C_0_BMA222E_ADDR, still, 1);
+    hostBoot();
+    // past the first save, whose file commit would hold up a read
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(accelPresent);
+
+    for (rate = NUMBER_OF_BIT_RATES - 1; rate > 0 && bitRates[rate].speed != busSpeed; rate--) {}
+    measure(rate);
+    measure(0);
+    // back to the rate the firmware picked, where the queue empties every pass
+    reopen(rate);
+    hostRun(HOST_CYCLES_PER_SECOND);
+
+    // a control read chained onto the younger of two background reads
+    // takes it ahead of the older one
+    setupRequest(&requests[0], 0x48, TMP102_CONFIG_REG, buffers[0], 2, I2C_BACKGROUND, noteRun);
+    setupRequest(&requests[1], 0x48, sensors[TMP102_SENSOR].resultReg, buffers[1], 2, I2C_BACKGROUND, noteRun);
+    setupRequest(&requests[2], 0x48, sensors[TMP102_SENSOR].resultReg, buffers[2], 2, I2C_CONTROL, noteRun);
+    coalesced = i2cCoalesced;
+    HOST_CHECK(runQueued(3) == 3);
+    HOST_CHECK(i2cCoalesced == coalesced + 1);
+    HOST_CHECK(ran[0] == &requests[1]);
+    HOST_CHECK(ran[1] == &requests[2]);
+    HOST_CHECK(ran[2] == &requests[0]);
+    HOST_CHECK(requests[1].priority == I2C_BACKGROUND);
+
+    // queued again as it is, without the control read, it is a background
+    // read that waits for the older one
+    HOST_CHECK(runQueued(2) == 2);
+    HOST_CHECK(ran[0] == &requests[0]);
+    HOST_CHECK(ran[1] == &requests[1]);
+    printf("coalesced read ran at control priority once, then at its own\n");
+
+    printf("%s\n", hostFailures == 0 ? "all I2C queue checks hold" : "I2C queue checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/*
+ *  ======== rollups.c ========
+ */
+
+// Problem Description:
+//
+// rollupSample() and rollupSecond() keep the minute, hour, day and week
+// rollups by merging each closed bucket once into the level above, and
+// queryRollup() answers R<level><buckets> from the rings. The merges at
+// the level boundaries, the rings wrapping and the heater seconds carried
+// over from the duty are easy to get wrong by a bucket, and the cost per
+// reading and per query was only ever argued, not measured.
+
+// Solution:
+//
+// The harness boots the firmware on the host stand-ins but drives the
+// rollups itself: eight days of seconds, each with two readings that
+// wander over the day and a heater duty, while keeping every second's
+// figures in a reference. Every quarter hour, and at the end, it queries
+// each level for one bucket, a few and more than the ring holds and
+// checks the <A> reply against the reference over the same seconds. It
+// then times a reading, a second and the longest query on the host.
+//
+// Build:   make -C tools rollups
+// Usage:   rollups
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAYS 8
+#define SPAN (DAYS * 86400)
+#define READINGS 2                  // a second, as TEMP_PERIOD gives them
+#define QUERY_EVERY 900
+#define BENCHMARK_SECONDS 10000000
+
+struct second {
+    int16_t min;
+    int16_t max;
+    int32_t sum;
+    uint8_t count;
+    int32_t duty;                   // Q16 heater duty through the second
+};
+
+static struct host_tmp102 tmp102;
+static struct second history[SPAN + 1];
+static char reply[64];
+static int queries;
+
+static void line(const char *text) {
+    if (text[0] == '<' && (text[1] == 'A' || text[1] == 'E')) {
+        snprintf(reply, sizeof reply, "%s", text);
+    }
+}
+
+/*
+ * The reading and duty of second s and reading n, made up
+ */
+static int16_t reading(int s, int n) {
+    double t = s + n / (double)READINGS;
+    return (int16_t)lround(128 * (20 + 3 * sin(2 * M_PI * t / 86400) + 0.7 * sin(2 * M_PI * t / 613)));
+}
+
+static int32_t duty(int s) {
+    return (s / 97) % 3 == 0 ? 0 : (int32_t)((s * 2654435761u) >> 16);
+}
+
+/*
+ * Ask for buckets of the level at index x and check the reply against the
+ * reference over the same seconds
+ */
+static void query(int x, int buckets) {
+    const struct rollup_level *level = &rollups[x];
+    int closed = seconds - seconds % level->width;
+    int held = buckets < level->used ? buckets : level->used;
+    int first = closed - held * level->width + 1;
+    int16_t min = INT16_MAX, max = INT16_MIN;
+    int64_t sum = 0;
+    uint32_t count = 0;
+    double heat = 0;
+    unsigned long readings, heatSeconds;
+    int n, gotBuckets, gotMin, gotMax;
+    long average;
+    char name;
+    int s;
+
+    for (s = first; s <= closed; s++) {
+        if (history[s].count > 0) {
+            min = history[s].min < min ? history[s].min : min;
+            max = history[s].max > max ? history[s].max : max;
+        }
+        sum += history[s].sum;
+        count += history[s].count;
+        heat += history[s].duty / 65536.0;
+    }
+    reply[0] = '\0';
+    queryRollup(level->name, buckets);
+    // out of the transmit ring at the baud rate
+    hostAdvance(10 * HOST_CYCLES_PER_MS);
+    queries++;
+    n = sscanf(reply, "<A,%c,%d,%lu,%d,%d,%ld,%lu>", &name, &gotBuckets, &readings, &gotMin, &gotMax,
+               &average, &heatSeconds);
+    HOST_CHECK(n == 7);
+    HOST_CHECK(gotBuckets == held);
+    HOST_CHECK(readings == count);
+    if (count > 0) {
+        HOST_CHECK(gotMin == min * 100 / 128);
+        HOST_CHECK(gotMax == max * 100 / 128);
+        HOST_CHECK(average == (long)(sum * 100 / 128 / (int32_t)count));
+    }
+    // the carried fraction moves at most one heater second across a window
+    HOST_CHECK(fabs(heatSeconds - heat) <= 1.0);
+}
+
+int main(void) {
+    int x, n, s;
+    double start, perSecond, perReading, perQuery;
+
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostAdvance(HOST_CYCLES_PER_SECOND);
+    // the rollups are driven here, not by the tasks
+    for (x = 0; x < ROLLUP_LEVELS; x++) {
+        rollups[x].next = 0;
+        rollups[x].used = 0;
+        clearBucket(&rollups[x].open);
+    }
+    heatSecondFraction = 0;
+
+    for (s = 1; s <= SPAN; s++) {
+        struct second *second = &history[s];
+        second->min = INT16_MAX;
+        second->max = INT16_MIN;
+        for (n = 0; n < READINGS; n++) {
+            int16_t value = reading(s, n);
+            rollupSample(value);
+            second->min = value < second->min ? value : second->min;
+            second->max = value > second->max ? value : second->max;
+            second->sum += value;
+            second->count++;
+        }
+        second->duty = duty(s);
+        heatDuty = second->duty;
+        seconds = s;
+        rollupSecond();
+        if (s % QUERY_EVERY == 0 || s == SPAN) {
+            for (x = 0; x < ROLLUP_LEVELS; x++) {
+                query(x, 1);
+                query(x, 7);
+                query(x, rollups[x].size);
+                query(x, rollups[x].size + 5);
+            }
+        }
+    }
+    printf("%d days of seconds, %d queries checked against the reference\n", DAYS, queries);
+    HOST_CHECK(rollups[ROLLUP_LEVELS - 1].used == ROLLUP_HOUR_BUCKETS);
+
+    start = hostSeconds();
+    for (s = 0; s < BENCHMARK_SECONDS; s++) {
+        rollupSample((int16_t)(s & 0xFFF));
+    }
+    perReading = (hostSeconds() - start) * 1e9 / BENCHMARK_SECONDS;
+    start = hostSeconds();
+    for (s = SPAN + 1; s <= SPAN + BENCHMARK_SECONDS; s++) {
+        seconds = s;
+        rollupSecond();
+    }
+    perSecond = (hostSeconds() - start) * 1e9 / BENCHMARK_SECONDS;
+    hostUartLine = NULL;
+    start = hostSeconds();
+    for (n = 0; n < 100000; n++) {
+        queryRollup('h', ROLLUP_HOUR_BUCKETS);
+        hostAdvance(HOST_CYCLES_PER_MS);
+    }
+    perQuery = (hostSeconds() - start) * 1e9 / n;
+    printf("rollupSample %.1f ns, rollupSecond %.1f ns, Rh%d %.0f ns with its reply on the host\n",
+           perReading, perSecond, ROLLUP_HOUR_BUCKETS, perQuery);
+
+    printf("%s\n", hostFailures == 0 ? "all rollup checks hold" : "rollup checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,522 @@
+/*
+ *  ======== schedcheck.c ========
+ */
+
+// Problem Description:
+//
+// The thermostat runs its tasks from a 100ms timer tick and the only way
+// to find out that a tick overran was to watch the UART output jitter on a
+// board. This host tool checks the task table before it is flashed.
+
+// Solution:
+//
+// The tool reads the #define constants and the tasks[] table out of the
+// firmware source, with the #defines of the headers it includes, takes an
+// execution time for every task from an annotation file and, when a UART
+// capture is given, replaces those times with the <W,task,cycles>
+// measurements the firmware prints. It then runs response time analysis
+// for the cooperative loop in mainThread() and for a preemptive rate
+// monotonic dispatcher and reports utilization, worst case response time
+// and whether every deadline holds.
+//
+// Build:   make -C tools
+// Usage:   schedcheck [-a wcet.txt] [-l uart.log] [-f cpu_hz] gpiointerrupt.c
+// The exit status is 1 if any task can miss its deadline, so the tool can
+// be used as a build step.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_DEFINES 256
+#define MAX_TASKS 32
+#define NAME_LENGTH 64
+#define LINE_LENGTH 512
+#define DEFAULT_CPU_FREQUENCY 80000000L
+#define DEFAULT_GLOBAL_PERIOD 100
+#define MAX_ITERATIONS 1000
+#define MAX_INCLUDE_DEPTH 8
+
+struct define_entry {
+    char name[NAME_LENGTH];
+    long value;
+};
+
+struct task_info {
+    char name[NAME_LENGTH];
+    long period_ms;         // period as declared in tasks[]
+    long release_us;        // period the timer callback really releases at
+    long wcet_us;           // execution time used for the analysis
+    char source;            // 'a' annotated, 'm' measured, '-' missing
+    long coop_response_us;
+    long prio_response_us;
+    int prio_rank;
+};
+
+struct define_entry defines[MAX_DEFINES];
+int number_of_defines = 0;
+struct task_info tasks[MAX_TASKS];
+int number_of_tasks = 0;
+long cpu_frequency = DEFAULT_CPU_FREQUENCY;
+
+/**
+ * Function for looking up a #define or a plain number
+ *
+ * Returns TRUE and stores the value in result if token is a number or the
+ * name of a numeric #define read from the source, otherwise FALSE.
+ *
+**/
+int resolve(const char *token, long *result) {
+    int x = 0;
+    char *end;
+    long value = strtol(token, &end, 0);
+    if (end != token && *end == '\0') {
+        *result = value;
+        return TRUE;
+    }
+    for (x = 0; x < number_of_defines; x++) {
+        if (strcmp(defines[x].name, token) == 0) {
+            *result = defines[x].value;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Function for finding a task by the name of its function
+ *
+ * Returns the index into tasks[] or -1 if there is no such task.
+ *
+**/
+int findTask(const char *name) {
+    int x = 0;
+    for (x = 0; x < number_of_tasks; x++) {
+        if (strcmp(tasks[x].name, name) == 0) {
+            return x;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function for copying the next C token out of a line
+ *
+ * Skips blanks, '&' and ',' and copies one identifier or number into token.
+ * Returns a pointer just past the token.
+ *
+**/
+const char *nextToken(const char *p, char *token) {
+    int length = 0;
+    while (*p && (isspace((unsigned char)*p) || *p == '&' || *p == ',')) {
+        p++;
+    }
+    while (*p && (isalnum((unsigned char)*p) || *p == '_') && length < NAME_LENGTH - 1) {
+        token[length++] = *p++;
+    }
+    token[length] = '\0';
+    return p;
+}
+
+/**
+ * Function for collecting a numeric #define out of a line
+ *
+ * Returns TRUE if the line is a #define, whether or not its value could be
+ * resolved to a number.
+ *
+**/
+int readDefine(const char *line) {
+    char name[NAME_LENGTH], text[NAME_LENGTH];
+    long value;
+    if (sscanf(line, " #define %63s %63s", name, text) != 2) {
+        return FALSE;
+    }
+    if (number_of_defines < MAX_DEFINES && resolve(text, &value)) {
+        strcpy(defines[number_of_defines].name, name);
+        defines[number_of_defines].value = value;
+        number_of_defines++;
+    }
+    return TRUE;
+}
+
+/**
+ * Function for following an #include "file" of the firmware source
+ *
+ * The file is looked for next to the source that includes it, path, and
+ * its #defines are collected, and those of the headers it includes in
+ * turn. Headers that are not there, such as the generated driver
+ * configuration, are skipped.
+ *
+**/
+void readInclude(const char *path, const char *line, int depth) {
+    char name[NAME_LENGTH], header[LINE_LENGTH], text[LINE_LENGTH];
+    const char *slash = strrchr(path, '/');
+    int directory = slash == NULL ? 0 : (int)(slash - path + 1);
+    FILE *file;
+
+    if (depth >= MAX_INCLUDE_DEPTH || sscanf(line, " #include \"%63[^\"]\"", name) != 1) {
+        return;
+    }
+    snprintf(header, sizeof(header), "%.*s%s", directory, path, name);
+    file = fopen(header, "r");
+    if (file == NULL) {
+        return;
+    }
+    while (fgets(text, sizeof(text), file) != NULL) {
+        if (!readDefine(text)) {
+            readInclude(header, text, depth + 1);
+        }
+    }
+    fclose(file);
+}
+
+/**
+ * Function for reading the task set out of the firmware source
+ *
+ * Collects every numeric #define, of the source and of the headers it
+ * includes, and then every {&function, elapsed, period, ...} entry of the
+ * tasks[] initializer. Returns FALSE if the file cannot be read or no
+ * tasks were found.
+ *
+**/
+int readSource(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    char token[NAME_LENGTH];
+    int in_table = FALSE;
+
+    if (file == NULL) {
+        fprintf(stderr, "schedcheck: cannot open %s\n", path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        const char *p = line;
+
+        if (readDefine(line)) {
+            continue;
+        }
+        if (!in_table) {
+            readInclude(path, line, 0);
+        }
+        if (strstr(line, "struct task_entry tasks[") != NULL && strchr(line, '=') != NULL) {
+            in_table = TRUE;
+            continue;
+        }
+        if (!in_table) {
+            continue;
+        }
+        if (strstr(line, "};") != NULL) {
+            break;
+        }
+        p = strchr(line, '{');
+        if (p == NULL || number_of_tasks >= MAX_TASKS) {
+            continue;
+        }
+        p = nextToken(p + 1, tasks[number_of_tasks].name);
+        p = strchr(p + 1, ',');     // skip the initial elapsed time, it only sets the phase
+        if (p == NULL) {
+            continue;
+        }
+        p = nextToken(p, token);
+        if (!resolve(token, &tasks[number_of_tasks].period_ms)) {
+            fprintf(stderr, "schedcheck: cannot resolve period %s of %s\n", token, tasks[number_of_tasks].name);
+            fclose(file);
+            return FALSE;
+        }
+        tasks[number_of_tasks].source = '-';
+        number_of_tasks++;
+    }
+    fclose(file);
+    if (number_of_tasks == 0) {
+        fprintf(stderr, "schedcheck: no tasks[] table found in %s\n", path);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Function for reading annotated execution times
+ *
+ * Each line is "<task function> <microseconds>"; anything after a '#' is a
+ * comment. Unknown names are reported and skipped.
+ *
+**/
+int readAnnotations(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    char name[NAME_LENGTH];
+    long wcet;
+    int x;
+
+    if (file == NULL) {
+        fprintf(stderr, "schedcheck: cannot open %s\n", path);
+        return FALSE;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        if (sscanf(line, "%63s %ld", name, &wcet) != 2) {
+            continue;
+        }
+        x = findTask(name);
+        if (x < 0) {
+            fprintf(stderr, "schedcheck: %s is not in tasks[], ignored\n", name);
+            continue;
+        }
+        tasks[x].wcet_us = wcet;
+        tasks[x].source = 'a';
+    }
+    fclose(file);
+    return TRUE;
+}
+
+/**
+ * Function for reading measured execution times from a UART capture
+ *
+ * Picks out the <W,task,cycles> lines printed by sendWcetToUART() and keeps
+ * the largest count seen for each task, converted to microseconds.
+ * Measurements replace the annotated times.
+ *
+**/
+int readMeasurements(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[LINE_LENGTH];
+    int x;
+    unsigned long cycles;
+    long measured[MAX_TASKS];
+
+    if (file == NULL) {
+        fprintf(stderr, "schedcheck: cannot open %s\n", path);
+        return FALSE;
+    }
+    for (x = 0; x < MAX_TASKS; x++) {
+        measured[x] = -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        const char *p = strstr(line, "<W,");
+        long us;
+        if (p == NULL || sscanf(p, "<W,%d,%lu>", &x, &cycles) != 2) {
+            continue;
+        }
+        if (x < 0 || x >= number_of_tasks) {
+            continue;
+        }
+        us = (long)((cycles * 1000000.0) / cpu_frequency + 0.999);
+        if (us > measured[x]) {
+            measured[x] = us;
+        }
+    }
+    fclose(file);
+    for (x = 0; x < number_of_tasks; x++) {
+        if (measured[x] >= 0) {
+            tasks[x].wcet_us = measured[x];
+            tasks[x].source = 'm';
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Function for working out the real release period of every task
+ *
+ * timerCallback() counts the tick it releases a task on as the first tick
+ * of the next period, so a task is released every ceil(period / tick)
+ * ticks, and at least every tick. The note below only shows up for a
+ * period that is not a whole number of ticks.
+ *
+**/
+void computeReleasePeriods(long tick_ms) {
+    int x = 0;
+    for (x = 0; x < number_of_tasks; x++) {
+        long ticks = (tasks[x].period_ms + tick_ms - 1) / tick_ms;
+        if (ticks < 1) {
+            ticks = 1;
+        }
+        tasks[x].release_us = ticks * tick_ms * 1000;
+    }
+}
+
+/**
+ * Function for the response times of the cooperative task loop
+ *
+ * mainThread() runs the triggered tasks in table order and never preempts
+ * one, so this is non-preemptive fixed priority analysis with the table
+ * index as priority. A task released just after the pass went by its slot
+ * waits for the rest of that pass, so it is blocked by every task after it
+ * in the table, not only the longest one; the next pass then starts at
+ * once and it is delayed by every higher priority release until it starts.
+ * Returns FALSE if some response time does not converge.
+ *
+**/
+int analyzeCooperative(void) {
+    int i, j, n;
+    int converged = TRUE;
+    for (i = 0; i < number_of_tasks; i++) {
+        long blocking = 0;
+        long start, next;
+        for (j = i + 1; j < number_of_tasks; j++) {
+            blocking += tasks[j].wcet_us;
+        }
+        next = blocking;
+        for (n = 0; n < MAX_ITERATIONS; n++) {
+            start = next;
+            next = blocking;
+            for (j = 0; j < i; j++) {
+                next += (start / tasks[j].release_us + 1) * tasks[j].wcet_us;
+            }
+            if (next == start || next + tasks[i].wcet_us > tasks[i].release_us) {
+                break;
+            }
+        }
+        if (n == MAX_ITERATIONS) {
+            converged = FALSE;
+        }
+        tasks[i].coop_response_us = next + tasks[i].wcet_us;
+    }
+    return converged;
+}
+
+/**
+ * Function for the response times of a preemptive priority dispatcher
+ *
+ * Priorities are rate monotonic (shortest release period first, ties in
+ * table order) and the classic R = C + sum(ceil(R / T) * C) recurrence is
+ * iterated until it settles or passes the deadline.
+ * Returns FALSE if some response time does not converge.
+ *
+**/
+int analyzePriority(void) {
+    int i, j, n;
+    int converged = TRUE;
+    for (i = 0; i < number_of_tasks; i++) {
+        tasks[i].prio_rank = 0;
+        for (j = 0; j < number_of_tasks; j++) {
+            if (tasks[j].release_us < tasks[i].release_us
+                    || (tasks[j].release_us == tasks[i].release_us && j < i)) {
+                tasks[i].prio_rank++;
+            }
+        }
+    }
+    for (i = 0; i < number_of_tasks; i++) {
+        long response = tasks[i].wcet_us;
+        long next;
+        for (n = 0; n < MAX_ITERATIONS; n++) {
+            next = tasks[i].wcet_us;
+            for (j = 0; j < number_of_tasks; j++) {
+                if (tasks[j].prio_rank < tasks[i].prio_rank) {
+                    next += ((response + tasks[j].release_us - 1) / tasks[j].release_us) * tasks[j].wcet_us;
+                }
+            }
+            if (next == response || next > tasks[i].release_us) {
+                response = next;
+                break;
+            }
+            response = next;
+        }
+        if (n == MAX_ITERATIONS) {
+            converged = FALSE;
+        }
+        tasks[i].prio_response_us = response;
+    }
+    return converged;
+}
+
+void usage(void) {
+    fprintf(stderr, "usage: schedcheck [-a wcet.txt] [-l uart.log] [-f cpu_hz] source.c\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *annotations = NULL;
+    const char *log = NULL;
+    const char *source = NULL;
+    long tick_ms = DEFAULT_GLOBAL_PERIOD;
+    long pass_us = 0;
+    double utilization = 0.0, bound;
+    int x, ok = TRUE;
+
+    for (x = 1; x < argc; x++) {
+        if (strcmp(argv[x], "-a") == 0 && x + 1 < argc) {
+            annotations = argv[++x];
+        } else if (strcmp(argv[x], "-l") == 0 && x + 1 < argc) {
+            log = argv[++x];
+        } else if (strcmp(argv[x], "-f") == 0 && x + 1 < argc) {
+            cpu_frequency = strtol(argv[++x], NULL, 0);
+        } else if (argv[x][0] != '-' && source == NULL) {
+            source = argv[x];
+        } else {
+            usage();
+        }
+    }
+    if (source == NULL || cpu_frequency <= 0) {
+        usage();
+    }
+    if (!readSource(source)) {
+        return 2;
+    }
+    resolve("CPU_FREQUENCY", &cpu_frequency);
+    resolve("GLOBAL_PERIOD", &tick_ms);
+    if ((annotations != NULL && !readAnnotations(annotations)) || (log != NULL && !readMeasurements(log))) {
+        return 2;
+    }
+    for (x = 0; x < number_of_tasks; x++) {
+        if (tasks[x].source == '-') {
+            fprintf(stderr, "schedcheck: no execution time for %s, assuming 0\n", tasks[x].name);
+        }
+    }
+
+    computeReleasePeriods(tick_ms);
+    if (!analyzeCooperative() || !analyzePriority()) {
+        fprintf(stderr, "schedcheck: response time did not converge\n");
+        ok = FALSE;
+    }
+
+    printf("tick %ld ms, cpu %ld Hz (C: a = annotated, m = measured)\n\n", tick_ms, cpu_frequency);
+    printf("%-20s %8s %9s %9s %7s %10s %10s %5s\n",
+           "task", "T(ms)", "T'(ms)", "C(us)", "U(%)", "Rcoop(us)", "Rprio(us)", "ok");
+    for (x = 0; x < number_of_tasks; x++) {
+        double u = (double)tasks[x].wcet_us / tasks[x].release_us;
+        int coop_ok = tasks[x].coop_response_us <= tasks[x].release_us;
+        int prio_ok = tasks[x].prio_response_us <= tasks[x].release_us;
+        utilization += u;
+        pass_us += tasks[x].wcet_us;
+        printf("%-20s %8ld %9.1f %8ld%c %7.3f %10ld %10ld %2s/%-2s\n",
+               tasks[x].name, tasks[x].period_ms, tasks[x].release_us / 1000.0,
+               tasks[x].wcet_us, tasks[x].source, u * 100.0,
+               tasks[x].coop_response_us, tasks[x].prio_response_us,
+               coop_ok ? "y" : "N", prio_ok ? "y" : "N");
+        if (!coop_ok || !prio_ok) {
+            ok = FALSE;
+        }
+        if (tasks[x].period_ms > 0 && tasks[x].release_us != tasks[x].period_ms * 1000) {
+            printf("    note: released every %.1f ms, not every %ld ms\n",
+                   tasks[x].release_us / 1000.0, tasks[x].period_ms);
+        }
+    }
+
+    // Liu and Layland bound n(2^(1/n) - 1), computed without libm
+    bound = 1.0;
+    {
+        double root = 2.0;
+        int n;
+        for (n = 0; n < 60; n++) {
+            double power = 1.0;
+            int k;
+            for (k = 1; k < number_of_tasks; k++) {
+                power *= root;
+            }
+            root -= (power * root - 2.0) / (number_of_tasks * power);
+        }
+        bound = number_of_tasks * (root - 1.0);
+    }
+    printf("\nutilization %.3f%% (rate monotonic bound %.1f%%)\n", utilization * 100.0, bound * 100.0);
+    printf("worst case pass (all tasks released on one tick) %ld us of %ld us tick%s\n",
+           pass_us, tick_ms * 1000, pass_us > tick_ms * 1000 ? " - overruns the tick" : "");
+    printf("%s\n", ok ? "all deadlines hold" : "DEADLINE MISS POSSIBLE");
+    return ok ? 0 : 1;
+}
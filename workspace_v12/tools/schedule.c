@@ -0,0 +1,248 @@
+/*
+ *  ======== schedule.c ========
+ */
+
+// Problem Description:
+//
+// updateSchedule() turns the synced wall clock into a minute of the week
+// with the UTC offset and EPOCH_WEEKDAY_MINUTES, steps the cursor on one
+// entry at a time while the minutes follow each other, and finds the entry
+// in force by binary search after an upload or a jump of the clock. A
+// wrong weekday, a slip at the end of the week or the year, or a search
+// that is off by one at either end of the table would only show on the
+// day it happens.
+
+// Solution:
+//
+// The harness boots the firmware on the host stand-ins and checks that B
+// lines with an odd number of digits or a character that is not hex are
+// answered <E> and start the upload again. It uploads schedules through
+// the B and U commands and then sets the wall clock itself, a minute at a
+// time, from Christmas 2023 to the end of 2024, across a leap day and two
+// new years. The schedules are a full table with entries on
+// the first and last minute of the week, a single entry, just those two
+// entries, and one entry a day, each at a different UTC offset. At every
+// minute the setPoint must be what a reference that works out the local
+// weekday with gmtime() and scans the table gives, including the preheat
+// of a fixed thermal model. Then, for every minute of a week, the search
+// alone must find the same entry, and the clock jumps at random.
+//
+// Build:   make -C tools schedule
+// Usage:   schedule
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <time.h>
+
+#define START 1703462400LL          // 2023-12-25 00:00 UTC, a Monday
+#define END 1735689600LL            // 2025-01-01 00:00 UTC
+#define JUMPS 200000
+
+struct plan {
+    const char *name;
+    int16_t utcOffset;
+    int count;
+    struct schedule_entry entries[SCHEDULE_ENTRIES];
+};
+
+static struct host_tmp102 tmp102;
+static struct plan plans[4];
+static long checked, wrong;
+static char answer[64];             // the last line from the firmware
+
+/*
+ * Upload plan through B lines and put it in use with U
+ */
+static void upload(const struct plan *plan) {
+    uint8_t blob[SCHEDULE_BLOB_SIZE];
+    char hex[COMMAND_LENGTH];
+    int length = 0, x, sent;
+    uint16_t crc;
+    blob[length++] = plan->count;
+    blob[length++] = (uint8_t)plan->utcOffset;
+    blob[length++] = (uint8_t)((uint16_t)plan->utcOffset >> 8);
+    for (x = 0; x < plan->count; x++) {
+        blob[length++] = (uint8_t)plan->entries[x].minute;
+        blob[length++] = (uint8_t)(plan->entries[x].minute >> 8);
+        blob[length++] = plan->entries[x].setPoint;
+    }
+    crc = crc16(blob, length);
+    blob[length++] = (uint8_t)crc;
+    blob[length++] = (uint8_t)(crc >> 8);
+    for (sent = 0; sent < length;) {
+        int bytes = 0;
+        while (sent < length && bytes < (COMMAND_LENGTH - 2) / 2) {
+            snprintf(&hex[bytes * 2], 3, "%02X", blob[sent++]);
+            bytes++;
+        }
+        addScheduleBytes(hex);
+        hostAdvance(10 * HOST_CYCLES_PER_MS);
+    }
+    useSchedule();
+    hostAdvance(10 * HOST_CYCLES_PER_MS);
+    HOST_CHECK(activeSchedule != NULL && activeSchedule->count == plan->count);
+}
+
+static void line(const char *text) {
+    snprintf(answer, sizeof answer, "%s", text);
+}
+
+/*
+ * B lines that are not whole bytes of hex are refused and start the
+ * upload again, whatever came before them
+ */
+static void checkMalformed(void) {
+    static const char *const bad[] = {"0", "ABC", "0G", "01 2", "0102030"};
+    size_t x;
+    for (x = 0; x < sizeof bad / sizeof bad[0]; x++) {
+        addScheduleBytes("0102");
+        hostAdvance(10 * HOST_CYCLES_PER_MS);
+        HOST_CHECK(strcmp(answer, "<B,2>") == 0);
+        addScheduleBytes(bad[x]);
+        hostAdvance(10 * HOST_CYCLES_PER_MS);
+        HOST_CHECK(strcmp(answer, "<E>") == 0);
+        HOST_CHECK(scheduleBlobLength == 0);
+    }
+}
+
+/*
+ * Set the device's wall clock to UTC seconds
+ */
+static void setWall(long long utc) {
+    skewPpb = 0;
+    synced = true;
+    syncDevice = timeMicros();
+    syncWall = (uint64_t)utc * 1000000;
+}
+
+/*
+ * The reference: the minute of the week from the local weekday gmtime()
+ * gives, the entry in force by a scan and the preheat for the next one
+ */
+static int expected(const struct plan *plan, long long utc, int *entry) {
+    time_t local = (time_t)(utc + plan->utcOffset * 60);
+    struct tm tm;
+    int minute, x, next, ahead;
+    gmtime_r(&local, &tm);
+    minute = ((tm.tm_wday + 6) % 7) * 1440 + tm.tm_hour * 60 + tm.tm_min;
+    *entry = plan->count - 1;
+    for (x = 0; x < plan->count; x++) {
+        if (plan->entries[x].minute <= minute) {
+            *entry = x;
+        }
+    }
+    next = (*entry + 1) % plan->count;
+    ahead = (plan->entries[next].minute - minute + MINUTES_PER_WEEK) % MINUTES_PER_WEEK;
+    if (plan->entries[next].setPoint > plan->entries[*entry].setPoint
+            && ahead <= preheatMinutes(plan->entries[next].setPoint)) {
+        return plan->entries[next].setPoint;
+    }
+    return plan->entries[*entry].setPoint;
+}
+
+/*
+ * Run updateSchedule() at utc and check the setPoint against the reference
+ */
+static void check(const struct plan *plan, long long utc) {
+    int entry;
+    int want = expected(plan, utc, &entry);
+    setWall(utc);
+    updateSchedule();
+    checked++;
+    if (setPoint != want) {
+        if (wrong++ < 5) {
+            fprintf(stderr, "%s at %lld: setPoint %d, expected %d\n", plan->name, utc, setPoint, want);
+        }
+    }
+}
+
+static void makePlans(void) {
+    int x;
+    plans[0].name = "full table";
+    plans[0].utcOffset = -300;
+    plans[0].count = SCHEDULE_ENTRIES;
+    for (x = 0; x < SCHEDULE_ENTRIES; x++) {
+        // the first and last minute of the week, the rest spread between
+        plans[0].entries[x].minute = x == SCHEDULE_ENTRIES - 1 ? MINUTES_PER_WEEK - 1 : x * 180 + (x > 0) * 37;
+        plans[0].entries[x].setPoint = 15 + (x * 7) % 9;
+    }
+    plans[1].name = "one entry";
+    plans[1].utcOffset = 330;
+    plans[1].count = 1;
+    plans[1].entries[0].minute = 5000;
+    plans[1].entries[0].setPoint = 19;
+    plans[2].name = "week edges";
+    plans[2].utcOffset = 840;
+    plans[2].count = 2;
+    plans[2].entries[0].minute = 0;
+    plans[2].entries[0].setPoint = 17;
+    plans[2].entries[1].minute = MINUTES_PER_WEEK - 1;
+    plans[2].entries[1].setPoint = 22;
+    plans[3].name = "one a day";
+    plans[3].utcOffset = -720;
+    plans[3].count = 7;
+    for (x = 0; x < 7; x++) {
+        plans[3].entries[x].minute = x * 1440 + 6 * 60 + 30;
+        plans[3].entries[x].setPoint = 16 + x;
+    }
+}
+
+int main(void) {
+    long long utc;
+    int x, y, entry;
+    long before;
+
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostAdvance(HOST_CYCLES_PER_SECOND);
+    checkMalformed();
+    // a fixed model, so preheatMinutes() has something to say
+    modelMinutes = MODEL_MIN_MINUTES;
+    modelTheta[0] = 1 << 14;
+    modelTheta[1] = 0;
+    modelTheta[2] = 0;
+    modelLastTemp = 0;
+    printf("preheat %d minutes to 20, %d to 24\n", preheatMinutes(20), preheatMinutes(24));
+    HOST_CHECK(preheatMinutes(24) > 0);
+    makePlans();
+
+    for (x = 0; x < 4; x++) {
+        before = wrong;
+        upload(&plans[x]);
+        setPointOverride = false;
+        // the year, a minute at a time, half way through each minute
+        for (utc = START + 30; utc < END; utc += 60) {
+            check(&plans[x], utc);
+        }
+        printf("%-11s UTC%+4d min: %lld minutes, %ld wrong\n", plans[x].name, plans[x].utcOffset,
+               (END - START) / 60, wrong - before);
+
+        // every minute of a week by the search alone, on its first and last second
+        for (y = 0; y < MINUTES_PER_WEEK; y++) {
+            for (utc = START + y * 60LL; utc < START + (y + 1) * 60LL; utc += 59) {
+                scheduleMinute = -1;
+                check(&plans[x], utc);
+                expected(&plans[x], utc, &entry);
+                HOST_CHECK(scheduleCursor == entry);
+            }
+        }
+        // and jumps of the clock forwards and back
+        srand(x + 1);
+        utc = START;
+        for (y = 0; y < JUMPS; y++) {
+            utc += (long long)(rand() % (4 * 86400)) - 86400;
+            if (utc < START) {
+                utc = START;
+            }
+            check(&plans[x], utc);
+        }
+    }
+    printf("%ld times checked in all, %ld wrong\n", checked, wrong);
+    HOST_CHECK(wrong == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all schedule checks hold" : "schedule checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
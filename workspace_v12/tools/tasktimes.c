@@ -0,0 +1,143 @@
+/*
+ *  ======== tasktimes.c ========
+ */
+
+// Problem Description:
+//
+// wcet.txt gives schedcheck the worst case time of every task. Some of
+// those were the time the task's lines took on the wire when DISPLAY()
+// still waited for the UART; now a line is formatted into the ring and
+// the task goes on, and a save waits for the file system's commit
+// instead. The figures were never measured again.
+
+// Solution:
+//
+// Every entry of tasks[] is wrapped so the harness sees each run of each
+// task: the simulated time it held the loop, which is what the drivers
+// block for, and the bytes it put in the UART ring. The firmware runs on
+// the host stand-ins for a day and a bit, past the daily summary, with the
+// setPoint stepped every ten minutes so the state is saved, and rollup
+// queries of every level and M coming in over the UART. A task's worst
+// case is taken as its longest simulated time plus FORMAT_CYCLES_PER_BYTE
+// for the most bytes it put in the ring in one run, which has to be
+// within the figure wcet.txt gives it.
+//
+// Build:   make -C tools tasktimes
+// Usage:   tasktimes [wcet.txt]
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define FORMAT_CYCLES_PER_BYTE 80   // snprintf() and the copy into the ring on the M4, an upper estimate
+#define COMMANDS 6
+
+struct measured {
+    const char *name;
+    void (*run)();
+    uint64_t cycles;                // longest simulated time of a run
+    uint32_t bytes;                 // most bytes put in the ring by a run
+    long annotated;                 // us from wcet.txt, -1 for none
+};
+
+static struct host_tmp102 tmp102;
+// in the order of tasks[]
+static struct measured measured[NUMBER_OF_TASKS] = {
+    {.name = "changeTempSetPoint", .run = changeTempSetPoint},
+    {.name = "startConversion", .run = startConversion},
+    {.name = "updateTemp", .run = updateTemp},
+    {.name = "oneSecondTasks", .run = oneSecondTasks},
+    {.name = "updateActivity", .run = updateActivity},
+    {.name = "serviceCommand", .run = serviceCommand},
+    {.name = "serviceI2C", .run = serviceI2C}
+};
+
+static void measure(int task) {
+    uint64_t start = hostNow;
+    uint32_t queued = txQueued;
+    measured[task].run();
+    if (hostNow - start > measured[task].cycles) {
+        measured[task].cycles = hostNow - start;
+    }
+    if (txQueued - queued > measured[task].bytes) {
+        measured[task].bytes = txQueued - queued;
+    }
+}
+
+static void run0(void) { measure(0); }
+static void run1(void) { measure(1); }
+static void run2(void) { measure(2); }
+static void run3(void) { measure(3); }
+static void run4(void) { measure(4); }
+static void run5(void) { measure(5); }
+static void run6(void) { measure(6); }
+static void (*const wrappers[NUMBER_OF_TASKS])(void) = {run0, run1, run2, run3, run4, run5, run6};
+
+/*
+ * The us wcet.txt gives each task
+ */
+static void readAnnotations(const char *path) {
+    char text[256], name[64];
+    long us;
+    int x;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(2);
+    }
+    while (fgets(text, sizeof text, file) != NULL) {
+        if (sscanf(text, "%63s %ld", name, &us) != 2) {
+            continue;
+        }
+        for (x = 0; x < NUMBER_OF_TASKS; x++) {
+            if (strcmp(measured[x].name, name) == 0) {
+                measured[x].annotated = us;
+            }
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv) {
+    static const char *const commands[COMMANDS] = {"Rs60\r", "Rm60\r", "Rq96\r", "Rh168\r", "M\r", "X\r"};
+    int second, x;
+
+    for (x = 0; x < NUMBER_OF_TASKS; x++) {
+        measured[x].annotated = -1;
+    }
+    readAnnotations(argc > 1 ? argv[1] : "wcet.txt");
+    for (x = 0; x < NUMBER_OF_TASKS; x++) {
+        HOST_CHECK(tasks[x].f == measured[x].run);
+        tasks[x].f = wrappers[x];
+    }
+
+    hostTemperature = START_TEMP - 2.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostBoot();
+    for (second = 0; second < 86400 + 5; second++) {
+        if (second % 600 == 300) {
+            hostGpioEdge(second % 1200 == 300 ? CONFIG_GPIO_BUTTON_0 : CONFIG_GPIO_BUTTON_1);
+        }
+        if (second % 7 == 3) {
+            hostUartInput(commands[second / 7 % COMMANDS]);
+        }
+        hostRun(HOST_CYCLES_PER_SECOND);
+    }
+    printf("%d state saves, %lu lines dropped\n", (int)storeWrites, (unsigned long)txDropped);
+    HOST_CHECK(storeWrites > 100);
+    HOST_CHECK(txDropped == 0);
+
+    printf("task                  blocked us   ring bytes   worst us   wcet.txt us\n");
+    for (x = 0; x < NUMBER_OF_TASKS; x++) {
+        double blocked = measured[x].cycles / (double)HOST_CYCLES_PER_US;
+        double worst = (measured[x].cycles + (uint64_t)measured[x].bytes * FORMAT_CYCLES_PER_BYTE)
+            / (double)HOST_CYCLES_PER_US;
+        printf("%-20s %11.1f %12lu %10.1f %13ld\n", measured[x].name, blocked, (unsigned long)measured[x].bytes,
+               worst, measured[x].annotated);
+        HOST_CHECK(measured[x].annotated >= worst);
+    }
+
+    printf("%s\n", hostFailures == 0 ? "all task time checks hold" : "task time checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/*
+ *  ======== telemetry.c ========
+ */
+
+// Problem Description:
+//
+// With TELEMETRY_BY_EXCEPTION sendToUART() only sends a line when the
+// temperature, setPoint or heat changed, or HEARTBEAT_SECONDS after the
+// last one, where it used to send one every second. The saving depends on
+// how often a real room crosses a whole degree or switches the heat, and a
+// receiver that holds the last values must still see every change.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 in a simple room:
+// the heater's duty warms it, the outside, swinging over the day, cools it
+// with an hour's time constant, and the setPoint is stepped in the morning
+// and the evening. The harness takes a day of UART output and holds the
+// values of each telemetry line like a receiver would. Each time the
+// firmware's seconds move on it checks that the last line queued has the
+// firmware's values, so a change is never more than a second late, and
+// at the end that every line queued reached the receiver. It counts the telemetry lines and bytes against the
+// 1 Hz stream, which is a line every second, and reports all UART bytes.
+//
+// Build:   make -C tools telemetry
+// Usage:   telemetry
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAY 86400
+#define OUTSIDE 8.0                 // degrees C, the mean of the day
+#define OUTSIDE_SWING 5.0           // degrees either way over the day
+#define LOSS (1.0 / 3600)           // of the difference to the outside a second
+#define HEATER (25.0 / 3600)        // degrees a second at full duty, holds 33 degrees
+#define MORNING (7 * 3600)          // the setPoint goes up two degrees
+#define EVENING (22 * 3600)         // and back down
+
+static struct host_tmp102 tmp102;
+static int heldTemp, heldSetPoint, heldHeat, heldSeconds = -1;
+static uint32_t frames, longestGap;
+static uint64_t frameBytes, fixedBytes;
+static int checkedSeconds, stale;
+
+/*
+ * A line from the firmware: a telemetry line is held, the others are
+ * diagnostics
+ */
+static void line(const char *text) {
+    int temp, point, heat, secs;
+    if (sscanf(text, "<%d,%d,%d,%d>", &temp, &point, &heat, &secs) != 4) {
+        return;
+    }
+    if (heldSeconds >= 0 && (uint32_t)(secs - heldSeconds) > longestGap) {
+        longestGap = secs - heldSeconds;
+    }
+    heldTemp = temp;
+    heldSetPoint = point;
+    heldHeat = heat;
+    heldSeconds = secs;
+    frames++;
+    frameBytes += strlen(text) + 2;
+}
+
+/*
+ * On every DWT_CYCCNT read: the first one after oneSecondTasks() has moved
+ * seconds on comes after sendToUART(), which has to have queued a line
+ * with the firmware's values unless the last one still holds them
+ */
+static void counterRead(void) {
+    int moved = temperature - reportedTemp;
+    if (seconds == checkedSeconds) {
+        return;
+    }
+    checkedSeconds = seconds;
+    if (moved >= TELEMETRY_DEADBAND || -moved >= TELEMETRY_DEADBAND
+            || reportedSetPoint != setPoint || reportedHeat != HEAT_STATE) {
+        stale++;
+    }
+}
+
+/*
+ * Press a button count times, a pass apart
+ */
+static void press(uint_least8_t button, int count) {
+    while (count-- > 0) {
+        hostGpioEdge(button);
+        hostRun(GLOBAL_PERIOD * HOST_CYCLES_PER_MS);
+    }
+}
+
+int main(void) {
+    uint64_t uartBefore;
+    uint32_t linesBefore;
+    int second, heatChanges = 0, lastHeat;
+    char fixedLine[64];
+
+    hostTemperature = 18.0;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostRun(5 * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(TELEMETRY_BY_EXCEPTION);
+    press(CONFIG_GPIO_BUTTON_1, START_TEMP - 19);
+    frames = 0;
+    frameBytes = 0;
+    longestGap = 0;
+    uartBefore = hostUartBytes;
+    linesBefore = telemetryLines;
+    lastHeat = HEAT_STATE;
+    checkedSeconds = seconds;
+    hostCounterRead = counterRead;
+
+    for (second = 0; second < DAY; second++) {
+        double outside = OUTSIDE + OUTSIDE_SWING * sin(2 * M_PI * (second - 9 * 3600) / DAY);
+        double duty = hostPwmDuty / 4294967296.0;
+        hostTemperature += HEATER * duty - LOSS * (hostTemperature - outside);
+        if (second == MORNING) {
+            press(CONFIG_GPIO_BUTTON_0, 2);
+        } else if (second == EVENING) {
+            press(CONFIG_GPIO_BUTTON_1, 2);
+        }
+        hostRun(HOST_CYCLES_PER_SECOND);
+        // the fixed cadence sends this line every second
+        fixedBytes += snprintf(fixedLine, sizeof fixedLine, "<%02d,%02d,%d,%04d>\n\r", temperature,
+                               setPoint, HEAT_STATE, seconds);
+        heatChanges += (int)HEAT_STATE != lastHeat;
+        lastHeat = HEAT_STATE;
+    }
+
+    printf("a day: %lu frames, %lu bytes of telemetry; 1 Hz: %d frames, %lu bytes (%.1f%%)\n",
+           (unsigned long)frames, (unsigned long)frameBytes, DAY, (unsigned long)fixedBytes,
+           100.0 * frameBytes / fixedBytes);
+    printf("all UART output %lu bytes a day, %d heat changes, longest gap %lu s, receiver stale %d times\n",
+           (unsigned long)(hostUartBytes - uartBefore), heatChanges, (unsigned long)longestGap, stale);
+    HOST_CHECK(frames >= DAY / HEARTBEAT_SECONDS);
+    HOST_CHECK(frameBytes * 10 < fixedBytes);
+    HOST_CHECK(longestGap <= HEARTBEAT_SECONDS);
+    HOST_CHECK(stale == 0);
+    // and every line queued reached the receiver
+    HOST_CHECK(frames == telemetryLines - linesBefore);
+    HOST_CHECK(txDropped == 0);
+    HOST_CHECK(heldTemp == reportedTemp && heldSetPoint == reportedSetPoint && heldHeat == (int)reportedHeat);
+    HOST_CHECK(heatChanges > 0);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all telemetry checks hold" : "telemetry checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
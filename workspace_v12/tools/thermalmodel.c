@@ -0,0 +1,176 @@
+/*
+ *  ======== thermalmodel.c ========
+ */
+
+// Problem Description:
+//
+// updateModel() fits heating, loss and drift to the minute rollups by
+// recursive least squares in integer arithmetic, and preheatMinutes()
+// runs the fit forward to say when the heat has to come on for the next
+// schedule entry. Whether the fit finds a real room's figures, how long it
+// takes, and whether the room is then warm when the entry starts, was
+// never measured.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP102 in a room of
+// known heating and loss to a steady outside, with a weekly schedule of
+// 21 degrees from 06:30 to 22:00 and 16 overnight on a synced clock. Each
+// hour the harness compares the fit with the room's own figures per
+// minute and takes the hour from which it stays close to them, which has
+// to be within the first day. At the end preheatMinutes() must also be
+// close to the minutes the room really takes at full heat, worked out in
+// double precision. Each morning after the first it takes the time the
+// room reaches the entry's setPoint, less half a degree, against 06:30.
+//
+// Build:   make -C tools thermalmodel
+// Usage:   thermalmodel
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAYS 7
+#define START 1703462400LL          // 2023-12-25 00:00 UTC, a Monday
+#define OUTSIDE 8.0                 // degrees C
+#define LOSS (1.0 / 3600)           // of the difference to the outside a second
+#define HEATER (25.0 / 3600)        // degrees a second at full duty
+#define MORNING (6 * 60 + 30)       // minute of the day the warm entry starts
+#define EVENING (22 * 60)
+#define WARM 21
+#define COOL 16
+
+static struct host_tmp102 tmp102;
+
+/*
+ * Upload a schedule of WARM from MORNING to EVENING and COOL overnight,
+ * every day, through B lines and U
+ */
+static void uploadSchedule(void) {
+    uint8_t blob[SCHEDULE_BLOB_SIZE];
+    char hex[COMMAND_LENGTH];
+    int length = 0, day, sent;
+    uint16_t crc;
+    blob[length++] = 14;
+    blob[length++] = 0;
+    blob[length++] = 0;
+    for (day = 0; day < 7; day++) {
+        int minutes[2] = {day * 1440 + MORNING, day * 1440 + EVENING};
+        int x;
+        for (x = 0; x < 2; x++) {
+            blob[length++] = (uint8_t)minutes[x];
+            blob[length++] = (uint8_t)(minutes[x] >> 8);
+            blob[length++] = x == 0 ? WARM : COOL;
+        }
+    }
+    crc = crc16(blob, length);
+    blob[length++] = (uint8_t)crc;
+    blob[length++] = (uint8_t)(crc >> 8);
+    for (sent = 0; sent < length;) {
+        int bytes = 0;
+        while (sent < length && bytes < (COMMAND_LENGTH - 2) / 2) {
+            snprintf(&hex[bytes * 2], 3, "%02X", blob[sent++]);
+            bytes++;
+        }
+        addScheduleBytes(hex);
+        hostAdvance(10 * HOST_CYCLES_PER_MS);
+    }
+    useSchedule();
+    hostAdvance(10 * HOST_CYCLES_PER_MS);
+    HOST_CHECK(activeSchedule != NULL && activeSchedule->count == 14);
+}
+
+/*
+ * The fit is within 10% of the room's heating and 25% of its loss and
+ * drift
+ */
+static bool fitClose(double heating, double loss, double drift) {
+    return fabs(modelTheta[0] / 65536.0 - heating) <= 0.1 * heating
+        && fabs(modelTheta[1] / 65536.0 - loss) <= 0.25 * -loss
+        && fabs(modelTheta[2] / 65536.0 - drift) <= 0.25 * -drift;
+}
+
+/*
+ * Minutes the room takes at full heat from degrees now to target
+ */
+static double roomMinutes(double now, double target) {
+    double settle = OUTSIDE + HEATER / LOSS;
+    return log((settle - now) / (settle - target)) / LOSS / 60;
+}
+
+int main(void) {
+    double heating = HEATER * 60, loss = -LOSS * 60, drift = LOSS * 60 * (OUTSIDE - MODEL_REFERENCE / 128.0);
+    double now, worstLate = 0, worstEarly = 0;
+    int second, day, minuteOfDay, x, closeFrom = -1;
+    bool waiting = false;
+    int predicted, targets[3] = {WARM, WARM + 2, WARM + 4};
+
+    hostTemperature = COOL;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostBoot();
+    hostAdvance(HOST_CYCLES_PER_SECOND);
+    // synced to the start of a Monday, UTC
+    skewPpb = 0;
+    syncDevice = timeMicros();
+    syncWall = (uint64_t)START * 1000000;
+    synced = true;
+    uploadSchedule();
+
+    for (second = 0; second < DAYS * 86400; second++) {
+        double duty = hostPwmDuty / 4294967296.0;
+        hostTemperature += HEATER * duty - LOSS * (hostTemperature - OUTSIDE);
+        hostRun(HOST_CYCLES_PER_SECOND);
+        day = second / 86400;
+        minuteOfDay = second % 86400 / 60;
+        if (second % 86400 == MORNING * 60 - 4 * 3600) {
+            waiting = true;
+        }
+        if (waiting && hostTemperature >= WARM - 0.5) {
+            // minutes after the entry started, negative if before
+            double late = (second % 86400) / 60.0 - MORNING;
+            waiting = false;
+            if (day > 0) {
+                printf("day %d: %.1f degrees at %02d:%02d, %+.1f minutes against %02d:%02d\n", day,
+                       hostTemperature, minuteOfDay / 60, minuteOfDay % 60, late, MORNING / 60, MORNING % 60);
+                worstLate = late > worstLate ? late : worstLate;
+                worstEarly = late < worstEarly ? late : worstEarly;
+            }
+        }
+        if (second % 3600 == 3599) {
+            if (!fitClose(heating, loss, drift)) {
+                closeFrom = -1;
+            } else if (closeFrom < 0) {
+                closeFrom = second / 3600 + 1;
+            }
+        }
+        if (second % (86400 / 2) == 0 && second > 0) {
+            printf("  %2d h: heating %+.4f loss %+.5f drift %+.4f degree/minute\n", second / 3600,
+                   modelTheta[0] / 65536.0, modelTheta[1] / 65536.0, modelTheta[2] / 65536.0);
+        }
+    }
+
+    printf("room: heating %+.4f loss %+.5f drift %+.4f degree/minute, the fit close to it from hour %d\n",
+           heating, loss, drift, closeFrom);
+    HOST_CHECK(modelMinutes >= MODEL_MIN_MINUTES);
+    HOST_CHECK(closeFrom >= 0 && closeFrom <= 24);
+
+    now = (modelLastTemp / 32.0 + MODEL_REFERENCE) / 128;
+    for (x = 0; x < 3; x++) {
+        double minutes = roomMinutes(now, targets[x]);
+        predicted = preheatMinutes(targets[x]);
+        printf("from %.2f to %d degrees: preheat %d minutes, the room takes %.1f\n", now, targets[x],
+               predicted, minutes);
+        HOST_CHECK(fabs(predicted - minutes) <= 0.1 * minutes + 2);
+    }
+    // the room is warm close to the entry every morning once the model is in use
+    printf("mornings: at worst %.1f minutes early, %.1f minutes late\n", -worstEarly, worstLate);
+    HOST_CHECK(worstLate <= 5);
+    HOST_CHECK(worstEarly >= -10);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all thermal model checks hold" : "thermal model checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
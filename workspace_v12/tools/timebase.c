@@ -0,0 +1,177 @@
+/*
+ *  ======== timebase.c ========
+ */
+
+// Problem Description:
+//
+// timeCycles() extends the 32 bit DWT_CYCCNT, which wraps every 53s, to
+// 64 bits from the two time base slots timerCallback() writes, and the
+// seconds count, the telemetry time and the button reaction time all come
+// from it. A slip at a wrap, or a read torn by the timer interrupt, would
+// only show after weeks on a board, as a clock that drifts or jumps.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins for four weeks, some 45000
+// wraps, with a button pressed every hour, while an extra timer interrupt
+// cuts into one DWT_CYCCNT read in 64 wherever it is. Every minute the
+// seconds count, timeCycles() and the time of each telemetry line must be
+// exactly the host's time since boot, and no press may have taken longer
+// than a pass. Then the harness stresses the reader and writer against
+// each other: timeCycles() with updateTimeBase() cutting into its read,
+// and updateTimeBase() with timeCycles() cutting into its own, at random
+// steps of up to most of a wrap and at steps that end on either side of
+// one. Every read must be the host's count and never go backwards.
+//
+// Build:   make -C tools timebase
+// Usage:   timebase
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define WEEKS 4
+#define MINUTES (WEEKS * 7 * 24 * 60)
+#define WRAP (1ULL << 32)
+#define STRESS_STEPS 2000000
+
+enum preempt {NOBODY, TIMER_IN_FIRMWARE, WRITER_IN_READER, READER_IN_WRITER};
+
+static struct host_tmp102 tmp102;
+static uint64_t offset;             // hostNow less timeCycles()
+static enum preempt mode = NOBODY;
+static int preempts;
+static uint32_t writerCutIns, readerCutIns;
+static uint64_t lastRead;
+static int lines, badLines;
+
+/*
+ * Cycles since initProfiler() by the host clock
+ */
+static uint64_t expected(void) {
+    return hostNow - offset;
+}
+
+/*
+ * Check a timeCycles() read against the host and the read before it
+ */
+static void checkRead(uint64_t read) {
+    HOST_CHECK(read == expected());
+    HOST_CHECK(read >= lastRead);
+    lastRead = read;
+}
+
+/*
+ * On every DWT_CYCCNT read, the interrupt that cuts in at it
+ */
+static void counterRead(void) {
+    switch (mode) {
+        case TIMER_IN_FIRMWARE:
+            if (rand() % 64 == 0) {
+                updateTimeBase();
+            }
+            break;
+        case WRITER_IN_READER:
+            // at most twice, or the reader would never finish
+            if (preempts < 2 && rand() % 2 == 0) {
+                preempts++;
+                writerCutIns++;
+                updateTimeBase();
+            }
+            break;
+        case READER_IN_WRITER:
+            if (rand() % 2 == 0) {
+                readerCutIns++;
+                checkRead(timeCycles());
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * A telemetry line carries the whole seconds since initProfiler()
+ */
+static void line(const char *text) {
+    int temp, point, heat, secs;
+    int now = (int)(expected() / HOST_CYCLES_PER_SECOND);
+    if (sscanf(text, "<%d,%d,%d,%d>", &temp, &point, &heat, &secs) != 4) {
+        return;
+    }
+    lines++;
+    // it leaves the transmit ring a little after it was made
+    if (secs > now || secs < now - 1) {
+        badLines++;
+    }
+}
+
+/*
+ * Move on by step and let the writer run, as timerCallback() does, then
+ * read after cycles more. The time base must not be a wrap old by then.
+ */
+static void stressStep(uint64_t step, uint64_t after) {
+    hostNow += step;
+    mode = READER_IN_WRITER;
+    updateTimeBase();
+    mode = WRITER_IN_READER;
+    preempts = 0;
+    hostNow += after;
+    checkRead(timeCycles());
+    mode = NOBODY;
+}
+
+int main(void) {
+    uint64_t span;
+    int minute, x, behind;
+
+    hostTemperature = START_TEMP - 2.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    offset = hostNow - timeCycles();
+    srand(1);
+
+    mode = TIMER_IN_FIRMWARE;
+    hostCounterRead = counterRead;
+    for (minute = 1; minute <= MINUTES; minute++) {
+        if (minute % 60 == 0) {
+            hostGpioEdge(minute % 120 == 0 ? CONFIG_GPIO_BUTTON_0 : CONFIG_GPIO_BUTTON_1);
+        }
+        hostRun(60 * HOST_CYCLES_PER_SECOND);
+        HOST_CHECK(timeCycles() == expected());
+        // on the second the 1 s task has not yet counted
+        behind = (int)(expected() / HOST_CYCLES_PER_SECOND) - seconds;
+        HOST_CHECK(behind == 0 || behind == 1);
+    }
+    mode = NOBODY;
+    printf("%d weeks, %lu wraps of DWT_CYCCNT: seconds %d, %d telemetry lines, %d with the wrong time\n", WEEKS,
+           (unsigned long)(expected() / WRAP), seconds, lines, badLines);
+    printf("longest press to heater %.1f us, longest pass %.1f us\n", maxReaction / (double)HOST_CYCLES_PER_US,
+           hostLongestPass / (double)HOST_CYCLES_PER_US);
+    HOST_CHECK(lines > 0);
+    HOST_CHECK(badLines == 0);
+    HOST_CHECK(maxReaction <= hostLongestPass);
+
+    // no more passes from here: the time base is only written by stressStep()
+    lastRead = timeCycles();
+    for (x = 0; x < STRESS_STEPS; x++) {
+        uint64_t step = (uint64_t)rand() * (WRAP / 2) / RAND_MAX * 2 / 3;
+        stressStep(step, step / 2);
+    }
+    // writes and reads just before, on and just after a wrap of the counter
+    for (x = 0; x < 1000; x++) {
+        uint64_t low = expected() % WRAP;
+        stressStep((WRAP - low) / 2, 0);
+        low = expected() % WRAP;
+        stressStep(WRAP - low - 2 + x % 5, x % 7);
+    }
+    span = expected();
+    printf("%d steps to %lu s: the writer cut into a read %lu times, a reader into the writer %lu times\n",
+           STRESS_STEPS + 2000, (unsigned long)(span / HOST_CYCLES_PER_SECOND), (unsigned long)writerCutIns,
+           (unsigned long)readerCutIns);
+
+    printf("%s\n", hostFailures == 0 ? "all time base checks hold" : "time base checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
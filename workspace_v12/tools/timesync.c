@@ -0,0 +1,179 @@
+/*
+ *  ======== timesync.c ========
+ */
+
+// Problem Description:
+//
+// timeSync() takes the host's S<epoch ms> answer to <S> as stamped half
+// way through the round trip and averages the drift between syncs into
+// skewPpb. A real host answers late and unevenly, over a UART that takes
+// its own time, and sometimes with a line that is not a number at all;
+// how close the device's wall clock then stays, and that a bad line is
+// refused, was never measured.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins for two days against a peer
+// whose clock runs SKEW_PPB fast. The peer answers each <S> after a delay
+// with jitter, stamps its clock then, and the answer takes another
+// delay with jitter to start arriving; one answer in ten is slower than
+// SYNC_MAX_RTT_US. After each answer the harness compares the device's
+// wall clock with the peer's. It checks that slow answers are dropped,
+// that skewPpb finds the skew, that the wall clock stays within the
+// jitter of the peer's, also for an <S> that waits behind a block of
+// lines, and that lines with no digits, junk after them, a sign or too
+// many digits are answered with <E> and move nothing.
+//
+// Build:   make -C tools timesync
+// Usage:   timesync
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define DAYS 2
+#define EPOCH_MS 1760000000000ULL  // the peer's clock at power on
+#define SKEW_PPB 37000              // the peer's clock is 37ppm fast
+#define DELAY_US 2000               // each way, before the jitter
+#define JITTER_US 3000              // up to, each way
+#define SLOW_US 30000               // the delay of a slow answer
+#define SLOW_EVERY 10
+#define BLOCK_LINES 10              // of 60 bytes queued ahead of an <S>
+
+static struct host_tmp102 tmp102;
+static int requests, answers, slow, errors, clocks;
+static char answer[32];
+static double worstWall, sumWall;
+static int comparedWall;
+static bool peerAnswers = true;
+static bool neverSlow = false;
+
+/*
+ * The peer's clock, in epoch microseconds
+ */
+static double peerMicros(void) {
+    return EPOCH_MS * 1000.0 + hostNow / (double)HOST_CYCLES_PER_US * (1 + SKEW_PPB * 1e-9);
+}
+
+static uint64_t jitter(void) {
+    return (uint64_t)rand() * JITTER_US / RAND_MAX * HOST_CYCLES_PER_US;
+}
+
+static void arrive(void *arg) {
+    hostUartInput(answer);
+}
+
+/*
+ * The peer reads its clock and sends the answer, which starts arriving
+ * after the delay back
+ */
+static void stamp(void *arg) {
+    uint64_t back = DELAY_US * HOST_CYCLES_PER_US + jitter();
+    if (++answers % SLOW_EVERY == 0 && !neverSlow) {
+        back = SLOW_US * HOST_CYCLES_PER_US;
+        slow++;
+    }
+    snprintf(answer, sizeof answer, "S%llu\r", (unsigned long long)(peerMicros() / 1000));
+    hostSchedule(hostNow + back, arrive, NULL);
+}
+
+static void line(const char *text) {
+    if (strcmp(text, "<S>") == 0 && peerAnswers) {
+        requests++;
+        // from when the line has arrived, not when its write started
+        hostSchedule(hostUartLineSent + DELAY_US * HOST_CYCLES_PER_US + jitter(), stamp, NULL);
+    } else if (strcmp(text, "<E>") == 0) {
+        errors++;
+    } else if (strncmp(text, "<C,", 3) == 0) {
+        clocks++;
+    }
+}
+
+/*
+ * A sync whose <S> waits in the ring behind a block of lines longer on the
+ * wire than SYNC_MAX_RTT_US: the round trip starts once <S> has gone out,
+ * so the answer is taken and the wall clock is as close as ever
+ */
+static void behindBlock(void) {
+    int before = clocks, x;
+    double error;
+    neverSlow = true;
+    for (x = 0; x < BLOCK_LINES; x++) {
+        DISPLAY(snprintf(output, 64, "<Q,%02d,%052d>\n\r", x, 0))
+    }
+    requestTimeSync();
+    hostRun(300 * HOST_CYCLES_PER_MS);
+    error = fabs((double)wallMicros(timeMicros()) - peerMicros());
+    printf("behind %d bytes: round trip %lu us, wall clock off by %.0f us\n", BLOCK_LINES * 60,
+           (unsigned long)syncRtt, error);
+    HOST_CHECK(clocks == before + 1);
+    HOST_CHECK(error <= JITTER_US);
+    neverSlow = false;
+}
+
+/*
+ * Send a line that is not a good answer while a sync waits for one: it is
+ * refused with <E> and the clock does not move
+ */
+static void refused(const char *text) {
+    uint64_t wall = syncWall;
+    int before = errors;
+    requestTimeSync();
+    hostUartInput(text);
+    // serviceCommand() runs every COMMAND_PERIOD, then <E> goes out
+    hostRun((COMMAND_PERIOD + 20) * HOST_CYCLES_PER_MS);
+    HOST_CHECK(errors == before + 1);
+    HOST_CHECK(syncWall == wall);
+    HOST_CHECK(syncPending);
+}
+
+int main(void) {
+    int second;
+    double error;
+
+    hostTemperature = START_TEMP - 2.5;
+    hostNoise = 0.05;
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    srand(1);
+
+    for (second = 0; second < DAYS * 86400; second++) {
+        int before = clocks;
+        hostRun(HOST_CYCLES_PER_SECOND);
+        if (clocks != before && skewKnown) {
+            // the device's wall clock against the peer's, now
+            error = fabs((double)wallMicros(timeMicros()) - peerMicros());
+            sumWall += error;
+            comparedWall++;
+            if (error > worstWall) {
+                worstWall = error;
+            }
+        }
+    }
+    printf("%d days: %d requests, %d answers, %d slow, %d taken\n", DAYS, requests, answers, slow, clocks);
+    printf("skew %ld ppb against %d ppb, wall clock off by %.0f us on average, %.0f us at worst\n",
+           (long)skewPpb, SKEW_PPB, sumWall / comparedWall, worstWall);
+    HOST_CHECK(errors == 0);
+    HOST_CHECK(requests == DAYS * 86400 / SYNC_PERIOD);
+    HOST_CHECK(clocks == answers - slow);
+    HOST_CHECK(syncRtt <= SYNC_MAX_RTT_US);
+    HOST_CHECK(labs((long)skewPpb - SKEW_PPB) <= 2000);
+    // the midpoint is off by half the difference of the two delays
+    HOST_CHECK(worstWall <= JITTER_US);
+    behindBlock();
+
+    peerAnswers = false;
+    refused("S\r");
+    refused("S12x\r");
+    refused("S 1760000000000\r");
+    refused("S-1760000000000\r");
+    refused("S+1760000000000\r");
+    refused("S99999999999999999999\r");
+    printf("%d bad answers refused\n", errors);
+
+    printf("%s\n", hostFailures == 0 ? "all time sync checks hold" : "time sync checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ *  ======== tmp116events.c ========
+ */
+
+// Problem Description:
+//
+// In TMP116 event mode the firmware only reads the sensor when ALERT says
+// the temperature left the window around the last reading. That is meant
+// to take the I2C traffic close to zero while the room is steady without
+// making a change wait, and a dead ALERT line must not leave the
+// thermostat on an old temperature.
+
+// Solution:
+//
+// The firmware runs on the host stand-ins with a TMP116 model at 0x49 that
+// converts on its configured cycle and drives ALERT onto
+// CONFIG_GPIO_TMP_ALERT. The harness counts the transfers per minute of a
+// steady room against the read a sample polling would take, times how
+// long a step takes to reach temperature through ALERT, then breaks the
+// ALERT line and checks that a check read catches the missed step and the
+// fallback reads follow the next one, and that ALERT takes over again
+// once it works.
+//
+// Build:   make -C tools tmp116events
+// Usage:   tmp116events
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define STEP_US 10000               // resolution of the step timing
+#define CONVERSION_S 1.0            // TMP116_CONFIG's conversion cycle
+#define SETTLE_S 10                 // longer than any settle() here
+
+// one check read every TMP116_CHECK_SAMPLES and nothing else
+#define STEADY_TRANSFERS (60000.0 / (TMP116_CHECK_SAMPLES * TEMP_PERIOD) + 1)
+
+static struct host_tmp116 tmp116;
+
+/*
+ * Seconds the median and the IIR take to bring a step of degrees within
+ * TMP116_SETTLED, after which the firmware stops reading every sample
+ */
+static double settle(double degrees) {
+    double decay = 1.0 - 1.0 / (1 << TEMP_IIR_SHIFT);
+    double samples = ceil(log(fabs(degrees) * 128 / TMP116_SETTLED) / -log(decay));
+    return (samples + TEMP_MEDIAN_TAPS / 2) * TEMP_PERIOD / 1000.0;
+}
+
+/*
+ * Step the room to degrees and return the seconds until the firmware's
+ * temperature shows it, or limit if it never does
+ */
+static double step(double degrees, double limit) {
+    uint64_t start = hostNow;
+    hostTemperature = degrees;
+    while (temperature != (int)degrees && hostNow - start < limit * HOST_CYCLES_PER_SECOND) {
+        hostRun(STEP_US * HOST_CYCLES_PER_US);
+    }
+    return (hostNow - start) / (double)HOST_CYCLES_PER_SECOND;
+}
+
+/*
+ * I2C transfers per minute over minutes of a steady room, once the filter
+ * has settled on it
+ */
+static double steady(int minutes) {
+    uint32_t transfers;
+    hostRun(SETTLE_S * HOST_CYCLES_PER_SECOND);
+    transfers = hostTransfers;
+    hostRun(minutes * 60 * HOST_CYCLES_PER_SECOND);
+    return (hostTransfers - transfers) / (double)minutes;
+}
+
+int main(void) {
+    double polled = 60000.0 / TEMP_PERIOD;
+    double perMinute, seconds;
+    uint32_t alerts;
+
+    hostTemperature = 20.5;
+    hostAttachTmp116(&tmp116, 0x49, CONFIG_GPIO_TMP_ALERT);
+    hostBoot();
+    hostRun((STORE_PERIOD + 5) * HOST_CYCLES_PER_SECOND);
+    HOST_CHECK(sensor == TMP116_SENSOR);
+    HOST_CHECK(tempEvents);
+    HOST_CHECK(temperature == 20);
+    HOST_CHECK(health == 0);
+
+    // a steady room: only the check reads and their window writes
+    perMinute = steady(10);
+    printf("steady room: %.1f transfers a minute, polling reads %.1f\n", perMinute, polled);
+    HOST_CHECK(perMinute <= STEADY_TRANSFERS);
+    HOST_CHECK(alertMisses == 0);
+
+    // a step comes through ALERT within a conversion and the filter settling
+    alerts = tmp116.alerts;
+    seconds = step(22.5, 60);
+    printf("step through ALERT: %.2f s\n", seconds);
+    HOST_CHECK(tmp116.alerts > alerts);
+    HOST_CHECK(seconds <= CONVERSION_S + settle(2.0));
+    HOST_CHECK(!alertFallback);
+    HOST_CHECK(steady(2) <= STEADY_TRANSFERS);
+
+    // ALERT broken: the next check read catches the step and the reads
+    // fall back to every second
+    tmp116.broken = true;
+    seconds = step(24.5, 120);
+    printf("step with ALERT broken: %.2f s, %lu missed\n", seconds, (unsigned long)alertMisses);
+    HOST_CHECK(alertMisses == 1);
+    HOST_CHECK(alertFallback);
+    HOST_CHECK(seconds <= TMP116_CHECK_SAMPLES * TEMP_PERIOD / 1000.0 + CONVERSION_S + settle(2.0));
+    seconds = step(26.5, 60);
+    printf("step on fallback reads: %.2f s\n", seconds);
+    HOST_CHECK(seconds <= TMP116_FALLBACK_SAMPLES * TEMP_PERIOD / 1000.0 + CONVERSION_S + settle(2.0));
+    perMinute = steady(2);
+    printf("steady room on fallback reads: %.1f transfers a minute\n", perMinute);
+    HOST_CHECK(perMinute >= 60000.0 / (TMP116_FALLBACK_SAMPLES * TEMP_PERIOD));
+    HOST_CHECK(perMinute <= 60000.0 / (TMP116_FALLBACK_SAMPLES * TEMP_PERIOD) + 1);
+
+    // ALERT mended: its next edge ends the fallback
+    tmp116.broken = false;
+    seconds = step(23.5, 60);
+    printf("step with ALERT mended: %.2f s\n", seconds);
+    HOST_CHECK(!alertFallback);
+    HOST_CHECK(seconds <= CONVERSION_S + settle(-3.0));
+    HOST_CHECK(steady(2) <= STEADY_TRANSFERS);
+    HOST_CHECK(health == 0);
+
+    printf("%s\n", hostFailures == 0 ? "all TMP116 event checks hold" : "TMP116 event checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ *  ======== zonefilter.c ========
+ */
+
+// Problem Description:
+//
+// filterZones() runs the IIR of the zones past zone 0 as one SMLAD per
+// zone with no fraction bits, where zone 0's filterTemp() keeps
+// TEMP_IIR_FRACTION of them in 32 bits. The rounding must not leave a zone
+// further from a steady reading than the 2/128 degree it promises, and the
+// batch should cost less per sample than the zone 0 filter.
+
+// Solution:
+//
+// The harness steps a batch of zones through readings across the
+// sensors' range, with noise, and follows each with the zone 0 IIR in
+// double precision. The batch must stay within 2/128 degree of it and
+// settle on a steady reading. The portable smlad() must agree with the
+// SMLAD the target uses, checked on halfword extremes. It then times
+// filterZones() and filterTemp() per sample on the host, which runs the C
+// fallback; on the M4 each zone is a single SMLAD.
+//
+// Build:   make -C tools zonefilter
+// Usage:   zonefilter
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#include <math.h>
+
+#define BATCH 256
+#define STEPS 2000
+#define SETTLE_SAMPLES 40
+#define BENCHMARK_SAMPLES 20000000
+
+static int16_t fine[BATCH];
+static int16_t raw[BATCH];
+static bool sample[BATCH];
+static double reference[BATCH];
+
+/*
+ * smlad() against the instruction's definition in 64 bits, on a and b
+ * made of the halfwords in edges
+ */
+static void checkSmlad(void) {
+    static const int16_t edges[] = {-32768, -32767, -1, 0, 1, 8192, 24576, 32767};
+    int n = sizeof edges / sizeof edges[0];
+    int a, b, c, d;
+    for (a = 0; a < n; a++) {
+        for (b = 0; b < n; b++) {
+            for (c = 0; c < n; c++) {
+                for (d = 0; d < n; d++) {
+                    uint32_t x = ((uint32_t)(uint16_t)edges[a] << 16) | (uint16_t)edges[b];
+                    uint32_t y = ((uint32_t)(uint16_t)edges[c] << 16) | (uint16_t)edges[d];
+                    int64_t exact = 1000 + (int64_t)edges[a] * edges[c] + (int64_t)edges[b] * edges[d];
+                    if (exact >= INT32_MIN && exact <= INT32_MAX) {
+                        HOST_CHECK(smlad(x, y, 1000) == exact);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(void) {
+    double decay = 1.0 - 1.0 / (1 << TEMP_IIR_SHIFT);
+    double worst = 0, error, start, seconds, batch, single;
+    int x, step;
+    volatile int16_t sink;
+    uint32_t samples;
+
+    checkSmlad();
+
+    // readings wander across -40 to 125 degrees with a count of noise
+    srand(1);
+    for (x = 0; x < BATCH; x++) {
+        raw[x] = fine[x] = (int16_t)((x * (165 * 128) / BATCH) - 40 * 128);
+        reference[x] = raw[x];
+        sample[x] = true;
+    }
+    for (step = 0; step < STEPS; step++) {
+        for (x = 0; x < BATCH; x++) {
+            int target = (x * (165 * 128) / BATCH) - 40 * 128 + (step / 100 % 2) * (x % 7 - 3) * 128;
+            raw[x] = (int16_t)(target + rand() % 3 - 1);
+            sample[x] = (rand() % 4) != 0;
+            if (sample[x]) {
+                reference[x] = reference[x] * decay + raw[x] * (1.0 - decay);
+            }
+        }
+        filterZones(fine, raw, sample, BATCH);
+        for (x = 0; x < BATCH; x++) {
+            error = fabs(fine[x] - reference[x]);
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    printf("%d zones over %d steps: worst %.2f/128 degree from the double IIR\n", BATCH, STEPS, worst);
+    HOST_CHECK(worst <= 2.0);
+
+    // a steady reading: every zone ends within 2/128 degree of it
+    for (x = 0; x < BATCH; x++) {
+        raw[x] = (int16_t)(x * 60 - 40 * 128);
+        sample[x] = true;
+    }
+    for (step = 0; step < SETTLE_SAMPLES; step++) {
+        filterZones(fine, raw, sample, BATCH);
+    }
+    for (x = 0; x < BATCH; x++) {
+        HOST_CHECK(abs(fine[x] - raw[x]) <= 2);
+    }
+
+    start = hostSeconds();
+    for (samples = 0; samples < BENCHMARK_SAMPLES; samples += BATCH) {
+        raw[samples / BATCH % BATCH] ^= 1;
+        filterZones(fine, raw, sample, BATCH);
+    }
+    seconds = hostSeconds() - start;
+    batch = seconds * 1e9 / samples;
+    start = hostSeconds();
+    for (samples = 0; samples < BENCHMARK_SAMPLES; samples++) {
+        sink = filterTemp((int16_t)(samples & 0x7FF));
+    }
+    seconds = hostSeconds() - start;
+    (void)sink;
+    single = seconds * 1e9 / samples;
+    printf("filterZones %.2f ns a sample, filterTemp %.2f ns a sample on the host\n", batch, single);
+    HOST_CHECK(batch < single);
+
+    printf("%s\n", hostFailures == 0 ? "all zone filter checks hold" : "zone filter checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}
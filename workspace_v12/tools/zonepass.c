@@ -0,0 +1,223 @@
+/*
+ *  ======== zonepass.c ========
+ */
+
+// Problem Description:
+//
+// controlPass() runs the filter and the PI of every zone in one loop down
+// the struct zone_arrays, and zoneReading() puts a zone's reading through
+// the range and slew checks zone 0 gets from checkHealth(), with
+// ageZones() marking a zone stale. The board only reads ZONE_SENSORS
+// zones on its bus, so how the pass scales to many zones, and what a zone
+// costs in RAM, could not be seen on it.
+
+// Solution:
+//
+// The harness gives the functions its own arrays of up to 256 zones. It
+// checks that a zone with no readings goes stale after MAX_TEMP_AGE
+// samples and takes its next reading as it is, that a spike is dropped, a
+// step taken once HEALTH_SLEW_REJECTS readings agree on it, readings that
+// jump about raise HEALTH_SLEW and one out of range HEALTH_RANGE, and that
+// a zone with a fault has no heat while the others go on. Zones with the
+// same readings must come to the same duty whatever the count. It then
+// times the pass at 1, 16 and 256 zones on the host, where the cost per
+// zone must not grow with the count, and checks the <N> block the
+// firmware sends against the RAM a zone takes.
+//
+// Build:   make -C tools zonepass
+// Usage:   zonepass
+// The exit status is 1 if any check fails.
+
+#include "host.h"
+#include "../project/gpiointerrupt.h"
+
+#define MOST 256
+#define ROOM (20 * 128 + 37)        // 1/128 degree, off the whole degree
+#define BENCHMARK_ZONES 20000000    // zone passes timed at each count
+
+static int16_t fine[MOST], raw[MOST], target[MOST], jumpRaw[MOST];
+static unsigned char zoneHealths[MOST];
+static bool sample[MOST];
+static int32_t integral[MOST], duty[MOST], base[MOST];
+static uint32_t integrated[MOST];
+static uint8_t age[MOST], jumpRejects[MOST], jumpAgreed[MOST];
+static const struct zone_arrays bench = {
+    fine, raw, target, zoneHealths, sample, integral, integrated, duty, base, age, jumpRaw, jumpRejects, jumpAgreed
+};
+static struct host_tmp102 tmp102;
+static int blockZones = -1;
+static unsigned long blockCycles;
+static unsigned blockBytes, blockSensorBytes;
+
+static void line(const char *text) {
+    sscanf(text, "<N,%d,%lu,%u,%u>", &blockZones, &blockCycles, &blockBytes, &blockSensorBytes);
+}
+
+/*
+ * Every zone starts stale at 18 degrees on the way to 21
+ */
+static void reset(void) {
+    int x;
+    for (x = 0; x < MOST; x++) {
+        fine[x] = raw[x] = 18 * 128;
+        target[x] = 21 * 128;
+        zoneHealths[x] = HEALTH_STALE;
+        age[x] = MAX_TEMP_AGE;
+        sample[x] = false;
+        integral[x] = duty[x] = base[x] = 0;
+        integrated[x] = 0;
+        jumpRejects[x] = jumpAgreed[x] = 0;
+    }
+}
+
+/*
+ * A sample of count zones: zone 0 with reading as zone 0 gets it, the
+ * rest through zoneReading(), then the pass at now ms
+ */
+static void pass(int count, int16_t reading, uint32_t now) {
+    int x;
+    ageZones(&bench, count);
+    fine[0] = reading;
+    zoneHealths[0] = 0;
+    sample[0] = true;
+    for (x = 1; x < count; x++) {
+        zoneReading(&bench, x, reading);
+    }
+    controlPass(&bench, count, now);
+}
+
+/*
+ * The range, slew and stale checks on zone 1 of a few, zone 2 alongside
+ * on steady readings
+ */
+static void checkFaults(void) {
+    uint32_t now = 0;
+    int x;
+    reset();
+    for (x = 0; x < 20; x++) {
+        pass(3, ROOM, now += TEMP_PERIOD);
+    }
+    HOST_CHECK(zoneHealths[1] == 0 && zoneHealths[2] == 0);
+    HOST_CHECK(duty[1] > 0);
+
+    // a spike is dropped, the next reading taken
+    HOST_CHECK(!zoneReading(&bench, 1, ROOM + 10 * 128));
+    HOST_CHECK(zoneHealths[1] == 0 && raw[1] == ROOM);
+    HOST_CHECK(zoneReading(&bench, 1, ROOM + 1));
+    HOST_CHECK(jumpRejects[1] == 0);
+
+    // a step is taken once HEALTH_SLEW_REJECTS readings agree on it
+    for (x = 1; x < HEALTH_SLEW_REJECTS; x++) {
+        HOST_CHECK(!zoneReading(&bench, 1, ROOM + 5 * 128 + x));
+    }
+    HOST_CHECK(zoneReading(&bench, 1, ROOM + 5 * 128 + x));
+    HOST_CHECK(zoneHealths[1] == 0 && raw[1] == ROOM + 5 * 128 + x);
+
+    // readings that jump about are a fault: no heat, the other zone goes on
+    for (x = 0; x < HEALTH_SLEW_REJECTS; x++) {
+        HOST_CHECK(!zoneReading(&bench, 1, ROOM + (x % 2 ? 15 : -15) * 128));
+    }
+    HOST_CHECK(zoneHealths[1] & HEALTH_SLEW);
+    controlPass(&bench, 3, now += TEMP_PERIOD);
+    HOST_CHECK(duty[1] == 0 && duty[2] > 0);
+    HOST_CHECK(zoneReading(&bench, 1, ROOM + 5 * 128));
+    HOST_CHECK(zoneHealths[1] == 0);
+
+    // out of range
+    HOST_CHECK(!zoneReading(&bench, 1, HEALTH_MAX_CODE + 1));
+    HOST_CHECK(zoneHealths[1] & HEALTH_RANGE);
+    HOST_CHECK(zoneReading(&bench, 1, ROOM + 5 * 128));
+    HOST_CHECK(zoneHealths[1] == 0);
+
+    // no readings: stale after MAX_TEMP_AGE samples, once
+    for (x = 1; x < MAX_TEMP_AGE; x++) {
+        HOST_CHECK(!ageZones(&bench, 2));
+    }
+    HOST_CHECK(ageZones(&bench, 2));
+    HOST_CHECK(!ageZones(&bench, 2));
+    HOST_CHECK(zoneHealths[1] & HEALTH_STALE);
+    controlPass(&bench, 3, now += TEMP_PERIOD);
+    HOST_CHECK(duty[1] == 0);
+    // and the next reading is taken as it is, however far it moved
+    HOST_CHECK(zoneReading(&bench, 1, ROOM - 10 * 128));
+    HOST_CHECK(zoneHealths[1] == 0 && fine[1] == ROOM - 10 * 128);
+}
+
+/*
+ * Zones with the same readings come to the same duty at any count
+ */
+static void checkCounts(void) {
+    static const int counts[] = {2, 16, MOST};
+    int32_t expected[600];
+    uint32_t now;
+    int c, x, step;
+    for (c = 0; c < 3; c++) {
+        reset();
+        now = 0;
+        for (step = 0; step < 600; step++) {
+            pass(counts[c], (int16_t)(18 * 128 + step * 2), now += TEMP_PERIOD);
+            if (c == 0) {
+                expected[step] = duty[1];
+            }
+            for (x = 1; x < counts[c]; x++) {
+                HOST_CHECK(duty[x] == expected[step]);
+            }
+        }
+    }
+}
+
+/*
+ * ns a zone of the pass at count zones on the host, all with a new
+ * reading each pass
+ */
+static double timePass(int count) {
+    uint32_t now = 0;
+    long passes = BENCHMARK_ZONES / count, x;
+    double start;
+    int y;
+    reset();
+    for (y = 0; y < count; y++) {
+        zoneHealths[y] = 0;
+        age[y] = 0;
+    }
+    start = hostSeconds();
+    for (x = 0; x < passes; x++) {
+        for (y = 0; y < count; y++) {
+            sample[y] = true;
+        }
+        raw[x % count] ^= 1;
+        controlPass(&bench, count, now += TEMP_PERIOD);
+    }
+    return (hostSeconds() - start) * 1e9 / ((double)passes * count);
+}
+
+int main(void) {
+    static const int counts[] = {1, 16, MOST};
+    double perZone[3];
+    int x;
+
+    checkFaults();
+    checkCounts();
+
+    hostAttachTmp102(&tmp102, 0x48);
+    hostUartLine = line;
+    hostBoot();
+    hostRun((WCET_REPORT_PERIOD + 1) * HOST_CYCLES_PER_SECOND);
+    // the host takes no simulated time for the pass, so its cycles are 0
+    printf("<N> block: %d zones, %u bytes a zone, %u more with a sensor on the bus on the host\n", blockZones, blockBytes,
+           blockSensorBytes);
+    HOST_CHECK(blockZones == ZONES);
+    HOST_CHECK(blockBytes == ZONE_BYTES);
+    HOST_CHECK(blockSensorBytes == ZONE_SENSOR_BYTES);
+
+    for (x = 0; x < 3; x++) {
+        perZone[x] = timePass(counts[x]);
+        printf("%3d zones: %.2f ns a zone, %.0f ns a pass on the host, %u bytes of RAM\n", counts[x], perZone[x],
+               perZone[x] * counts[x], (unsigned)(counts[x] * ZONE_BYTES));
+    }
+    // the pass is a loop down the arrays: a zone costs no more among many
+    HOST_CHECK(perZone[2] <= perZone[1] * 1.5);
+
+    printf("%s\n", hostFailures == 0 ? "all zone pass checks hold" : "zone pass checks FAILED");
+    return hostFailures == 0 ? 0 : 1;
+}